@@ -1,14 +1,15 @@
 #include "image.hpp"
+#include "collisionMask.hpp"
 #include "os.hpp"
+#include "svgCache.hpp"
+#include "trace.hpp"
 #include <algorithm>
+#include <cstring>
+#include <memory>
 #include <vector>
 #define STBI_NO_GIF
 #define STB_IMAGE_IMPLEMENTATION
 #include "unzip.hpp"
-#define NANOSVG_IMPLEMENTATION
-#include "nanosvg.h"
-#define NANOSVGRAST_IMPLEMENTATION
-#include "nanosvgrast.h"
 #include "stb_image.h"
 
 using u32 = uint32_t;
@@ -19,6 +20,7 @@ std::vector<imageRGBA> imageRGBAS;
 static std::vector<imageRGBA *> imageLoadQueue;
 static std::vector<std::string> toDelete;
 #define MAX_IMAGE_VRAM 30000000
+#define MAX_TEXTURE_SIZE 1024
 
 const u32 next_pow2(u32 n) {
     n--;
@@ -45,6 +47,48 @@ const u32 rgba_to_abgr(u32 px) {
     return (a << 24) | (b << 16) | (g << 8) | r;
 }
 
+/**
+ * Rounds the scale an SVG is drawn at up to the scale it should be rasterized at,
+ * like `SvgCache::getScaleBucket()` but small enough for a 3DS texture.
+ */
+static float getTextureScaleBucket(int width, int height, double scale) {
+    float bucket = SvgCache::getScaleBucket(width, height, scale);
+    while (bucket > SvgCache::MIN_SCALE && std::max(width, height) * bucket > MAX_TEXTURE_SIZE) {
+        bucket /= 2.0f;
+    }
+    return bucket;
+}
+
+/**
+ * Parses an SVG costume into `SvgCache`, and rasterizes it at its native size, or smaller if that doesn't fit a texture.
+ * @param imageId the costume's id, without a file extension
+ * @param rgba gets its size and `svgScale` filled in
+ * @return The pixels, allocated with `malloc()`, or `nullptr` if the SVG couldn't be parsed.
+ */
+static unsigned char *decodeSVG(const std::string &imageId, const void *data, size_t size, imageRGBA &rgba) {
+    int width, height;
+    if (!SvgCache::add(imageId, data, size) || !SvgCache::getSize(imageId, width, height)) return nullptr;
+    const float scale = getTextureScaleBucket(width, height, 1.0);
+    std::shared_ptr<const SvgCache::Raster> raster = SvgCache::rasterize(imageId, scale);
+    if (!raster) {
+        SvgCache::remove(imageId);
+        return nullptr;
+    }
+
+    unsigned char *rgba_data = (unsigned char *)malloc(raster->rgba.size());
+    if (!rgba_data) {
+        Log::logWarning("Failed to allocate RGBA buffer for SVG");
+        SvgCache::remove(imageId);
+        return nullptr;
+    }
+    memcpy(rgba_data, raster->rgba.data(), raster->rgba.size());
+    rgba.isSVG = true;
+    rgba.svgScale = scale;
+    rgba.width = raster->width;
+    rgba.height = raster->height;
+    return rgba_data;
+}
+
 Image::Image(std::string filePath) {
     if (!loadImageFromFile(filePath, false)) return;
 
@@ -151,14 +195,15 @@ bool Image::loadImageFromFile(std::string filePath, bool fromScratchProject) {
             return false;
         }
 
-        newRGBA.isSVG = true;
-        rgba_data = SVGToRGBA(svg_data, file_size, width, height);
+        rgba_data = decodeSVG(path2, svg_data, file_size, newRGBA);
         free(svg_data);
 
         if (!rgba_data) {
             Log::logWarning("Failed to decode SVG: " + filePath);
             return false;
         }
+        width = newRGBA.width;
+        height = newRGBA.height;
     } else {
         int channels;
         rgba_data = stbi_load_from_file(file, &width, &height, &channels, 4);
@@ -178,6 +223,7 @@ bool Image::loadImageFromFile(std::string filePath, bool fromScratchProject) {
     newRGBA.textureHeight = clamp(next_pow2(newRGBA.height), 64, 1024);
     newRGBA.textureMemSize = newRGBA.textureWidth * newRGBA.textureHeight * 4;
     newRGBA.data = rgba_data;
+    if (fromScratchProject) CollisionMask::build(path2, rgba_data, width, height, width * 4);
 
     size_t imageSize = width * height * 4;
     MemoryTracker::allocate(imageSize);
@@ -200,6 +246,7 @@ void Image::loadImageFromSB3(mz_zip_archive *zip, const std::string &costumeId)
         return img.name == imageId;
     });
     if (it != imageRGBAS.end()) return;
+    TRACE_SCOPE("decode " + costumeId, "asset");
 
     // Log::log("Loading single image: " + costumeId);
 
@@ -247,14 +294,16 @@ void Image::loadImageFromSB3(mz_zip_archive *zip, const std::string &costumeId)
     imageRGBA newRGBA;
 
     if (isSVG) {
-        newRGBA.isSVG = true;
-        rgba_data = SVGToRGBA(file_data, file_size, width, height);
+        // SVGs stay parsed, so they can be rasterized again at the size they get drawn at
+        rgba_data = decodeSVG(imageId, file_data, file_size, newRGBA);
         if (!rgba_data) {
             Log::logWarning("Failed to decode SVG: " + costumeId);
             mz_free(file_data);
             Image::cleanupImages();
             return;
         }
+        width = newRGBA.width;
+        height = newRGBA.height;
     } else {
         // Handle bitmap files (PNG, JPG)
         int channels;
@@ -279,6 +328,7 @@ void Image::loadImageFromSB3(mz_zip_archive *zip, const std::string &costumeId)
     newRGBA.textureHeight = clamp(next_pow2(newRGBA.height), 64, 1024);
     newRGBA.textureMemSize = newRGBA.textureWidth * newRGBA.textureHeight * 4;
     newRGBA.data = rgba_data;
+    CollisionMask::build(imageId, rgba_data, width, height, width * 4);
 
     // Track memory usage
     size_t imageSize = width * height * 4;
@@ -291,76 +341,6 @@ void Image::loadImageFromSB3(mz_zip_archive *zip, const std::string &costumeId)
     mz_free(file_data);
 }
 
-/**
- * Loads SVG data and converts it to RGBA pixel data
- */
-unsigned char *SVGToRGBA(const void *svg_data, size_t svg_size, int &width, int &height) {
-    // Create a null-terminated string from the SVG data
-    char *svg_string = (char *)malloc(svg_size + 1);
-    if (!svg_string) {
-        Log::logWarning("Failed to allocate memory for SVG string");
-        return nullptr;
-    }
-    memcpy(svg_string, svg_data, svg_size);
-    svg_string[svg_size] = '\0';
-
-    // Parse SVG
-    NSVGimage *image = nsvgParse(svg_string, "px", 96.0f);
-    free(svg_string);
-
-    if (!image) {
-        Log::logWarning("Failed to parse SVG");
-        return nullptr;
-    }
-
-    // Determine render size
-    if (image->width > 0 && image->height > 0) {
-        width = (int)image->width;
-        height = (int)image->height;
-    } else {
-        width = 32;
-        height = 32;
-    }
-
-    // Clamp to 3DS limits
-    width = clamp(width, 0, 1024);
-    height = clamp(height, 0, 1024);
-
-    // Create rasterizer
-    NSVGrasterizer *rast = nsvgCreateRasterizer();
-    if (!rast) {
-        Log::logWarning("Failed to create SVG rasterizer");
-        nsvgDelete(image);
-        return nullptr;
-    }
-
-    // Allocate RGBA buffer
-    unsigned char *rgba_data = (unsigned char *)malloc(width * height * 4);
-    if (!rgba_data) {
-        Log::logWarning("Failed to allocate RGBA buffer for SVG");
-        nsvgDeleteRasterizer(rast);
-        nsvgDelete(image);
-        return nullptr;
-    }
-
-    // Calculate scale
-    float scale = 1.0f;
-    if (image->width > 0 && image->height > 0) {
-        float scaleX = (float)width / image->width;
-        float scaleY = (float)height / image->height;
-        scale = std::min(scaleX, scaleY);
-    }
-
-    // Rasterize SVG
-    nsvgRasterize(rast, image, 0, 0, scale, rgba_data, width, height, width * 4);
-
-    // Clean up
-    nsvgDeleteRasterizer(rast);
-    nsvgDelete(image);
-
-    return rgba_data;
-}
-
 bool getImageFromT3x(const std::string &filePath) {
     std::string filename = filePath.substr(filePath.find_last_of('/') + 1);
     std::string path2 = filename.substr(0, filename.find_last_of('.'));
@@ -398,19 +378,16 @@ bool getImageFromT3x(const std::string &filePath) {
 }
 
 /**
- * Reads an `imageRGBA` image, and adds a `C2D_Image` object to `imageC2Ds`.
+ * Makes a `C2D_Image` out of RGBA pixels.
  * Assumes image data is stored left->right, top->bottom.
  * Dimensions must be within 64x64 and 1024x1024.
  * Code here originally from https://gbatemp.net/threads/citro2d-c2d_image-example.668574/
  * then edited to fit my code
  */
-bool get_C2D_Image(imageRGBA rgba) {
+static bool createTexture(const unsigned char *data, int width, int height, C2D_Image &image) {
 
-    // u32 px_count = rgba.width * rgba.height;
-    u32 *rgba_raw = reinterpret_cast<u32 *>(rgba.data);
-
-    // Image data
-    C2D_Image image;
+    // u32 px_count = width * height;
+    const u32 *rgba_raw = reinterpret_cast<const u32 *>(data);
 
     // Base texture
     C3D_Tex *tex = new C3D_Tex();
@@ -419,10 +396,10 @@ bool get_C2D_Image(imageRGBA rgba) {
     image.tex = tex;
 
     // Texture dimensions must be square powers of two between 64x64 and 1024x1024
-    tex->width = rgba.textureWidth;
-    tex->height = rgba.textureHeight;
+    tex->width = clamp(next_pow2(width), 64, MAX_TEXTURE_SIZE);
+    tex->height = clamp(next_pow2(height), 64, MAX_TEXTURE_SIZE);
 
-    size_t textureSize = rgba.textureMemSize;
+    size_t textureSize = static_cast<size_t>(tex->width) * tex->height * 4;
 
     // Subtexture
     Tex3DS_SubTexture *subtex = new Tex3DS_SubTexture();
@@ -430,14 +407,14 @@ bool get_C2D_Image(imageRGBA rgba) {
     // new (subtex) Tex3DS_SubTexture();
 
     image.subtex = subtex;
-    subtex->width = rgba.width;
-    subtex->height = rgba.height;
+    subtex->width = width;
+    subtex->height = height;
 
     // (U, V) coordinates
     subtex->left = 0.0f;
     subtex->top = 1.0f;
-    subtex->right = (float)rgba.width / (float)tex->width;
-    subtex->bottom = 1.0 - ((float)rgba.height / (float)tex->height);
+    subtex->right = (float)width / (float)tex->width;
+    subtex->bottom = 1.0 - ((float)height / (float)tex->height);
 
     if (!C3D_TexInit(tex, tex->width, tex->height, GPU_RGBA8)) {
         Log::logWarning("Texture initializing failed!");
@@ -445,7 +422,6 @@ bool get_C2D_Image(imageRGBA rgba) {
         delete subtex;
         // MemoryTracker::deallocate(tex);
         // MemoryTracker::deallocate(subtex);
-        cleanupImagesLite();
         return false;
     }
     C3D_TexSetFilter(tex, GPU_LINEAR, GPU_LINEAR);
@@ -457,14 +433,13 @@ bool get_C2D_Image(imageRGBA rgba) {
         delete subtex;
         // MemoryTracker::deallocate(tex);
         // MemoryTracker::deallocate(subtex);
-        cleanupImagesLite();
         return false;
     }
 
     memset(tex->data, 0, textureSize);
-    for (u32 i = 0; i < (u32)rgba.width; i++) {
-        for (u32 j = 0; j < (u32)rgba.height; j++) {
-            u32 src_idx = (j * rgba.width) + i;
+    for (u32 i = 0; i < (u32)width; i++) {
+        for (u32 j = 0; j < (u32)height; j++) {
+            u32 src_idx = (j * width) + i;
             u32 rgba_px = rgba_raw[src_idx];
             u32 abgr_px = rgba_to_abgr(rgba_px);
 
@@ -475,6 +450,37 @@ bool get_C2D_Image(imageRGBA rgba) {
             ((u32 *)tex->data)[dst_ptr_offset] = abgr_px;
         }
     }
+    return true;
+}
+
+/**
+ * Frees a texture made by `createTexture()`.
+ */
+static void deleteTexture(C2D_Image &image) {
+    if (image.tex) {
+        C3D_TexDelete(image.tex);
+        delete image.tex;
+        image.tex = nullptr;
+    }
+    if (image.subtex) {
+        delete image.subtex;
+        image.subtex = nullptr;
+    }
+}
+
+static size_t getTextureMemSize(const C2D_Image &image) {
+    return static_cast<size_t>(image.tex->width) * image.tex->height * 4;
+}
+
+/**
+ * Reads an `imageRGBA` image, and adds a `C2D_Image` object to `imageC2Ds`.
+ */
+bool get_C2D_Image(imageRGBA rgba) {
+    C2D_Image image;
+    if (!createTexture(rgba.data, rgba.width, rgba.height, image)) {
+        cleanupImagesLite();
+        return false;
+    }
 
     // Log::log("C2D Image Successfully loaded!");
 
@@ -485,6 +491,36 @@ bool get_C2D_Image(imageRGBA rgba) {
     return true;
 }
 
+void updateSVGResolutions() {
+    for (const imageRGBA &rgba : imageRGBAS) {
+        if (!rgba.isSVG) continue;
+        auto dataFind = imageC2Ds.find(rgba.name);
+        if (dataFind == imageC2Ds.end() || dataFind->second.wantedScale == 0.0) continue;
+        ImageData &data = dataFind->second;
+        const double wantedScale = data.wantedScale;
+        data.wantedScale = 0.0;
+
+        int width, height;
+        if (!SvgCache::getSize(rgba.name, width, height)) continue;
+        const float bucket = getTextureScaleBucket(width, height, wantedScale * rgba.svgScale);
+        if (bucket / rgba.svgScale == data.rasterScale) continue;
+
+        // there's no worker thread to rasterize on, so this frame waits for it
+        std::shared_ptr<const SvgCache::Raster> raster = SvgCache::rasterize(rgba.name, bucket);
+        if (!raster) continue;
+        C2D_Image image;
+        if (!createTexture(raster->rgba.data(), raster->width, raster->height, image)) {
+            Log::logWarning("Failed to create texture for " + rgba.name);
+            continue;
+        }
+        MemoryTracker::deallocateVRAM(getTextureMemSize(data.image));
+        MemoryTracker::allocateVRAM(getTextureMemSize(image));
+        deleteTexture(data.image);
+        data.image = image;
+        data.rasterScale = bucket / rgba.svgScale;
+    }
+}
+
 /**
  * Frees a `C2D_Image` from memory using `costumeId` string to find it.
  */
@@ -505,14 +541,15 @@ void Image::freeImage(const std::string &costumeId) {
             goto afterFreeing;
         }
 
-        if (it->second.image.tex) {
-            C3D_TexDelete(it->second.image.tex);
-            delete it->second.image.tex;
-            it->second.image.tex = nullptr;
-        }
-        if (it->second.image.subtex) {
-            delete it->second.image.subtex;
+        if (it->second.rasterScale != 1.0f && it->second.image.tex) {
+            // `freeRGBA()` gives back the VRAM of the texture `get_C2D_Image()` made, not the SVG's current one
+            auto rgbaFind = std::find_if(imageRGBAS.begin(), imageRGBAS.end(), [&](const imageRGBA &img) {
+                return img.name == costumeId;
+            });
+            MemoryTracker::deallocateVRAM(getTextureMemSize(it->second.image));
+            if (rgbaFind != imageRGBAS.end()) MemoryTracker::allocateVRAM(rgbaFind->textureMemSize);
         }
+        deleteTexture(it->second.image);
 
     afterFreeing:
 
@@ -533,6 +570,7 @@ void cleanupImagesLite() {
     }
 
     for (const std::string &id : keysToDelete) {
+        TRACE_INSTANT("evict " + id, "asset");
         Image::freeImage(id);
     }
 }
@@ -554,6 +592,7 @@ void Image::cleanupImages() {
     imageC2Ds.clear();
     imageLoadQueue.clear();
     toDelete.clear();
+    SvgCache::clear();
 
     // Log::log("Image cleanup completed.");
 }
@@ -576,6 +615,7 @@ void freeRGBA(const std::string &imageName) {
 
             // Log::log("Freed RGBA data for " + imageName);
         }
+        if (it->isSVG) SvgCache::remove(imageName);
         imageRGBAS.erase(it);
     }
 }
@@ -13,6 +13,8 @@ struct ImageData {
     C2D_SpriteSheet sheet;
     size_t maxFreeTimer = 120;
     size_t imageUsageCount = 0;
+    float rasterScale = 1.0f; // texture pixels per `imageRGBA` pixel, once an SVG got rasterized at the size it's drawn at
+    double wantedScale = 0.0; // the largest scale the SVG got drawn at this frame, in screen pixels per `imageRGBA` pixel
 };
 
 struct imageRGBA {
@@ -21,6 +23,7 @@ struct imageRGBA {
     int width;
     int height;
     bool isSVG = false;
+    float svgScale = 1.0f; // the scale an SVG's `data` was rasterized at, below 1 if it's too big for a texture
 
     //  same as width/height but as powers of 2 for 3DS
     int textureWidth;
@@ -34,8 +37,13 @@ extern std::vector<imageRGBA> imageRGBAS;
 
 bool get_C2D_Image(imageRGBA rgba);
 void freeRGBA(const std::string &imageName);
-unsigned char *SVGToRGBA(const void *svg_data, size_t svg_size, int &width, int &height);
 bool getImageFromT3x(const std::string &filePath);
 void cleanupImagesLite();
 
+/**
+ * Rasterizes the SVG costumes drawn this frame again at the scale they got drawn at, and swaps their textures.
+ * Runs right away on the main thread, so it's called after the frame ends, with the old textures no longer in use.
+ */
+void updateSVGResolutions();
+
 extern std::unordered_map<std::string, ImageData> imageC2Ds;
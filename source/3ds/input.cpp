@@ -1,5 +1,6 @@
 #include "input.hpp"
 #include "blockExecutor.hpp"
+#include "perfOverlay.hpp"
 #include "input.hpp"
 #include "render.hpp"
 #include <3ds.h>
@@ -7,11 +8,6 @@
 #define BOTTOM_SCREEN_WIDTH 320
 #define SCREEN_HEIGHT 240
 
-std::vector<std::string> Input::inputButtons;
-std::map<std::string, std::string> Input::inputControls;
-Input::Mouse Input::mousePointer;
-Sprite *Input::draggingSprite = nullptr;
-int Input::keyHeldFrames = 0;
 static int mouseHeldFrames = 0;
 static u16 oldTouchPx = 0;
 static u16 oldTouchPy = 0;
@@ -39,12 +35,15 @@ std::vector<int> Input::getTouchPosition() {
 }
 
 void Input::getInput() {
-    inputButtons.clear();
+    clearKeyStates();
     mousePointer.isPressed = false;
     mousePointer.isMoving = false;
     hidScanInput();
     u32 kDown = hidKeysHeld();
 
+    // SELECT + START toggles the performance overlay in debug mode
+    if ((kDown & KEY_SELECT) && (hidKeysDown() & KEY_START)) PerfOverlay::toggle();
+
     hidTouchRead(&touch);
     std::vector<int> touchPos = getTouchPosition();
 
@@ -59,73 +58,72 @@ void Input::getInput() {
     }
 
     if (kDown) {
-        keyHeldFrames += 1;
-        inputButtons.push_back("any");
+        pressKey(ANY_KEY);
         if (kDown & KEY_A) {
-            Input::buttonPress("A");
+            Input::buttonPress(Input::BUTTON_A);
         }
         if (kDown & KEY_B) {
-            Input::buttonPress("B");
+            Input::buttonPress(Input::BUTTON_B);
         }
         if (kDown & KEY_X) {
-            Input::buttonPress("X");
+            Input::buttonPress(Input::BUTTON_X);
         }
         if (kDown & KEY_Y) {
-            Input::buttonPress("Y");
+            Input::buttonPress(Input::BUTTON_Y);
         }
         if (kDown & KEY_SELECT) {
-            Input::buttonPress("back");
+            Input::buttonPress(Input::BUTTON_BACK);
         }
         if (kDown & KEY_START) {
-            Input::buttonPress("start");
+            Input::buttonPress(Input::BUTTON_START);
         }
         if (kDown & KEY_DUP) {
-            Input::buttonPress("dpadUp");
+            Input::buttonPress(Input::BUTTON_DPAD_UP);
         }
         if (kDown & KEY_DDOWN) {
-            Input::buttonPress("dpadDown");
+            Input::buttonPress(Input::BUTTON_DPAD_DOWN);
         }
         if (kDown & KEY_DLEFT) {
-            Input::buttonPress("dpadLeft");
+            Input::buttonPress(Input::BUTTON_DPAD_LEFT);
         }
         if (kDown & KEY_DRIGHT) {
-            Input::buttonPress("dpadRight");
+            Input::buttonPress(Input::BUTTON_DPAD_RIGHT);
         }
         if (kDown & KEY_L) {
-            Input::buttonPress("shoulderL");
+            Input::buttonPress(Input::BUTTON_SHOULDER_L);
         }
         if (kDown & KEY_R) {
-            Input::buttonPress("shoulderR");
+            Input::buttonPress(Input::BUTTON_SHOULDER_R);
         }
         if (kDown & KEY_ZL) {
-            Input::buttonPress("LT");
+            Input::buttonPress(Input::BUTTON_LT);
         }
         if (kDown & KEY_ZR) {
-            Input::buttonPress("RT");
+            Input::buttonPress(Input::BUTTON_RT);
         }
         if (kDown & KEY_CPAD_UP) {
-            Input::buttonPress("LeftStickUp");
+            Input::buttonPress(Input::BUTTON_LEFT_STICK_UP);
         }
         if (kDown & KEY_CPAD_DOWN) {
-            Input::buttonPress("LeftStickDown");
+            Input::buttonPress(Input::BUTTON_LEFT_STICK_DOWN);
         }
         if (kDown & KEY_CPAD_LEFT) {
-            Input::buttonPress("LeftStickLeft");
+            Input::buttonPress(Input::BUTTON_LEFT_STICK_LEFT);
         }
         if (kDown & KEY_CPAD_RIGHT) {
-            Input::buttonPress("LeftStickRight");
+            Input::buttonPress(Input::BUTTON_LEFT_STICK_RIGHT);
         }
         if (kDown & KEY_CSTICK_UP) {
-            Input::buttonPress("RightStickUp");
+            Input::buttonPress(Input::BUTTON_RIGHT_STICK_UP);
         }
         if (kDown & KEY_CSTICK_DOWN) {
-            Input::buttonPress("RightStickDown");
+            Input::buttonPress(Input::BUTTON_RIGHT_STICK_DOWN);
         }
         if (kDown & KEY_CSTICK_LEFT) {
-            Input::buttonPress("RightStickLeft");
+            Input::buttonPress(Input::BUTTON_RIGHT_STICK_LEFT);
         }
         if (kDown & KEY_CSTICK_RIGHT) {
-            Input::buttonPress("RightStickRight");
+            Input::buttonPress(Input::BUTTON_RIGHT_STICK_RIGHT);
         }
         if (kDown & KEY_TOUCH) {
 
@@ -150,12 +148,8 @@ void Input::getInput() {
                 mousePointer.isMoving = true;
             }
         }
-        if (keyHeldFrames == 1 || keyHeldFrames > 13)
-            BlockExecutor::runAllBlocksByOpcode("event_whenkeypressed");
-
-    } else {
-        keyHeldFrames = 0;
     }
+    updateKeyStates();
     oldTouchPx = touchPos[0];
     oldTouchPy = touchPos[1];
 
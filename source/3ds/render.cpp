@@ -1,10 +1,14 @@
 #include "render.hpp"
 #include "audio.hpp"
+#include "drawOrder.hpp"
 #include "image.hpp"
 #include "input.hpp"
 #include "interpret.hpp"
+#include "perfOverlay.hpp"
 #include "render.hpp"
+#include "spatialGrid.hpp"
 #include "text.hpp"
+#include "trace.hpp"
 #include "unzip.hpp"
 #include <chrono>
 #ifdef ENABLE_AUDIO
@@ -198,8 +202,7 @@ void renderImage(C2D_Image *image, Sprite *currentSprite, std::string costumeId,
 
             if (rgba.isSVG) isSVG = true;
             legacyDrawing = false;
-            currentSprite->spriteWidth = rgba.width / 2;
-            currentSprite->spriteHeight = rgba.height / 2;
+            SpatialGrid::setSpriteSize(currentSprite, rgba.width / 2, rgba.height / 2);
 
             if (imageC2Ds.find(costumeId) == imageC2Ds.end() || image->tex == nullptr || image->subtex == nullptr) {
 
@@ -217,10 +220,10 @@ void renderImage(C2D_Image *image, Sprite *currentSprite, std::string costumeId,
             break;
         }
     }
+    PerfOverlay::countImageLookup(imageLoaded);
     if (!imageLoaded) {
         legacyDrawing = true;
-        currentSprite->spriteWidth = 64;
-        currentSprite->spriteHeight = 64;
+        SpatialGrid::setSpriteSize(currentSprite, 64, 64);
     }
 
     // double maxLayer = getMaxSpriteLayer();
@@ -278,16 +281,21 @@ void renderImage(C2D_Image *image, Sprite *currentSprite, std::string costumeId,
                 C2D_PlainImageTint(&tinty, C2D_Color32(0, 0, 0, alpha), brightnessEffect);
         } else C2D_AlphaImageTint(&tinty, 1.0f);
 
+        // SVGs get rasterized again at the largest size they're drawn at, once the frame is done
+        ImageData &imageData = imageC2Ds[costumeId];
+        const double drawScale = scale / 2.0 / imageData.rasterScale;
+        if (isSVG) imageData.wantedScale = std::max(imageData.wantedScale, std::abs(spriteSizeX) * scale / 2.0);
+
         C2D_DrawImageAtRotated(
-            imageC2Ds[costumeId].image,
+            imageData.image,
             static_cast<int>((currentSprite->xPosition * scale) + (screenWidth / 2) - offsetX * std::cos(rotation) + offsetY * std::sin(rotation)) + x3DOffset,
             static_cast<int>((currentSprite->yPosition * -1 * scale) + (SCREEN_HEIGHT * heightMultiplier) + screenOffset - offsetX * std::sin(rotation) - offsetY * std::cos(rotation)),
             1,
             rotation,
             &tinty,
-            (spriteSizeX)*scale / 2.0f,
-            (spriteSizeY)*scale / 2.0f);
-        imageC2Ds[costumeId].freeTimer = imageC2Ds[costumeId].maxFreeTimer;
+            spriteSizeX * drawScale,
+            spriteSizeY * drawScale);
+        imageData.freeTimer = imageData.maxFreeTimer;
     } else {
         C2D_DrawRectSolid(
             (currentSprite->xPosition * scale) + (screenWidth / 2),
@@ -321,6 +329,7 @@ void renderImage(C2D_Image *image, Sprite *currentSprite, std::string costumeId,
 }
 
 void Render::renderSprites() {
+    TRACE_SCOPE("renderSprites", "render");
     if (isConsoleInit) renderMode = RenderModes::TOP_SCREEN_ONLY;
     C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
     C2D_TargetClear(topScreen, clrWhite);
@@ -331,16 +340,8 @@ void Render::renderSprites() {
     float slider = osGet3DSliderState();
     const float depthScale = 8.0f / sprites.size();
 
-    // Sort sprites by layer with stage always being first
-    std::vector<Sprite *> spritesByLayer = sprites;
-    std::sort(spritesByLayer.begin(), spritesByLayer.end(),
-              [](const Sprite *a, const Sprite *b) {
-                  // Stage sprite always comes first
-                  if (a->isStage && !b->isStage) return true;
-                  if (!a->isStage && b->isStage) return false;
-                  // Otherwise sort by layer
-                  return a->layer < b->layer;
-              });
+    // already in layer order, with the stage first
+    const std::vector<Sprite *> &spritesByLayer = DrawOrder::get();
 
     // ---------- LEFT EYE ----------
     if (Render::renderMode != Render::BOTTOM_SCREEN_ONLY) {
@@ -353,8 +354,7 @@ void Render::renderSprites() {
             int costumeIndex = 0;
             for (const auto &costume : currentSprite->costumes) {
                 if (costumeIndex == currentSprite->currentCostume) {
-                    currentSprite->rotationCenterX = costume.rotationCenterX;
-                    currentSprite->rotationCenterY = costume.rotationCenterY;
+                    SpatialGrid::setRotationCenter(currentSprite, costume.rotationCenterX, costume.rotationCenterY);
 
                     size_t totalSprites = spritesByLayer.size();
                     float eyeOffset = -slider * (static_cast<float>(totalSprites - 1 - i) * depthScale);
@@ -370,6 +370,7 @@ void Render::renderSprites() {
             }
         }
         renderVisibleVariables();
+        PerfOverlay::render();
     }
 
     if (Render::renderMode != Render::BOTH_SCREENS)
@@ -386,8 +387,7 @@ void Render::renderSprites() {
             int costumeIndex = 0;
             for (const auto &costume : currentSprite->costumes) {
                 if (costumeIndex == currentSprite->currentCostume) {
-                    currentSprite->rotationCenterX = costume.rotationCenterX;
-                    currentSprite->rotationCenterY = costume.rotationCenterY;
+                    SpatialGrid::setRotationCenter(currentSprite, costume.rotationCenterX, costume.rotationCenterY);
 
                     size_t totalSprites = spritesByLayer.size();
                     float eyeOffset = slider * (static_cast<float>(totalSprites - 1 - i) * depthScale);
@@ -419,8 +419,7 @@ void Render::renderSprites() {
             int costumeIndex = 0;
             for (const auto &costume : currentSprite->costumes) {
                 if (costumeIndex == currentSprite->currentCostume) {
-                    currentSprite->rotationCenterX = costume.rotationCenterX;
-                    currentSprite->rotationCenterY = costume.rotationCenterY;
+                    SpatialGrid::setRotationCenter(currentSprite, costume.rotationCenterX, costume.rotationCenterY);
 
                     renderImage(&imageC2Ds[costume.id].image,
                                 currentSprite,
@@ -437,11 +436,13 @@ void Render::renderSprites() {
             drawBlackBars(BOTTOM_SCREEN_WIDTH, SCREEN_HEIGHT);
             renderVisibleVariables();
         }
+        if (Render::renderMode == Render::BOTTOM_SCREEN_ONLY) PerfOverlay::render();
     }
 
     C3D_FrameEnd(0);
     C2D_Flush();
     Image::FlushImages();
+    updateSVGResolutions();
 #ifdef ENABLE_AUDIO
     SoundPlayer::flushAudio();
 #endif
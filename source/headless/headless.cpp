@@ -0,0 +1,202 @@
+#include "headless.hpp"
+#include "interpret.hpp"
+#include "os.hpp"
+#include "sprite.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+int Headless::maxTicks = 600;
+int Headless::ticksRun = 0;
+uint64_t Headless::blocksRun = 0;
+size_t Headless::peakVRAMUsage = 0;
+std::vector<Headless::InputEvent> Headless::inputEvents;
+Headless::Report Headless::report;
+
+static const uint64_t FNV_PRIME_64 = 1099511628211ULL;
+static const uint64_t FNV_OFFSET_BASIS_64 = 14695981039346656037ULL;
+
+static std::chrono::steady_clock::time_point loadStartTime;
+static std::chrono::steady_clock::time_point runStartTime;
+static size_t nextAnswerIndex = 0;
+
+bool Headless::loadInputScript(const std::string &filePath) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        Log::logError("Could not open input script: " + filePath);
+        return false;
+    }
+
+    inputEvents.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.find('#') != std::string::npos) line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+
+        InputEvent event;
+        std::string type;
+        if (!(stream >> event.tick)) continue; // blank line
+        if (!(stream >> type)) {
+            Log::logError("Input script line " + std::to_string(lineNumber) + " has no event type.");
+            return false;
+        }
+
+        std::string rest;
+        std::getline(stream >> std::ws, rest);
+        while (!rest.empty() && std::isspace(static_cast<unsigned char>(rest.back())))
+            rest.pop_back();
+
+        if (type == "keydown" || type == "keyup") {
+            event.type = type == "keydown" ? InputEvent::KEY_DOWN : InputEvent::KEY_UP;
+            event.text = rest;
+            if (event.text.empty()) {
+                Log::logError("Input script line " + std::to_string(lineNumber) + " has no key name.");
+                return false;
+            }
+        } else if (type == "mousemove") {
+            event.type = InputEvent::MOUSE_MOVE;
+            std::istringstream position(rest);
+            if (!(position >> event.x >> event.y)) {
+                Log::logError("Input script line " + std::to_string(lineNumber) + " needs an x and y position.");
+                return false;
+            }
+        } else if (type == "mousedown") {
+            event.type = InputEvent::MOUSE_DOWN;
+        } else if (type == "mouseup") {
+            event.type = InputEvent::MOUSE_UP;
+        } else if (type == "answer") {
+            event.type = InputEvent::ANSWER;
+            event.text = rest;
+        } else {
+            Log::logError("Input script line " + std::to_string(lineNumber) + " has an unknown event type: " + type);
+            return false;
+        }
+        inputEvents.push_back(event);
+    }
+
+    std::stable_sort(inputEvents.begin(), inputEvents.end(),
+                     [](const InputEvent &a, const InputEvent &b) { return a.tick < b.tick; });
+    Log::log("Loaded " + std::to_string(inputEvents.size()) + " scripted input events.");
+    return true;
+}
+
+std::string Headless::nextAnswer() {
+    // answers are handed out in order, but only once their tick has been reached
+    size_t seen = 0;
+    for (const InputEvent &event : inputEvents) {
+        if (event.type != InputEvent::ANSWER) continue;
+        if (event.tick > ticksRun) break;
+        if (seen++ == nextAnswerIndex) {
+            nextAnswerIndex++;
+            return event.text;
+        }
+    }
+    return "";
+}
+
+static size_t getMaxResidentKB() {
+#ifdef __unix__
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) return static_cast<size_t>(usage.ru_maxrss);
+#endif
+    return 0;
+}
+
+void Headless::startLoading() {
+    loadStartTime = std::chrono::steady_clock::now();
+}
+
+void Headless::startClock() {
+    runStartTime = std::chrono::steady_clock::now();
+    report.loadSeconds = std::chrono::duration<double>(runStartTime - loadStartTime).count();
+    report.loadMaxResidentKB = getMaxResidentKB();
+}
+
+void Headless::finish() {
+    if (report.finished) return;
+    report.finished = true;
+    report.ticks = ticksRun;
+    report.blocksRun = blocksRun;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStartTime).count();
+    report.peakRamUsage = MemoryTracker::getPeakUsage();
+    report.peakVRAMUsage = peakVRAMUsage;
+    report.assetCache = AssetCache::getStats();
+    report.diskCacheEnabled = DiskCache::isEnabled();
+    report.diskCache = DiskCache::getStats();
+    report.zipEntries = ZipEntry::getStats();
+    report.stateHash = hashProjectState();
+}
+
+static void hashString(uint64_t &hash, const std::string &str) {
+    for (char c : str) {
+        hash ^= static_cast<uint64_t>(static_cast<unsigned char>(c));
+        hash *= FNV_PRIME_64;
+    }
+    // separator, so "ab" + "c" and "a" + "bc" hash differently
+    hash ^= 0xFF;
+    hash *= FNV_PRIME_64;
+}
+
+uint64_t Headless::hashProjectState() {
+    // unordered_map order isn't stable, so sort everything by sprite and name first
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (Sprite *sprite : sprites) {
+        if (sprite->isClone) continue;
+        for (auto &[id, variable] : sprite->variables) {
+            entries.push_back({sprite->name + "/var/" + variable.name, variable.value.asString()});
+        }
+        for (auto &[id, list] : sprite->lists) {
+            std::string items;
+            for (const Value &item : list.items) {
+                items += item.asString();
+                items += '\n';
+            }
+            entries.push_back({sprite->name + "/list/" + list.name, items});
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+
+    uint64_t hash = FNV_OFFSET_BASIS_64;
+    for (const auto &[name, value] : entries) {
+        hashString(hash, name);
+        hashString(hash, value);
+    }
+    return hash;
+}
+
+void Headless::printReport() {
+    const double seconds = report.seconds > 0 ? report.seconds : 1e-9;
+    const size_t maxResidentKB = getMaxResidentKB();
+
+    printf("load seconds: %.6f\n", report.loadSeconds);
+    printf("max resident after load: %zu KB\n", report.loadMaxResidentKB);
+    printf("ticks: %d\n", report.ticks);
+    printf("blocks: %llu\n", static_cast<unsigned long long>(report.blocksRun));
+    printf("seconds: %.6f\n", report.seconds);
+    printf("ticks/sec: %.1f\n", report.ticks / seconds);
+    printf("blocks/sec: %.1f\n", report.blocksRun / seconds);
+    printf("peak tracked RAM: %zu bytes\n", report.peakRamUsage);
+    printf("peak tracked VRAM: %zu bytes\n", report.peakVRAMUsage);
+    printf("asset cache: %llu hits, %llu misses, %llu evictions (%llu bytes)\n",
+           static_cast<unsigned long long>(report.assetCache.hits), static_cast<unsigned long long>(report.assetCache.misses),
+           static_cast<unsigned long long>(report.assetCache.evictions), static_cast<unsigned long long>(report.assetCache.bytesEvicted));
+    if (report.diskCacheEnabled) {
+        printf("disk cache: %llu hits, %llu misses, %llu stored, %llu deleted\n",
+               static_cast<unsigned long long>(report.diskCache.hits), static_cast<unsigned long long>(report.diskCache.misses),
+               static_cast<unsigned long long>(report.diskCache.stores), static_cast<unsigned long long>(report.diskCache.filesDeleted));
+    }
+    printf("zip entries: %llu read in place (%llu bytes), %llu extracted\n",
+           static_cast<unsigned long long>(report.zipEntries.inPlace), static_cast<unsigned long long>(report.zipEntries.inPlaceBytes),
+           static_cast<unsigned long long>(report.zipEntries.extracted));
+    printf("max resident: %zu KB\n", maxResidentKB);
+    printf("state hash: %016llx\n", static_cast<unsigned long long>(report.stateHash));
+    fflush(stdout);
+}
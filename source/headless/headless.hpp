@@ -0,0 +1,96 @@
+#pragma once
+#include "assetCache.hpp"
+#include "diskCache.hpp"
+#include "zipEntry.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * State shared by the headless backend and runner.
+ * The headless build runs a project for a fixed number of ticks on a fixed timestep,
+ * with no window or audio device, and reports how fast it ran.
+ */
+class Headless {
+  public:
+    struct InputEvent {
+        enum Type {
+            KEY_DOWN,
+            KEY_UP,
+            MOUSE_MOVE,
+            MOUSE_DOWN,
+            MOUSE_UP,
+            ANSWER
+        };
+        int tick;
+        Type type;
+        std::string text; // key name or answer
+        int x = 0;
+        int y = 0;
+    };
+
+    struct Report {
+        int ticks = 0;
+        uint64_t blocksRun = 0;
+        double seconds = 0;
+        double loadSeconds = 0;       // from `startLoading()` to `startClock()`
+        size_t loadMaxResidentKB = 0; // max resident size once the project had loaded
+        size_t peakRamUsage = 0;
+        size_t peakVRAMUsage = 0;
+        AssetCache::Stats assetCache;
+        bool diskCacheEnabled = false;
+        DiskCache::Stats diskCache;
+        ZipEntry::Stats zipEntries;
+        uint64_t stateHash = 0;
+        bool finished = false;
+    };
+
+    static int maxTicks;
+    static int ticksRun;
+    static uint64_t blocksRun;
+    static size_t peakVRAMUsage;
+    static std::vector<InputEvent> inputEvents;
+    static Report report;
+
+    /**
+     * Loads scripted input from a text file. One event per line, `#` starts a comment:
+     * `<tick> keydown <key>`, `<tick> keyup <key>`, `<tick> mousemove <x> <y>`,
+     * `<tick> mousedown`, `<tick> mouseup`, `<tick> answer <text>`.
+     * Key names are the Scratch ones (`space`, `up arrow`, `a`...).
+     * @param filePath
+     * @return `false` if the file could not be read or has a malformed line.
+     */
+    static bool loadInputScript(const std::string &filePath);
+
+    /**
+     * Gets the next scripted answer for the `ask` block, or an empty string once they run out.
+     */
+    static std::string nextAnswer();
+
+    /**
+     * Starts timing how long the project takes to load.
+     */
+    static void startLoading();
+
+    /**
+     * Starts the wall clock used for the blocks/sec and ticks/sec numbers, once the project has loaded.
+     */
+    static void startClock();
+
+    /**
+     * Snapshots the run's statistics and a hash of every variable and list.
+     * Must be called before the project gets cleaned up. Only the first call does anything.
+     */
+    static void finish();
+
+    /**
+     * Hashes every variable and list of every non-clone sprite (FNV-1a, in a stable order).
+     */
+    static uint64_t hashProjectState();
+
+    /**
+     * Prints the report to stdout.
+     */
+    static void printReport();
+};
@@ -0,0 +1,224 @@
+#include "../scratch/image.hpp"
+#include "assetCache.hpp"
+#include "collisionMask.hpp"
+#include "image.hpp"
+#include "imageLoader.hpp"
+#include "os.hpp"
+#include "svgCache.hpp"
+#include "trace.hpp"
+#include "unzip.hpp"
+#include "zipEntry.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_STDIO
+#include "stb_image.h"
+#include "nanosvg.h"
+#include "nanosvgrast.h"
+
+std::unordered_map<std::string, HeadlessImage> headlessImages;
+
+/**
+ * Reads the size of an encoded image without keeping any pixels around.
+ * @param data encoded image
+ * @param size size of `data` in bytes
+ * @param isSVG
+ * @param image where the size gets stored
+ * @param svgId if not empty, an SVG gets kept in `SvgCache` under this id instead of being thrown away
+ * @return `false` if the image couldn't be decoded.
+ */
+static bool readImageSize(const unsigned char *data, size_t size, bool isSVG, HeadlessImage &image, const std::string &svgId = "") {
+    image.isSVG = isSVG;
+    if (isSVG && !svgId.empty()) {
+        if (!SvgCache::add(svgId, data, size)) return false;
+        SvgCache::getSize(svgId, image.width, image.height);
+    } else if (isSVG) {
+        // nanosvg parses in place and needs a null terminated string
+        std::string svg(reinterpret_cast<const char *>(data), size);
+        NSVGimage *svgImage = nsvgParse(svg.data(), "px", 96.0f);
+        if (!svgImage) return false;
+        image.width = static_cast<int>(svgImage->width);
+        image.height = static_cast<int>(svgImage->height);
+        nsvgDelete(svgImage);
+    } else {
+        int components;
+        if (!stbi_info_from_memory(data, static_cast<int>(size), &image.width, &image.height, &components))
+            return false;
+    }
+    // count what the same image would take as a texture on the SDL build
+    image.memorySize = static_cast<size_t>(image.width) * image.height * 4;
+    return true;
+}
+
+/**
+ * Decodes a costume's pixels just long enough to build its collision mask, at the same size
+ * the SDL build decodes it at.
+ * @param data encoded image
+ * @param size size of `data` in bytes
+ * @param isSVG
+ * @param imgId the costume's id, without a file extension
+ */
+static void buildCollisionMask(const unsigned char *data, size_t size, bool isSVG, const std::string &imgId) {
+    if (isSVG) {
+        // the SVG is already in `SvgCache` from reading its size
+        std::shared_ptr<const SvgCache::Raster> raster = SvgCache::rasterize(imgId, 1.0f);
+        if (raster) CollisionMask::build(imgId, raster->rgba.data(), raster->width, raster->height, raster->width * 4);
+        return;
+    }
+
+    int width, height, components;
+    unsigned char *rgba = stbi_load_from_memory(data, static_cast<int>(size), &width, &height, &components, 4);
+    if (!rgba) return;
+    CollisionMask::build(imgId, rgba, width, height, width * 4);
+    stbi_image_free(rgba);
+}
+
+static bool isSVGPath(const std::string &path) {
+    if (path.size() < 4) return false;
+    std::string ext = path.substr(path.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".svg";
+}
+
+static void addImage(const std::string &imgId, const HeadlessImage &image, bool prefetched = false) {
+    MemoryTracker::allocateVRAM(image.memorySize);
+    HeadlessImage &added = headlessImages[imgId];
+    added = image;
+    added.cacheEntry = AssetCache::add(imgId, image.memorySize, Image::freeImage, prefetched);
+}
+
+Image::Image(std::string filePath) {
+    std::ifstream file(OS::getRomFSLocation() + filePath, std::ios::binary);
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    HeadlessImage image;
+    if (!readImageSize(data.data(), data.size(), isSVGPath(filePath), image)) return;
+    imageId = filePath.substr(0, filePath.find_last_of('.'));
+    width = image.width;
+    height = image.height;
+    scale = 1.0;
+    rotation = 0.0;
+    opacity = 1.0;
+}
+
+Image::~Image() {
+}
+
+void Image::render(double xPos, double yPos, bool centered) {
+}
+
+bool Image::loadImageFromFile(std::string filePath, bool fromScratchProject) {
+    std::string imgId = filePath.substr(0, filePath.find_last_of('.'));
+    if (headlessImages.find(imgId) != headlessImages.end()) return true;
+    TRACE_SCOPE("decode " + filePath, "asset");
+
+    std::string finalPath = OS::getRomFSLocation();
+    if (fromScratchProject) finalPath = finalPath + "project/";
+    finalPath = finalPath + filePath;
+    if (Unzip::UnpackedInSD) finalPath = Unzip::filePath + filePath;
+
+    std::ifstream file(finalPath, std::ios::binary);
+    if (!file.is_open()) {
+        Log::logWarning("Failed to open image: " + finalPath);
+        return false;
+    }
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    HeadlessImage image;
+    if (!readImageSize(data.data(), data.size(), isSVGPath(filePath), image, fromScratchProject ? imgId : "")) {
+        Log::logWarning("Failed to load image: " + finalPath);
+        return false;
+    }
+    if (fromScratchProject) buildCollisionMask(data.data(), data.size(), isSVGPath(filePath), imgId);
+    addImage(imgId, image);
+    return true;
+}
+
+void Image::loadImageFromSB3(mz_zip_archive *zip, const std::string &costumeId) {
+    std::string imgId = costumeId.substr(0, costumeId.find_last_of('.'));
+    if (headlessImages.find(imgId) != headlessImages.end()) return;
+    TRACE_SCOPE("decode " + costumeId, "asset");
+
+    DecodedImage image;
+    image.id = imgId;
+    image.costumeFile = costumeId;
+    if (!ImageLoader::load(zip, image)) {
+        Log::logWarning("Failed to load image from memory: " + costumeId);
+        return;
+    }
+    ImageLoader::upload(image);
+}
+
+bool ImageLoader::isLoaded(const std::string &imageId) {
+    return headlessImages.find(imageId) != headlessImages.end();
+}
+
+bool ImageLoader::decode(mz_zip_archive *zip, DecodedImage &image) {
+    ZipEntry file(zip, image.costumeFile);
+    if (!file.data()) {
+        Log::logWarning("Image file not found in zip: " + image.costumeFile);
+        return false;
+    }
+    const void *fileData = file.data();
+    const size_t fileSize = file.size();
+
+    image.isSVG = isSVGPath(image.costumeFile);
+    bool decoded = false;
+    if (image.isSVG) {
+        decoded = SvgCache::add(image.id, fileData, fileSize) && SvgCache::getSize(image.id, image.width, image.height);
+        std::shared_ptr<const SvgCache::Raster> raster = decoded ? SvgCache::rasterize(image.id, 1.0f) : nullptr;
+        if (raster) image.rgba = raster->rgba;
+    } else {
+        int components;
+        unsigned char *rgba = stbi_load_from_memory(static_cast<const unsigned char *>(fileData), static_cast<int>(fileSize),
+                                                    &image.width, &image.height, &components, 4);
+        if (rgba) {
+            image.rgba.assign(rgba, rgba + static_cast<size_t>(image.width) * image.height * 4);
+            stbi_image_free(rgba);
+            decoded = true;
+        }
+    }
+    return decoded;
+}
+
+void ImageLoader::upload(DecodedImage &image) {
+    HeadlessImage headlessImage;
+    headlessImage.width = image.width;
+    headlessImage.height = image.height;
+    headlessImage.isSVG = image.isSVG;
+    // count what the same image would take as a texture on the SDL build
+    headlessImage.memorySize = static_cast<size_t>(image.width) * image.height * 4;
+    if (!image.rgba.empty()) CollisionMask::build(image.id, image.rgba.data(), image.width, image.height, image.width * 4);
+    addImage(image.id, headlessImage, image.prefetched);
+}
+
+void Image::freeImage(const std::string &costumeId) {
+    auto imageIt = headlessImages.find(costumeId);
+    if (imageIt != headlessImages.end()) {
+        MemoryTracker::deallocateVRAM(imageIt->second.memorySize);
+        headlessImages.erase(imageIt);
+        AssetCache::remove(costumeId);
+        SvgCache::remove(costumeId);
+    }
+}
+
+void Image::cleanupImages() {
+    for (auto &[id, image] : headlessImages) {
+        AssetCache::remove(id);
+        MemoryTracker::deallocateVRAM(image.memorySize);
+    }
+    headlessImages.clear();
+    SvgCache::clear();
+}
+
+void Image::queueFreeImage(const std::string &costumeId) {
+}
+
+/**
+ * Lets `AssetCache` free the least recently used images, exactly when the SDL build would.
+ */
+void Image::FlushImages() {
+    AssetCache::endFrame();
+}
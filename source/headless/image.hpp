@@ -0,0 +1,20 @@
+#pragma once
+#include "assetCache.hpp"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+/**
+ * A costume in the headless build. Only the size and the collision mask are kept, the pixels are thrown away after decoding.
+ */
+struct HeadlessImage {
+    int width = 0;
+    int height = 0;
+    size_t memorySize = 0;
+    bool isSVG = false;
+    float rasterScale = 1.0f;                // the scale an SVG's pixels were last rasterized at
+    double wantedScale = 0.0;                // the largest scale the SVG got drawn at this frame
+    AssetCache::Entry *cacheEntry = nullptr; // touched whenever the image gets drawn
+};
+
+extern std::unordered_map<std::string, HeadlessImage> headlessImages;
@@ -0,0 +1,72 @@
+#include "input.hpp"
+#include "blockExecutor.hpp"
+#include "headless.hpp"
+#include "sprite.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern bool useCustomUsername;
+extern std::string customUsername;
+
+static std::vector<int> heldKeys; // key ids
+static bool mouseHeld = false;
+static size_t nextEventIndex = 0;
+
+std::vector<int> Input::getTouchPosition() {
+    return {mousePointer.x, mousePointer.y};
+}
+
+/**
+ * Applies every scripted event up to the current tick, then acts like the SDL
+ * backend would with those keys and mouse buttons held.
+ */
+void Input::getInput() {
+    clearKeyStates();
+    mousePointer.isPressed = false;
+    mousePointer.isMoving = false;
+
+    const std::vector<Headless::InputEvent> &events = Headless::inputEvents;
+    while (nextEventIndex < events.size() && events[nextEventIndex].tick <= Headless::ticksRun) {
+        const Headless::InputEvent &event = events[nextEventIndex++];
+        switch (event.type) {
+        case Headless::InputEvent::KEY_DOWN: {
+            const int keyId = getKeyId(event.text);
+            if (std::find(heldKeys.begin(), heldKeys.end(), keyId) == heldKeys.end())
+                heldKeys.push_back(keyId);
+            break;
+        }
+        case Headless::InputEvent::KEY_UP:
+            heldKeys.erase(std::remove(heldKeys.begin(), heldKeys.end(), getKeyId(event.text)), heldKeys.end());
+            break;
+        case Headless::InputEvent::MOUSE_MOVE:
+            mousePointer.isMoving = mousePointer.x != event.x || mousePointer.y != event.y;
+            mousePointer.x = event.x;
+            mousePointer.y = event.y;
+            break;
+        case Headless::InputEvent::MOUSE_DOWN:
+            mouseHeld = true;
+            break;
+        case Headless::InputEvent::MOUSE_UP:
+            mouseHeld = false;
+            break;
+        case Headless::InputEvent::ANSWER:
+            break;
+        }
+    }
+
+    for (int keyId : heldKeys) {
+        pressKey(keyId);
+    }
+    updateKeyStates();
+
+    mousePointer.isPressed = mouseHeld;
+    doSpriteClicking();
+}
+
+std::string Input::getUsername() {
+    if (useCustomUsername) {
+        return customUsername;
+    }
+    return "Player";
+}
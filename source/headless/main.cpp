@@ -0,0 +1,92 @@
+#include "assetCache.hpp"
+#include "diskCache.hpp"
+#include "headless.hpp"
+#include "input.hpp"
+#include "inputRecorder.hpp"
+#include "interpret.hpp"
+#include "render.hpp"
+#include "unzip.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static void printUsage(const char *program) {
+    printf("Usage: %s <project.sb3 | unpacked project folder> [options]\n", program);
+    printf("  --ticks <n>     number of ticks (frames) to run for (default %d)\n", Headless::maxTicks);
+    printf("  --seed <n>      seed for random numbers (default 0)\n");
+    printf("  --input <file>  scripted input to play back\n");
+    printf("  --record <file> record the input the project sees\n");
+    printf("  --replay <file> replay recorded input, stopping when it ends\n");
+    printf("  --cache-budget <bytes> memory loaded costumes and sounds can take up together (default %zu)\n", AssetCache::getBudget());
+    printf("  --disk-cache <folder> keep decoded costumes and sounds in this folder between runs\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string projectPath;
+    std::string inputScript;
+    unsigned int seed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--ticks" && hasValue) {
+            Headless::maxTicks = std::atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--input" && hasValue) {
+            inputScript = argv[++i];
+        } else if (arg == "--record" && hasValue) {
+            InputRecorder::recordPath = argv[++i];
+        } else if (arg == "--replay" && hasValue) {
+            InputRecorder::replayPath = argv[++i];
+        } else if (arg == "--cache-budget" && hasValue) {
+            AssetCache::setBudget(static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10)));
+        } else if (arg == "--disk-cache" && hasValue) {
+            std::string folder = argv[++i];
+            if (!folder.empty() && folder.back() != '/') folder += '/';
+            DiskCache::setFolder(folder);
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (projectPath.empty() && arg[0] != '-') {
+            projectPath = arg;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (projectPath.empty() || Headless::maxTicks <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!inputScript.empty() && !Headless::loadInputScript(inputScript)) return 1;
+
+    if (!Render::Init()) return 1;
+    srand(seed);
+    Input::applyControls();
+
+    // unpacked projects are given as a folder, same as picking one from the main menu
+    while (projectPath.size() > 1 && projectPath.back() == '/')
+        projectPath.pop_back();
+    Unzip::filePath = projectPath;
+    Headless::startLoading();
+    if (!Unzip::load()) {
+        Log::logError("Could not load project: " + projectPath);
+        Render::deInit();
+        return 1;
+    }
+
+    Headless::startClock();
+    Scratch::startScratchProject();
+    Headless::finish();
+
+    Render::deInit();
+    Headless::printReport();
+    return 0;
+}
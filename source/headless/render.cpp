@@ -0,0 +1,125 @@
+#include "../scratch/render.hpp"
+#include "../scratch/audio.hpp"
+#include "../scratch/image.hpp"
+#include "assetCache.hpp"
+#include "headless.hpp"
+#include "image.hpp"
+#include "imageLoader.hpp"
+#include "interpret.hpp"
+#include "perfOverlay.hpp"
+#include "spatialGrid.hpp"
+#include "sprite.hpp"
+#include "svgCache.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+Render::RenderModes Render::renderMode = Render::TOP_SCREEN_ONLY;
+bool Render::hasFrameBegan;
+std::vector<Monitor> Render::visibleVariables;
+std::unordered_map<std::string, TextObject *> Render::monitorTexts;
+std::chrono::system_clock::time_point Render::startTime = std::chrono::system_clock::now();
+std::chrono::system_clock::time_point Render::endTime = std::chrono::system_clock::now();
+bool Render::debugMode = false;
+
+bool Render::Init() {
+    return true;
+}
+
+void Render::deInit() {
+    Image::cleanupImages();
+    SoundPlayer::cleanupAudio();
+    SoundPlayer::deinit();
+}
+
+void *Render::getRenderer() {
+    return nullptr;
+}
+
+int Render::getWidth() {
+    return Scratch::projectWidth;
+}
+
+int Render::getHeight() {
+    return Scratch::projectHeight;
+}
+
+void Render::beginFrame(int screen, int colorR, int colorG, int colorB) {
+    hasFrameBegan = true;
+}
+
+void Render::endFrame(bool shouldFlush) {
+    hasFrameBegan = false;
+    if (shouldFlush) Image::FlushImages();
+}
+
+void Render::drawBox(int w, int h, int x, int y, int colorR, int colorG, int colorB, int colorA) {
+}
+
+/**
+ * Nothing gets drawn, but sprite sizes still come from the loaded costumes
+ * exactly like the SDL renderer, so collision and bounds behave the same.
+ */
+void Render::renderSprites() {
+    TRACE_SCOPE("renderSprites", "render");
+    // costumes are always ready by the time they get drawn, so results don't depend on how fast the worker threads are
+    ImageLoader::finishAll();
+    std::vector<std::pair<std::string, HeadlessImage *>> drawnSVGs;
+    for (Sprite *currentSprite : sprites) {
+        if (!currentSprite->visible) continue;
+
+        const Costume &costume = currentSprite->costumes[currentSprite->currentCostume];
+        auto imgFind = headlessImages.find(costume.id);
+        PerfOverlay::countImageLookup(imgFind != headlessImages.end());
+        if (imgFind == headlessImages.end()) continue;
+
+        HeadlessImage &image = imgFind->second;
+        AssetCache::touch(image.cacheEntry);
+        SpatialGrid::setRotationCenter(currentSprite, costume.rotationCenterX, costume.rotationCenterY);
+        SpatialGrid::setSpriteSize(currentSprite, image.width / 2, image.height / 2);
+
+        if (image.isSVG) {
+            if (image.wantedScale == 0.0) drawnSVGs.emplace_back(costume.id, &image);
+            image.wantedScale = std::max(image.wantedScale, currentSprite->size * 0.01);
+        }
+    }
+
+    // swap SVGs to the resolution their largest sprite would be drawn at, counting the memory the SDL build would use
+    for (auto &[id, image] : drawnSVGs) {
+        const float rasterScale = SvgCache::getScaleBucket(image->width, image->height, image->wantedScale);
+        image->wantedScale = 0.0;
+        if (rasterScale == image->rasterScale) continue;
+        std::shared_ptr<const SvgCache::Raster> raster = SvgCache::request(id, rasterScale);
+        if (!raster) continue;
+        MemoryTracker::deallocateVRAM(image->memorySize);
+        image->memorySize = raster->rgba.size();
+        MemoryTracker::allocateVRAM(image->memorySize);
+        AssetCache::setCost(image->cacheEntry, image->memorySize);
+        image->rasterScale = rasterScale;
+    }
+
+    Headless::blocksRun += blocksRun;
+    Headless::peakVRAMUsage = std::max(Headless::peakVRAMUsage, MemoryTracker::getVRAMUsage());
+    Headless::ticksRun++;
+
+    // the main loop cleans the project up right after a stop, so grab the results now
+    if (Scratch::shouldStop) Headless::finish();
+
+    Image::FlushImages();
+    SoundPlayer::flushAudio();
+}
+
+void Render::renderVisibleVariables() {
+}
+
+bool Render::appShouldRun() {
+    if (toExit) return false;
+    if (Headless::ticksRun >= Headless::maxTicks) {
+        Headless::finish();
+        return false;
+    }
+    // fixed timestep, so every tick sees exactly one frame's worth of time pass
+    Timer::advanceVirtualTime(1000000LL / std::max(Scratch::FPS, 1));
+    return true;
+}
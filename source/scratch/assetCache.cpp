@@ -0,0 +1,133 @@
+#include "assetCache.hpp"
+#include "os.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+/**
+ * A list of entries from least to most recently used, linked through the entries themselves.
+ */
+struct EntryList {
+    AssetCache::Entry *oldest = nullptr;
+    AssetCache::Entry *newest = nullptr;
+
+    void append(AssetCache::Entry *entry) {
+        entry->previous = newest;
+        entry->next = nullptr;
+        if (newest != nullptr) newest->next = entry;
+        else oldest = entry;
+        newest = entry;
+    }
+
+    void unlink(AssetCache::Entry *entry) {
+        if (entry->previous != nullptr) entry->previous->next = entry->next;
+        else oldest = entry->next;
+        if (entry->next != nullptr) entry->next->previous = entry->previous;
+        else newest = entry->previous;
+        entry->previous = nullptr;
+        entry->next = nullptr;
+    }
+};
+
+// entries never move once they're in the map, so owners can hold pointers to them
+std::unordered_map<std::string, AssetCache::Entry> entries;
+EntryList prefetchedEntries; // evicted first, oldest first
+EntryList usedEntries;
+size_t usage = 0;
+size_t budget = 0; // 0 until it's first needed, since the limits can't be read during static initialization
+uint32_t frame = 0;
+AssetCache::Stats stats;
+
+EntryList &listOf(const AssetCache::Entry *entry) {
+    return entry->prefetched ? prefetchedEntries : usedEntries;
+}
+
+/**
+ * Picks the asset to free next.
+ * @return The oldest prefetched asset, or else the least recently used one, or `nullptr` if every asset was used this frame.
+ */
+AssetCache::Entry *pickVictim() {
+    if (prefetchedEntries.oldest != nullptr) return prefetchedEntries.oldest;
+    AssetCache::Entry *entry = usedEntries.oldest;
+    if (entry != nullptr && entry->lastUsedFrame != frame) return entry;
+    return nullptr;
+}
+
+} // namespace
+
+AssetCache::Entry *AssetCache::add(const std::string &key, size_t cost, Evictor evictor, bool prefetched) {
+    remove(key);
+    Entry &entry = entries[key];
+    entry.key = key;
+    entry.cost = cost;
+    entry.evictor = evictor;
+    entry.lastUsedFrame = frame;
+    entry.prefetched = prefetched;
+    listOf(&entry).append(&entry);
+    usage += cost;
+    return &entry;
+}
+
+void AssetCache::touch(Entry *entry) {
+    if (entry->lastUsedFrame == frame && !entry->prefetched) return;
+    listOf(entry).unlink(entry);
+    entry->prefetched = false;
+    entry->lastUsedFrame = frame;
+    usedEntries.append(entry);
+}
+
+void AssetCache::countLookup(bool loaded) {
+    if (loaded) stats.hits++;
+    else stats.misses++;
+}
+
+void AssetCache::setCost(Entry *entry, size_t cost) {
+    usage = usage - entry->cost + cost;
+    entry->cost = cost;
+}
+
+void AssetCache::remove(const std::string &key) {
+    auto entryIt = entries.find(key);
+    if (entryIt == entries.end()) return;
+    Entry &entry = entryIt->second;
+    listOf(&entry).unlink(&entry);
+    usage -= entry.cost;
+    entries.erase(entryIt);
+}
+
+void AssetCache::endFrame() {
+    const size_t limit = getBudget();
+    while (usage > limit) {
+        Entry *victim = pickVictim();
+        if (victim == nullptr) break;
+
+        // the owner may look the key up while freeing the asset, so it can't point into the entry
+        const std::string key = victim->key;
+        const Evictor evictor = victim->evictor;
+        stats.evictions++;
+        stats.bytesEvicted += victim->cost;
+        TRACE_INSTANT("evict " + key, "asset");
+        remove(key);
+        evictor(key);
+    }
+    frame++;
+}
+
+void AssetCache::setBudget(size_t bytes) {
+    budget = bytes;
+}
+
+size_t AssetCache::getBudget() {
+    if (budget == 0) return std::min(MemoryTracker::getMaxRamUsage(), MemoryTracker::getMaxVRAMUsage()) / 2;
+    return budget;
+}
+
+size_t AssetCache::getUsage() {
+    return usage;
+}
+
+const AssetCache::Stats &AssetCache::getStats() {
+    return stats;
+}
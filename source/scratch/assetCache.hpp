@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Keeps track of every loaded costume and sound, and frees the ones that matter least once together
+ * they go over one memory budget, whether their bytes are in RAM or VRAM.
+ * Assets are freed least recently used first, with prefetched assets nothing has used yet going before all of them.
+ * Assets used during the current frame, like the costumes of visible sprites and sounds that are playing, are never freed.
+ * Adding, touching and freeing an asset all take constant time.
+ */
+class AssetCache {
+  public:
+    /**
+     * Frees an asset the cache picked. Called with the key the asset was added under,
+     * after the cache has already forgotten it.
+     */
+    using Evictor = void (*)(const std::string &key);
+
+    /**
+     * An asset the cache keeps track of. Owners hold on to it so touching the asset doesn't need a lookup.
+     */
+    struct Entry {
+        std::string key;
+        size_t cost = 0; // bytes the asset takes up
+        Evictor evictor = nullptr;
+        uint32_t lastUsedFrame = 0;
+        bool prefetched = false; // not used since it was prefetched
+        Entry *previous = nullptr;
+        Entry *next = nullptr;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;         // lookups that found the asset loaded already
+        uint64_t misses = 0;       // lookups that had to load the asset first
+        uint64_t evictions = 0;    // assets freed to stay under the budget
+        uint64_t bytesEvicted = 0; // bytes freed to stay under the budget
+    };
+
+    /**
+     * Starts keeping track of an asset.
+     * @param key unique across every kind of asset, sounds keep their file extension so they can't clash with costumes
+     * @param cost bytes the asset takes up
+     * @param evictor frees the asset if the cache needs the room
+     * @param prefetched `true` if the asset was loaded before anything asked for it
+     * @return The asset's entry, valid until the asset gets removed or evicted.
+     */
+    static Entry *add(const std::string &key, size_t cost, Evictor evictor, bool prefetched = false);
+
+    /**
+     * Marks an asset as used this frame, so it's the last one to get freed.
+     * Doesn't count as a lookup, since renderers touch every costume they draw, every frame.
+     * @param entry
+     */
+    static void touch(Entry *entry);
+
+    /**
+     * Counts an asset being asked for, like a costume being switched to or a sound being played.
+     * @param loaded whether the asset was loaded already
+     */
+    static void countLookup(bool loaded);
+
+    /**
+     * Changes how many bytes an asset takes up, like when an SVG gets rasterized at another resolution.
+     * @param entry
+     * @param cost
+     */
+    static void setCost(Entry *entry, size_t cost);
+
+    /**
+     * Forgets an asset its owner freed. Does nothing if the cache doesn't know about it.
+     * @param key
+     */
+    static void remove(const std::string &key);
+
+    /**
+     * Frees assets until everything fits in the budget again, then starts a new frame.
+     * Called by renderers once a frame, after everything has been drawn.
+     */
+    static void endFrame();
+
+    /**
+     * Sets how many bytes assets can take up together.
+     * @param bytes or 0 to go back to the default, half of the RAM or VRAM limit, whichever is smaller
+     */
+    static void setBudget(size_t bytes);
+
+    /**
+     * Gets how many bytes assets can take up together.
+     */
+    static size_t getBudget();
+
+    /**
+     * Gets how many bytes every asset the cache knows about takes up.
+     */
+    static size_t getUsage();
+
+    /**
+     * Gets the hit, miss and eviction counts since the program started.
+     */
+    static const Stats &getStats();
+};
@@ -8,16 +8,23 @@
 #include "blocks/procedure.hpp"
 #include "blocks/sensing.hpp"
 #include "blocks/sound.hpp"
+#include "drawOrder.hpp"
 #include "interpret.hpp"
 #include "math.hpp"
 #include "os.hpp"
+#include "prefetcher.hpp"
+#include "spatialGrid.hpp"
 #include "sprite.hpp"
+#include "trace.hpp"
 #include "unzip.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cstddef>
+#include <functional>
 #include <iterator>
+#include <queue>
 #include <ratio>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -28,7 +35,28 @@ extern std::unique_ptr<MistConnection> cloudConnection;
 #endif
 
 size_t blocksRun = 0;
-Timer BlockExecutor::timer;
+Timer BlockExecutor::timer(true);
+
+namespace {
+struct SleepingChain {
+    long long wakeTimeUs;
+    Sprite *sprite;
+    std::string spriteId; // the sprite could be a clone that gets deleted while it sleeps
+    BlockChain *chain;
+    unsigned int generation;
+
+    bool operator>(const SleepingChain &other) const {
+        return wakeTimeUs > other.wakeTimeUs;
+    }
+};
+} // namespace
+
+// sleeping chains, soonest to wake up first
+static std::priority_queue<SleepingChain, std::vector<SleepingChain>, std::greater<SleepingChain>> sleepQueue;
+static Timer sleepClock(true);
+
+// chains sleeping on a sound, by the sound's full name. Their `wakeTimeUs` goes unused.
+static std::unordered_map<std::string, std::vector<SleepingChain>> soundWaiters;
 
 BlockExecutor::BlockExecutor() {
     registerHandlers();
@@ -165,6 +193,8 @@ void BlockExecutor::registerHandlers() {
     valueHandlers["sensing_keyoptions"] = SensingBlocks::keyPressed; // Menu variant
     valueHandlers["sensing_touchingobject"] = SensingBlocks::touchingObject;
     valueHandlers["sensing_touchingobjectmenu"] = SensingBlocks::touchingObject; // Menu variant
+    valueHandlers["sensing_touchingcolor"] = SensingBlocks::touchingColor;
+    valueHandlers["sensing_coloristouchingcolor"] = SensingBlocks::colorIsTouchingColor;
     valueHandlers["sensing_mousedown"] = SensingBlocks::mouseDown;
     valueHandlers["sensing_username"] = SensingBlocks::username;
 
@@ -240,19 +270,44 @@ BlockResult BlockExecutor::executeBlock(Block &block, Sprite *sprite, bool *with
     return BlockResult::CONTINUE;
 }
 
+/**
+ * Checks if a sleeping chain is still asleep the way it was when it got queued,
+ * and not finished, restarted, deleted or gone back to sleep since.
+ */
+static bool isStillAsleep(const SleepingChain &sleeper) {
+    return !sleeper.sprite->isDeleted && sleeper.sprite->id == sleeper.spriteId && sleeper.chain->sleepGeneration == sleeper.generation;
+}
+
+/**
+ * Wakes every chain in the sleep queue that's due by now.
+ */
+static void wakeSleepingChains() {
+    const long long now = sleepClock.getTimeUs();
+    while (!sleepQueue.empty() && sleepQueue.top().wakeTimeUs <= now) {
+        const SleepingChain &sleeper = sleepQueue.top();
+        if (isStillAsleep(sleeper)) sleeper.chain->sleeping = false;
+        sleepQueue.pop();
+    }
+}
+
 void BlockExecutor::runRepeatBlocks() {
+    TRACE_SCOPE("runRepeatBlocks", "logic");
     blocksRun = 0;
     bool withoutRefresh = false;
+    wakeSleepingChains();
 
     // repeat ONLY the block most recently added to the repeat chain,,,
     for (auto &sprite : sprites) {
         for (auto &[id, blockChain] : sprite->blockChains) {
             auto &repeatList = blockChain.blocksToRepeat;
-            if (!repeatList.empty()) {
+            if (!repeatList.empty() && !blockChain.sleeping) {
                 std::string toRepeat = repeatList.back();
                 if (!toRepeat.empty()) {
                     Block *toRun = &sprite->blocks[toRepeat];
+                    // a chain started again from its hat while it waited runs whatever it's doing now
+                    if (blockChain.suspended && toRun->broadcastWaitCount > 0) continue;
                     if (toRun != nullptr) {
+                        TRACE_SCOPE(sprite->name + ": " + toRun->opcode, "script");
                         executor.runBlock(*toRun, sprite, &withoutRefresh, true);
                     }
                 }
@@ -271,7 +326,15 @@ void BlockExecutor::runRepeatBlocks() {
                 }
             }
         }
+        // anything waiting on the clone's scripts would never hear back otherwise
+        for (auto &[id, chain] : toDelete->blockChains) {
+            if (chain.blocksToRepeat.empty()) continue;
+            chain.blocksToRepeat.clear();
+            finishBlockChain(chain);
+        }
         toDelete->isDeleted = true;
+        SpatialGrid::markMoved(toDelete);
+        DrawOrder::remove(toDelete);
     }
     sprites.erase(std::remove_if(sprites.begin(), sprites.end(),
                                  [](Sprite *s) { return s->toDelete; }),
@@ -350,46 +413,64 @@ BlockResult BlockExecutor::runCustomBlock(Sprite *sprite, Block &block, Block *c
     return BlockResult::CONTINUE;
 }
 
-std::vector<std::pair<Block *, Sprite *>> BlockExecutor::runBroadcast(std::string broadcastToRun) {
-    std::vector<std::pair<Block *, Sprite *>> blocksToRun;
+/**
+ * Starts every "when I receive" block for a broadcast.
+ * @param broadcastId
+ * @param blocksToRun gets every started block added to it
+ */
+static void startBroadcastReceivers(int broadcastId, std::vector<std::pair<Block *, Sprite *>> &blocksToRun) {
+    if (broadcastId < 0) return;
+    const size_t firstReceiver = blocksToRun.size();
 
-    // find all matching "when I receive" blocks
-    for (auto *currentSprite : sprites) {
-        for (auto &[id, block] : currentSprite->blocks) {
-            if (block.opcode == "event_whenbroadcastreceived" &&
-                Scratch::getFieldValue(block, "BROADCAST_OPTION") == broadcastToRun) {
-                blocksToRun.push_back({&block, currentSprite});
-            }
+    // gather first, since receivers can create clones and change `sprites`
+    for (Sprite *currentSprite : sprites) {
+        auto hatFind = currentSprite->broadcastHats.find(broadcastId);
+        if (hatFind == currentSprite->broadcastHats.end()) continue;
+        for (Block *hat : hatFind->second) {
+            blocksToRun.push_back({hat, currentSprite});
         }
     }
 
-    // run each matching block
-    for (auto &[blockPtr, spritePtr] : blocksToRun) {
+    for (size_t i = firstReceiver; i < blocksToRun.size(); i++) {
+        auto &[blockPtr, spritePtr] = blocksToRun[i];
+        TRACE_SCOPE(spritePtr->name + ": when I receive " + broadcastNames[broadcastId], "script");
         executor.runBlock(*blockPtr, spritePtr);
     }
-
-    return blocksToRun;
 }
 
-std::vector<std::pair<Block *, Sprite *>> BlockExecutor::runBroadcasts() {
+std::vector<std::pair<Block *, Sprite *>> BlockExecutor::runBroadcast(int broadcastId) {
     std::vector<std::pair<Block *, Sprite *>> blocksToRun;
+    startBroadcastReceivers(broadcastId, blocksToRun);
+    return blocksToRun;
+}
 
-    if (broadcastQueue.empty()) {
-        return blocksToRun;
+void BlockExecutor::runBroadcasts() {
+    TRACE_SCOPE("runBroadcasts", "logic");
+    if (broadcastQueue.empty()) return;
+
+    // kept between frames so draining the queue doesn't allocate
+    static std::vector<std::pair<Block *, Sprite *>> receivers;
+    static std::vector<int> nextFrame;
+    static std::vector<unsigned int> lastRunFrame; // by broadcast id
+    static unsigned int frame = 0;
+    frame++;
+    if (lastRunFrame.size() < broadcastNames.size()) lastRunFrame.resize(broadcastNames.size(), 0);
+
+    int broadcastId;
+    while (broadcastQueue.pop(broadcastId)) {
+        if (lastRunFrame[broadcastId] == frame) {
+            nextFrame.push_back(broadcastId);
+            continue;
+        }
+        lastRunFrame[broadcastId] = frame;
+        receivers.clear();
+        startBroadcastReceivers(broadcastId, receivers);
     }
 
-    std::string currentBroadcast = broadcastQueue.front();
-    broadcastQueue.erase(broadcastQueue.begin());
-
-    auto results = runBroadcast(currentBroadcast);
-    blocksToRun.insert(blocksToRun.end(), results.begin(), results.end());
-
-    if (!broadcastQueue.empty()) {
-        auto moreResults = runBroadcasts();
-        blocksToRun.insert(blocksToRun.end(), moreResults.begin(), moreResults.end());
+    for (int deferred : nextFrame) {
+        broadcastQueue.push(deferred);
     }
-
-    return blocksToRun;
+    nextFrame.clear();
 }
 
 std::vector<Block *> BlockExecutor::runAllBlocksByOpcode(std::string opcodeToFind) {
@@ -400,6 +481,7 @@ std::vector<Block *> BlockExecutor::runAllBlocksByOpcode(std::string opcodeToFin
             if (data.opcode == opcodeToFind) {
                 // runBlock(data,currentSprite);
                 blocksRun.push_back(&data);
+                TRACE_SCOPE(currentSprite->name + ": " + opcodeToFind, "script");
                 executor.runBlock(data, currentSprite);
             }
         }
@@ -623,10 +705,18 @@ Value BlockExecutor::getCustomBlockValue(std::string valueName, Sprite *sprite,
 }
 
 void BlockExecutor::addToRepeatQueue(Sprite *sprite, Block *block) {
-    auto &repeatList = sprite->blockChains[block->blockChainID].blocksToRepeat;
+    BlockChain &chain = sprite->blockChains[block->blockChainID];
+    auto &repeatList = chain.blocksToRepeat;
     if (std::find(repeatList.begin(), repeatList.end(), block->id) == repeatList.end()) {
+        // the script keeps running across frames, so the costumes it switches to can load in the meantime
+        if (repeatList.empty()) Prefetcher::scriptRunning(block->blockChainID);
         block->isRepeating = true;
         repeatList.push_back(block->id);
+        // the chain was started again while it slept, and is waiting on something else now
+        if (chain.sleeping) {
+            chain.sleeping = false;
+            chain.sleepGeneration++;
+        }
     }
 }
 
@@ -638,8 +728,72 @@ void BlockExecutor::removeFromRepeatQueue(Sprite *sprite, Block *block) {
             block->isRepeating = false;
             block->repeatTimes = -1;
             blocksToRepeat.pop_back();
+            if (blocksToRepeat.empty()) finishBlockChain(it->second);
+        }
+    }
+}
+
+void BlockExecutor::finishBlockChain(BlockChain &chain) {
+    chain.suspended = false;
+    chain.sleeping = false;
+    chain.sleepGeneration++;
+    for (const ChainWaiter &waiter : chain.waiters) {
+        if (waiter.sprite->isDeleted || waiter.sprite->id != waiter.spriteId) continue;
+        auto blockFind = waiter.sprite->blocks.find(waiter.blockId);
+        if (blockFind == waiter.sprite->blocks.end()) continue;
+        Block &waitingBlock = blockFind->second;
+
+        // the `broadcast and wait` was stopped or started again since it began waiting
+        if (waitingBlock.broadcastWaitGeneration != waiter.generation) continue;
+
+        if (--waitingBlock.broadcastWaitCount == 0) {
+            auto chainFind = waiter.sprite->blockChains.find(waitingBlock.blockChainID);
+            if (chainFind != waiter.sprite->blockChains.end()) chainFind->second.suspended = false;
         }
     }
+    chain.waiters.clear();
+}
+
+void BlockExecutor::sleepUntilElapsed(Sprite *sprite, Block &block, int milliseconds, bool *withoutScreenRefresh) {
+    if (withoutScreenRefresh && *withoutScreenRefresh) return;
+
+    // wake up right when the block's own timer gets there, so it sees the same time it would have by checking every frame
+    const long long wakeTimeUs = sleepClock.getTimeUs() - block.waitTimer.getTimeUs() + static_cast<long long>(milliseconds) * 1000;
+
+    BlockChain &chain = sprite->blockChains[block.blockChainID];
+    chain.sleeping = true;
+    chain.sleepGeneration++;
+    sleepQueue.push({wakeTimeUs, sprite, sprite->id, &chain, chain.sleepGeneration});
+}
+
+void BlockExecutor::sleepUntilSoundDone(Sprite *sprite, Block &block, const std::string &soundId, int milliseconds, bool *withoutScreenRefresh) {
+    if (withoutScreenRefresh && *withoutScreenRefresh) return;
+    sleepUntilElapsed(sprite, block, milliseconds, withoutScreenRefresh);
+
+    // drop the chains that stopped waiting since, so a sound that never gets stopped doesn't pile them up
+    std::vector<SleepingChain> &waiters = soundWaiters[soundId];
+    waiters.erase(std::remove_if(waiters.begin(), waiters.end(), [](const SleepingChain &sleeper) { return !isStillAsleep(sleeper); }), waiters.end());
+
+    BlockChain &chain = sprite->blockChains[block.blockChainID];
+    waiters.push_back({0, sprite, sprite->id, &chain, chain.sleepGeneration});
+}
+
+void BlockExecutor::wakeSoundWaiters(const std::string &soundId) {
+    auto waitersFind = soundWaiters.find(soundId);
+    if (waitersFind == soundWaiters.end()) return;
+    for (const SleepingChain &sleeper : waitersFind->second) {
+        if (!isStillAsleep(sleeper)) continue;
+        sleeper.chain->sleeping = false;
+        // so its entry in the sleep queue doesn't wake it again later
+        sleeper.chain->sleepGeneration++;
+    }
+    soundWaiters.erase(waitersFind);
+}
+
+void BlockExecutor::clearSleepingChains() {
+    sleepQueue = decltype(sleepQueue)();
+    soundWaiters.clear();
+    sleepClock.start();
 }
 
 bool BlockExecutor::hasActiveRepeats(Sprite *sprite, std::string blockChainID) {
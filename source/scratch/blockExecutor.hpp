@@ -63,17 +63,58 @@ class BlockExecutor {
     static BlockResult runCustomBlock(Sprite *sprite, Block &block, Block *callerBlock, bool *withoutScreenRefresh);
 
     /**
-     * Runs and executes every block currently in the `broadcastQueue`.
-     * @return a Vector pair of every block that was run.
+     * Marks a chain's thread as finished, waking every `broadcast and wait` that was waiting on it.
+     * Must be called whenever a chain's `blocksToRepeat` becomes empty.
+     * @param chain
+     */
+    static void finishBlockChain(BlockChain &chain);
+
+    /**
+     * Puts the chain a repeating block is in to sleep until the block's `waitTimer` reaches `milliseconds`,
+     * so `runRepeatBlocks()` doesn't run the block every frame just to check its timer.
+     * Does nothing while running without screen refresh, since those chains never go through `runRepeatBlocks()`.
+     * @param sprite Pointer to the Sprite the block is inside.
+     * @param block The block that's waiting.
+     * @param milliseconds When the block's `waitTimer` is due.
+     * @param withoutScreenRefresh Whether or not the block is running without screen refresh.
+     */
+    static void sleepUntilElapsed(Sprite *sprite, Block &block, int milliseconds, bool *withoutScreenRefresh);
+
+    /**
+     * Like `sleepUntilElapsed()`, but `wakeSoundWaiters()` also wakes the chain early,
+     * for blocks that wait on a sound that can be stopped before it's done.
+     * @param sprite Pointer to the Sprite the block is inside.
+     * @param block The block that's waiting.
+     * @param soundId Full name of the sound being waited on.
+     * @param milliseconds When the block's `waitTimer` is due.
+     * @param withoutScreenRefresh Whether or not the block is running without screen refresh.
+     */
+    static void sleepUntilSoundDone(Sprite *sprite, Block &block, const std::string &soundId, int milliseconds, bool *withoutScreenRefresh);
+
+    /**
+     * Wakes every chain sleeping on a sound, so it checks on the sound again. Called when the sound gets stopped.
+     * @param soundId Full name of the sound.
+     */
+    static void wakeSoundWaiters(const std::string &soundId);
+
+    /**
+     * Forgets every sleeping chain and restarts the sleep queue's clock. Called when a project starts and stops.
+     */
+    static void clearSleepingChains();
+
+    /**
+     * Runs every broadcast in the `broadcastQueue`, including ones queued by the receivers themselves.
+     * A broadcast that already ran this frame waits for the next one instead, so receivers that
+     * broadcast to each other can't loop forever.
      */
-    static std::vector<std::pair<Block *, Sprite *>> runBroadcasts();
+    static void runBroadcasts();
 
     /**
      * Runs and executes a single broadcast
-     * @param broadcastToRun string name of the broadcast you want to run.
+     * @param broadcastId id of the broadcast you want to run, from `getBroadcastId()`.
      * @return a Vector pair of every block that was run.
      */
-    static std::vector<std::pair<Block *, Sprite *>> runBroadcast(std::string broadcastToRun);
+    static std::vector<std::pair<Block *, Sprite *>> runBroadcast(int broadcastId);
 
     /**
      * Executes a `block` function that's registered through `valueHandlers`.
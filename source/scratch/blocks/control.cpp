@@ -1,8 +1,10 @@
 #include "control.hpp"
 #include "blockExecutor.hpp"
+#include "drawOrder.hpp"
 #include "interpret.hpp"
 #include "math.hpp"
 #include "os.hpp"
+#include "spatialGrid.hpp"
 #include "sprite.hpp"
 #include "value.hpp"
 #include <iostream>
@@ -108,16 +110,20 @@ BlockResult ControlBlocks::createCloneOf(Block &block, Sprite *sprite, bool *wit
 
     Sprite *spriteToClone = getAvailableSprite();
     if (!spriteToClone) return BlockResult::CONTINUE;
+    Sprite *original = nullptr;
     if (Scratch::getFieldValue(*cloneOptions, "CLONE_OPTION") == "_myself_") {
         *spriteToClone = *sprite;
+        original = sprite;
     } else {
         for (Sprite *currentSprite : sprites) {
             if (currentSprite->name == Math::removeQuotations(Scratch::getFieldValue(*cloneOptions, "CLONE_OPTION")) && !currentSprite->isClone) {
                 *spriteToClone = *currentSprite;
+                original = currentSprite;
             }
         }
     }
     spriteToClone->blockChains.clear();
+    indexHatBlocks(spriteToClone);
 
     if (spriteToClone != nullptr && !spriteToClone->name.empty()) {
         spriteToClone->isClone = true;
@@ -127,6 +133,8 @@ BlockResult ControlBlocks::createCloneOf(Block &block, Sprite *sprite, bool *wit
         // Log::log("Cloned " + sprite->name);
         //  add clone to sprite list
         sprites.push_back(spriteToClone);
+        DrawOrder::addBehind(spriteToClone, original);
+        SpatialGrid::markMoved(spriteToClone);
         Sprite *addedSprite = sprites.back();
         // Run "when I start as a clone" scripts for the clone
         for (Sprite *currentSprite : sprites) {
@@ -171,6 +179,7 @@ BlockResult ControlBlocks::stop(Block &block, Sprite *sprite, bool *withoutScree
         }
 
         sprite->blockChains[block.blockChainID].blocksToRepeat.clear();
+        BlockExecutor::finishBlockChain(sprite->blockChains[block.blockChainID]);
         block.shouldStop = true;
         return BlockResult::RETURN;
     }
@@ -188,6 +197,7 @@ BlockResult ControlBlocks::stop(Block &block, Sprite *sprite, bool *withoutScree
                 chainBlock->waitingIfBlock = "";
             }
             chain.blocksToRepeat.clear();
+            BlockExecutor::finishBlockChain(chain);
         }
         return BlockResult::CONTINUE;
     }
@@ -219,10 +229,14 @@ BlockResult ControlBlocks::wait(Block &block, Sprite *sprite, bool *withoutScree
 
     block.repeatTimes -= 1;
 
-    if (block.waitTimer.hasElapsed(block.waitDuration) && block.repeatTimes <= -4) {
-        block.repeatTimes = -1;
-        BlockExecutor::removeFromRepeatQueue(sprite, &block);
-        return BlockResult::CONTINUE;
+    if (block.waitTimer.hasElapsed(block.waitDuration)) {
+        if (block.repeatTimes <= -4) {
+            block.repeatTimes = -1;
+            BlockExecutor::removeFromRepeatQueue(sprite, &block);
+            return BlockResult::CONTINUE;
+        }
+    } else {
+        BlockExecutor::sleepUntilElapsed(sprite, block, block.waitDuration, withoutScreenRefresh);
     }
 
     return BlockResult::RETURN;
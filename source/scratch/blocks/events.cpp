@@ -12,8 +12,16 @@ BlockResult EventBlocks::whenBackdropSwitchesTo(Block &block, Sprite *sprite, bo
     return BlockResult::CONTINUE;
 }
 
+/**
+ * Gets the id of the broadcast a broadcast block sends, only evaluating its input when the message isn't a literal.
+ */
+static int getBroadcastInputId(Block &block, Sprite *sprite) {
+    if (block.broadcastId >= 0) return block.broadcastId;
+    return getBroadcastId(Scratch::getInputValue(block, "BROADCAST_INPUT", sprite).asString());
+}
+
 BlockResult EventBlocks::broadcast(Block &block, Sprite *sprite, bool *withoutScreenRefresh, bool fromRepeat) {
-    broadcastQueue.push_back(Scratch::getInputValue(block, "BROADCAST_INPUT", sprite).asString());
+    broadcastQueue.push(getBroadcastInputId(block, sprite));
     return BlockResult::CONTINUE;
 }
 
@@ -26,18 +34,22 @@ BlockResult EventBlocks::broadcastAndWait(Block &block, Sprite *sprite, bool *wi
     if (block.repeatTimes == -1) {
         block.repeatTimes = -10;
         BlockExecutor::addToRepeatQueue(sprite, &block);
-        block.broadcastsRun = BlockExecutor::runBroadcast(Scratch::getInputValue(block, "BROADCAST_INPUT", sprite).asString());
-    }
 
-    bool shouldEnd = true;
-    for (auto &[blockPtr, spritePtr] : block.broadcastsRun) {
-        if (!spritePtr->blockChains[blockPtr->blockChainID].blocksToRepeat.empty()) {
-            shouldEnd = false;
-            break;
+        // wait on every receiver that didn't finish right away, they wake this chain when they're done
+        block.broadcastWaitGeneration++;
+        block.broadcastWaitCount = 0;
+        for (auto &[blockPtr, spritePtr] : BlockExecutor::runBroadcast(getBroadcastInputId(block, sprite))) {
+            BlockChain &receiverChain = spritePtr->blockChains[blockPtr->blockChainID];
+            if (receiverChain.blocksToRepeat.empty()) continue;
+            receiverChain.waiters.push_back({sprite, sprite->id, block.id, block.broadcastWaitGeneration});
+            block.broadcastWaitCount++;
         }
     }
 
-    if (!shouldEnd) return BlockResult::RETURN;
+    if (block.broadcastWaitCount > 0) {
+        sprite->blockChains[block.blockChainID].suspended = true;
+        return BlockResult::RETURN;
+    }
 
     block.repeatTimes = -1;
     BlockExecutor::removeFromRepeatQueue(sprite, &block);
@@ -45,10 +57,6 @@ BlockResult EventBlocks::broadcastAndWait(Block &block, Sprite *sprite, bool *wi
 }
 
 BlockResult EventBlocks::whenKeyPressed(Block &block, Sprite *sprite, bool *withoutScreenRefresh, bool fromRepeat) {
-    for (std::string button : Input::inputButtons) {
-        if (Scratch::getFieldValue(block, "KEY_OPTION") == button) {
-            return BlockResult::CONTINUE;
-        }
-    }
-    return BlockResult::RETURN;
+    // only started by `Input::updateKeyStates()`, for keys that are held
+    return BlockResult::CONTINUE;
 }
@@ -1,21 +1,20 @@
 #include "looks.hpp"
 #include "blockExecutor.hpp"
-#include "image.hpp"
+#include "drawOrder.hpp"
+#include "imageLoader.hpp"
 #include "interpret.hpp"
 #include "math.hpp"
+#include "prefetcher.hpp"
+#include "spatialGrid.hpp"
 #include "sprite.hpp"
-#include "unzip.hpp"
 #include "value.hpp"
 #include <algorithm>
 #include <cstddef>
 
 BlockResult LooksBlocks::show(Block &block, Sprite *sprite, bool *withoutScreenRefresh, bool fromRepeat) {
+    if (!sprite->visible) Prefetcher::prefetchNextCostumes(sprite);
     sprite->visible = true;
-    if (projectType == UNZIPPED) {
-        Image::loadImageFromFile(sprite->costumes[sprite->currentCostume].fullName);
-    } else {
-        Image::loadImageFromSB3(&Unzip::zipArchive, sprite->costumes[sprite->currentCostume].fullName);
-    }
+    ImageLoader::request(sprite->costumes[sprite->currentCostume].fullName);
     return BlockResult::CONTINUE;
 }
 BlockResult LooksBlocks::hide(Block &block, Sprite *sprite, bool *withoutScreenRefresh, bool fromRepeat) {
@@ -52,12 +51,10 @@ BlockResult LooksBlocks::switchCostumeTo(Block &block, Sprite *sprite, bool *wit
             imageFound = true;
         }
     }
+    if (imageFound) SpatialGrid::markMoved(sprite);
 
-    if (projectType == UNZIPPED) {
-        Image::loadImageFromFile(sprite->costumes[sprite->currentCostume].fullName);
-    } else {
-        Image::loadImageFromSB3(&Unzip::zipArchive, sprite->costumes[sprite->currentCostume].fullName);
-    }
+    ImageLoader::request(sprite->costumes[sprite->currentCostume].fullName);
+    if (imageFound) Prefetcher::prefetchNextCostumes(sprite);
 
     return BlockResult::CONTINUE;
 }
@@ -67,11 +64,9 @@ BlockResult LooksBlocks::nextCostume(Block &block, Sprite *sprite, bool *without
     if (sprite->currentCostume >= static_cast<int>(sprite->costumes.size())) {
         sprite->currentCostume = 0;
     }
-    if (projectType == UNZIPPED) {
-        Image::loadImageFromFile(sprite->costumes[sprite->currentCostume].fullName);
-    } else {
-        Image::loadImageFromSB3(&Unzip::zipArchive, sprite->costumes[sprite->currentCostume].fullName);
-    }
+    SpatialGrid::markMoved(sprite);
+    ImageLoader::request(sprite->costumes[sprite->currentCostume].fullName);
+    Prefetcher::prefetchNextCostumes(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -110,11 +105,8 @@ BlockResult LooksBlocks::switchBackdropTo(Block &block, Sprite *sprite, bool *wi
             }
         }
 
-        if (projectType == UNZIPPED) {
-            Image::loadImageFromFile(currentSprite->costumes[currentSprite->currentCostume].fullName);
-        } else {
-            Image::loadImageFromSB3(&Unzip::zipArchive, currentSprite->costumes[currentSprite->currentCostume].fullName);
-        }
+        ImageLoader::request(currentSprite->costumes[currentSprite->currentCostume].fullName);
+        Prefetcher::prefetchNextCostumes(currentSprite);
     }
 
     for (auto &currentSprite : sprites) {
@@ -142,11 +134,8 @@ BlockResult LooksBlocks::nextBackdrop(Block &block, Sprite *sprite, bool *withou
         if (currentSprite->currentCostume >= static_cast<int>(currentSprite->costumes.size())) {
             currentSprite->currentCostume = 0;
         }
-        if (projectType == UNZIPPED) {
-            Image::loadImageFromFile(currentSprite->costumes[currentSprite->currentCostume].fullName);
-        } else {
-            Image::loadImageFromSB3(&Unzip::zipArchive, currentSprite->costumes[currentSprite->currentCostume].fullName);
-        }
+        ImageLoader::request(currentSprite->costumes[currentSprite->currentCostume].fullName);
+        Prefetcher::prefetchNextCostumes(currentSprite);
     }
 
     for (auto &currentSprite : sprites) {
@@ -175,29 +164,9 @@ BlockResult LooksBlocks::goForwardBackwardLayers(Block &block, Sprite *sprite, b
     if (shift == 0) return BlockResult::CONTINUE;
 
     if (forwardBackward == "forward") {
-        int targetLayer = sprite->layer + shift;
-
-        for (Sprite *currentSprite : sprites) {
-            if (currentSprite->isStage || currentSprite == sprite) continue;
-            if (currentSprite->layer >= targetLayer) {
-                currentSprite->layer++;
-            }
-        }
-
-        sprite->layer = targetLayer;
-
+        DrawOrder::moveTo(sprite, static_cast<long long>(DrawOrder::getLayer(sprite)) + shift);
     } else if (forwardBackward == "backward") {
-        int targetLayer = sprite->layer - shift;
-
-        for (Sprite *currentSprite : sprites) {
-            if (currentSprite->isStage || currentSprite == sprite) continue;
-            if (currentSprite->layer <= targetLayer) {
-                currentSprite->layer--;
-                if (currentSprite->layer < 0) currentSprite->layer = 0;
-            }
-        }
-
-        sprite->layer = targetLayer;
+        DrawOrder::moveTo(sprite, static_cast<long long>(DrawOrder::getLayer(sprite)) - shift);
     }
 
     return BlockResult::CONTINUE;
@@ -207,26 +176,9 @@ BlockResult LooksBlocks::goToFrontBack(Block &block, Sprite *sprite, bool *witho
     std::string value = Scratch::getFieldValue(block, "FRONT_BACK");
     ;
     if (value == "front") {
-
-        double maxLayer = 0.0;
-        for (Sprite *currentSprite : sprites) {
-            if (currentSprite->layer > maxLayer) {
-                maxLayer = currentSprite->layer;
-            }
-        }
-
-        sprite->layer = maxLayer + 1;
-
+        DrawOrder::moveTo(sprite, static_cast<long long>(DrawOrder::size()) - 1);
     } else if (value == "back") {
-        double minLayer = std::numeric_limits<double>::max();
-        for (Sprite *currentSprite : sprites) {
-            if (currentSprite->isStage) continue;
-            if (currentSprite->layer < minLayer) {
-                minLayer = currentSprite->layer;
-            }
-        }
-
-        sprite->layer = minLayer - 1;
+        DrawOrder::moveTo(sprite, 1);
     }
     return BlockResult::CONTINUE;
 }
@@ -237,6 +189,7 @@ BlockResult LooksBlocks::setSizeTo(Block &block, Sprite *sprite, bool *withoutSc
     // hasn't been rendered yet, or fencing is disabled
     if ((sprite->spriteWidth < 1 || sprite->spriteHeight < 1) || !Scratch::fencing) {
         sprite->size = value.asDouble();
+        SpatialGrid::markMoved(sprite);
         return BlockResult::CONTINUE;
     }
 
@@ -249,6 +202,7 @@ BlockResult LooksBlocks::setSizeTo(Block &block, Sprite *sprite, bool *withoutSc
 
         const double clampedScale = std::clamp(inputSizePercent / 100.0, minScale, maxScale);
         sprite->size = clampedScale * 100.0;
+        SpatialGrid::markMoved(sprite);
     }
     return BlockResult::CONTINUE;
 }
@@ -259,6 +213,7 @@ BlockResult LooksBlocks::changeSizeBy(Block &block, Sprite *sprite, bool *withou
     // hasn't been rendered yet, or fencing is disabled
     if ((sprite->spriteWidth < 1 || sprite->spriteHeight < 1) || !Scratch::fencing) {
         sprite->size += value.asDouble();
+        SpatialGrid::markMoved(sprite);
         return BlockResult::CONTINUE;
     }
 
@@ -270,6 +225,7 @@ BlockResult LooksBlocks::changeSizeBy(Block &block, Sprite *sprite, bool *withou
         double maxScale = std::min((1.5 * Scratch::projectWidth) / sprite->spriteWidth, (1.5 * Scratch::projectHeight) / sprite->spriteHeight) * 100.0;
 
         sprite->size = std::clamp(static_cast<double>(sprite->size), minScale, maxScale);
+        SpatialGrid::markMoved(sprite);
     }
     return BlockResult::CONTINUE;
 }
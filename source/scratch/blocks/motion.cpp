@@ -3,6 +3,7 @@
 #include "input.hpp"
 #include "interpret.hpp"
 #include "math.hpp"
+#include "spatialGrid.hpp"
 #include "sprite.hpp"
 #include "value.hpp"
 #include <algorithm>
@@ -23,6 +24,7 @@ BlockResult MotionBlocks::moveSteps(Block &block, Sprite *sprite, bool *withoutS
         // std::cerr << "Invalid Move steps " << value << std::endl;
     }
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -34,12 +36,14 @@ BlockResult MotionBlocks::goTo(Block &block, Sprite *sprite, bool *withoutScreen
     if (objectName == "_random_") {
         sprite->xPosition = rand() % Scratch::projectWidth - Scratch::projectWidth / 2;
         sprite->yPosition = rand() % Scratch::projectHeight - Scratch::projectHeight / 2;
+        SpatialGrid::markMoved(sprite);
         return BlockResult::CONTINUE;
     }
 
     if (objectName == "_mouse_") {
         sprite->xPosition = Input::mousePointer.x;
         sprite->yPosition = Input::mousePointer.y;
+        SpatialGrid::markMoved(sprite);
         return BlockResult::CONTINUE;
     }
 
@@ -51,6 +55,7 @@ BlockResult MotionBlocks::goTo(Block &block, Sprite *sprite, bool *withoutScreen
         }
     }
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -60,6 +65,7 @@ BlockResult MotionBlocks::goToXY(Block &block, Sprite *sprite, bool *withoutScre
     if (xVal.isNumeric()) sprite->xPosition = xVal.asDouble();
     if (yVal.isNumeric()) sprite->yPosition = yVal.asDouble();
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -67,6 +73,7 @@ BlockResult MotionBlocks::turnLeft(Block &block, Sprite *sprite, bool *withoutSc
     Value value = Scratch::getInputValue(block, "DEGREES", sprite);
     if (value.isNumeric()) {
         sprite->rotation -= value.asDouble();
+        SpatialGrid::markMoved(sprite);
     }
     return BlockResult::CONTINUE;
 }
@@ -75,6 +82,7 @@ BlockResult MotionBlocks::turnRight(Block &block, Sprite *sprite, bool *withoutS
     Value value = Scratch::getInputValue(block, "DEGREES", sprite);
     if (value.isNumeric()) {
         sprite->rotation += value.asDouble();
+        SpatialGrid::markMoved(sprite);
     }
     return BlockResult::CONTINUE;
 }
@@ -83,6 +91,7 @@ BlockResult MotionBlocks::pointInDirection(Block &block, Sprite *sprite, bool *w
     Value value = Scratch::getInputValue(block, "DIRECTION", sprite);
     if (value.isNumeric()) {
         sprite->rotation = value.asDouble();
+        SpatialGrid::markMoved(sprite);
     }
     return BlockResult::CONTINUE;
 }
@@ -95,6 +104,7 @@ BlockResult MotionBlocks::changeXBy(Block &block, Sprite *sprite, bool *withoutS
         std::cerr << "Invalid X position " << value.asDouble() << std::endl;
     }
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -106,6 +116,7 @@ BlockResult MotionBlocks::changeYBy(Block &block, Sprite *sprite, bool *withoutS
         std::cerr << "Invalid Y position " << value.asDouble() << std::endl;
     }
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -117,6 +128,7 @@ BlockResult MotionBlocks::setX(Block &block, Sprite *sprite, bool *withoutScreen
         // std::cerr << "Invalid X position " << value << std::endl;
     }
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -128,6 +140,7 @@ BlockResult MotionBlocks::setY(Block &block, Sprite *sprite, bool *withoutScreen
         // std::cerr << "Invalid Y position " << value << std::endl;
     }
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -165,6 +178,7 @@ BlockResult MotionBlocks::glideSecsToXY(Block &block, Sprite *sprite, bool *with
         sprite->xPosition = block.glideEndX;
         sprite->yPosition = block.glideEndY;
         if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+        SpatialGrid::markMoved(sprite);
 
         block.repeatTimes = -1;
         BlockExecutor::removeFromRepeatQueue(sprite, &block);
@@ -177,6 +191,11 @@ BlockResult MotionBlocks::glideSecsToXY(Block &block, Sprite *sprite, bool *with
     sprite->xPosition = block.glideStartX + (block.glideEndX - block.glideStartX) * progress;
     sprite->yPosition = block.glideStartY + (block.glideEndY - block.glideStartY) * progress;
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
+
+    // gliding to where the sprite already is just waits, so only check back when it's done
+    if (block.glideStartX == block.glideEndX && block.glideStartY == block.glideEndY)
+        BlockExecutor::sleepUntilElapsed(sprite, block, block.waitDuration, withoutScreenRefresh);
 
     return BlockResult::RETURN;
 }
@@ -238,6 +257,7 @@ BlockResult MotionBlocks::glideTo(Block &block, Sprite *sprite, bool *withoutScr
         sprite->xPosition = block.glideEndX;
         sprite->yPosition = block.glideEndY;
         if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+        SpatialGrid::markMoved(sprite);
 
         block.repeatTimes = -1;
         BlockExecutor::removeFromRepeatQueue(sprite, &block);
@@ -250,6 +270,11 @@ BlockResult MotionBlocks::glideTo(Block &block, Sprite *sprite, bool *withoutScr
     sprite->xPosition = block.glideStartX + (block.glideEndX - block.glideStartX) * progress;
     sprite->yPosition = block.glideStartY + (block.glideEndY - block.glideStartY) * progress;
     if (Scratch::fencing) Scratch::fenceSpriteWithinBounds(sprite);
+    SpatialGrid::markMoved(sprite);
+
+    // gliding to where the sprite already is just waits, so only check back when it's done
+    if (block.glideStartX == block.glideEndX && block.glideStartY == block.glideEndY)
+        BlockExecutor::sleepUntilElapsed(sprite, block, block.waitDuration, withoutScreenRefresh);
 
     return BlockResult::RETURN;
 }
@@ -264,6 +289,7 @@ BlockResult MotionBlocks::pointToward(Block &block, Sprite *sprite, bool *withou
 
     if (objectName == "_random_") {
         sprite->rotation = rand() % 360;
+        SpatialGrid::markMoved(sprite);
         return BlockResult::CONTINUE;
     }
 
@@ -284,6 +310,7 @@ BlockResult MotionBlocks::pointToward(Block &block, Sprite *sprite, bool *withou
     const double dy = targetY - sprite->yPosition;
     double angle = 90 - (atan2(dy, dx) * 180.0 / M_PI);
     sprite->rotation = angle;
+    SpatialGrid::markMoved(sprite);
     // std::cout << "Pointing towards " << sprite->rotation << std::endl;
     return BlockResult::CONTINUE;
 }
@@ -305,6 +332,7 @@ BlockResult MotionBlocks::setRotationStyle(Block &block, Sprite *sprite, bool *w
     } else {
         sprite->rotationStyle = sprite->ALL_AROUND;
     }
+    SpatialGrid::markMoved(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -312,15 +340,12 @@ BlockResult MotionBlocks::ifOnEdgeBounce(Block &block, Sprite *sprite, bool *wit
     double halfWidth = Scratch::projectWidth / 2.0;
     double halfHeight = Scratch::projectHeight / 2.0;
 
-    double scale = sprite->size / 100.0;
-    double spriteHalfWidth = (sprite->spriteWidth * scale) / 2.0;
-    double spriteHalfHeight = (sprite->spriteHeight * scale) / 2.0;
-
     // Compute bounds of the sprite
-    double left = sprite->xPosition - spriteHalfWidth;
-    double right = sprite->xPosition + spriteHalfWidth;
-    double top = sprite->yPosition + spriteHalfHeight;
-    double bottom = sprite->yPosition - spriteHalfHeight;
+    const CollisionBounds &bounds = getCollisionBounds(sprite);
+    double left = bounds.minX;
+    double right = bounds.maxX;
+    double top = bounds.maxY;
+    double bottom = bounds.minY;
 
     // Compute distances from edges (positive when far from edge, zero or negative when overlapping)
     double distLeft = std::max(0.0, halfWidth + left);
@@ -384,6 +409,7 @@ BlockResult MotionBlocks::ifOnEdgeBounce(Block &block, Sprite *sprite, bool *wit
 
     sprite->xPosition += dxCorrection;
     sprite->yPosition += dyCorrection;
+    SpatialGrid::markMoved(sprite);
 
     return BlockResult::CONTINUE;
 }
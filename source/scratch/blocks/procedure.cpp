@@ -27,6 +27,20 @@ Value ProcedureBlocks::booleanArgument(Block &block, Sprite *sprite) {
     return Value(value.asInt() == 1);
 }
 
+/**
+ * Checks whether anything a custom block call started is still running.
+ * A custom block that calls itself waits in the same chain it runs in, so only what was queued after the call counts.
+ * @param block the `procedures_call` block
+ * @param sprite
+ */
+static bool isCustomBlockRunning(Block &block, Sprite *sprite) {
+    const std::string &definitionChainId = block.customBlockPtr->blockChainID;
+    if (definitionChainId != block.blockChainID) return BlockExecutor::hasActiveRepeats(sprite, definitionChainId);
+
+    const auto &repeatList = sprite->blockChains[definitionChainId].blocksToRepeat;
+    return !repeatList.empty() && repeatList.back() != block.id;
+}
+
 BlockResult ProcedureBlocks::call(Block &block, Sprite *sprite, bool *withoutScreenRefresh, bool fromRepeat) {
 
     if (block.repeatTimes != -1 && !fromRepeat) {
@@ -45,8 +59,7 @@ BlockResult ProcedureBlocks::call(Block &block, Sprite *sprite, bool *withoutScr
     }
 
     // Check if any repeat blocks are still running inside the custom block
-    if (block.customBlockPtr != nullptr &&
-        !BlockExecutor::hasActiveRepeats(sprite, block.customBlockPtr->blockChainID)) {
+    if (block.customBlockPtr != nullptr && !isCustomBlockRunning(block, sprite)) {
 
         // std::cout << "done with custom!" << std::endl;
 
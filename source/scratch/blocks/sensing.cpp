@@ -1,11 +1,15 @@
 #include "sensing.hpp"
 #include "blockExecutor.hpp"
+#include "collisionMask.hpp"
 #include "input.hpp"
+#include "inputRecorder.hpp"
 #include "interpret.hpp"
-#include "keyboard.hpp"
+#include "spatialGrid.hpp"
 #include "sprite.hpp"
 #include "value.hpp"
+#include <cctype>
 #include <cmath>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -15,10 +19,8 @@ BlockResult SensingBlocks::resetTimer(Block &block, Sprite *sprite, bool *withou
 }
 
 BlockResult SensingBlocks::askAndWait(Block &block, Sprite *sprite, bool *withoutScreenRefresh, bool fromRepeat) {
-    Keyboard kbd;
     Value inputValue = Scratch::getInputValue(block, "QUESTION", sprite);
-    std::string output = kbd.openKeyboard(inputValue.asString().c_str());
-    answer = output;
+    answer = InputRecorder::getAnswer(inputValue.asString());
     return BlockResult::CONTINUE;
 }
 
@@ -143,6 +145,9 @@ Value SensingBlocks::sensingAnswer(Block &block, Sprite *sprite) {
 }
 
 Value SensingBlocks::keyPressed(Block &block, Sprite *sprite) {
+    // literal keys were looked up when the project loaded
+    if (block.keyId >= 0) return Value(Input::isKeyDown(block.keyId));
+
     auto inputFind = block.parsedInputs->find("KEY_OPTION");
     std::string buttonCheck;
 
@@ -155,13 +160,7 @@ Value SensingBlocks::keyPressed(Block &block, Sprite *sprite) {
         buttonCheck = Scratch::getInputValue(block, "KEY_OPTION", sprite).asString();
     }
 
-    for (std::string button : Input::inputButtons) {
-        if (buttonCheck == button) {
-            return Value(true);
-        }
-    }
-
-    return Value(false);
+    return Value(Input::isKeyDown(buttonCheck));
 }
 
 Value SensingBlocks::touchingObject(Block &block, Sprite *sprite) {
@@ -179,10 +178,9 @@ Value SensingBlocks::touchingObject(Block &block, Sprite *sprite) {
     } else if (objectName == "_edge_") {
         return Value(isColliding("edge", sprite));
     } else {
-        for (size_t i = 0; i < sprites.size(); i++) {
-            Sprite *currentSprite = sprites[i];
-            if (currentSprite->name == objectName &&
-                isColliding("sprite", sprite, currentSprite, objectName)) {
+        // only the sprites the grid says are close enough could be touching
+        for (Sprite *currentSprite : SpatialGrid::getNearby(sprite, objectName)) {
+            if (isColliding("sprite", sprite, currentSprite, objectName)) {
                 return Value(true);
             }
         }
@@ -190,6 +188,37 @@ Value SensingBlocks::touchingObject(Block &block, Sprite *sprite) {
     return Value(false);
 }
 
+/**
+ * Gets the color index of a color input, read like Scratch does: `#rrggbb` or `#rgb` text, or a number holding `0xRRGGBB`.
+ */
+static uint16_t getColorInput(Block &block, const std::string &inputName, Sprite *sprite) {
+    Value value = Scratch::getInputValue(block, inputName, sprite);
+    uint32_t rgb = 0;
+    std::string text = value.asString();
+    if (!text.empty() && text[0] == '#') {
+        std::string hex = text.substr(1);
+        if (hex.size() == 3) hex = {hex[0], hex[0], hex[1], hex[1], hex[2], hex[2]};
+        bool valid = hex.size() == 6;
+        for (char c : hex) {
+            valid = valid && std::isxdigit(static_cast<unsigned char>(c));
+        }
+        // invalid colors are black
+        if (valid) rgb = static_cast<uint32_t>(std::stoul(hex, nullptr, 16));
+    } else {
+        double number = value.asDouble();
+        if (std::isfinite(number)) rgb = static_cast<uint32_t>(static_cast<int64_t>(number));
+    }
+    return CollisionMask::getColorIndex((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+}
+
+Value SensingBlocks::touchingColor(Block &block, Sprite *sprite) {
+    return Value(CollisionMask::isTouchingColor(sprite, getColorInput(block, "COLOR", sprite)));
+}
+
+Value SensingBlocks::colorIsTouchingColor(Block &block, Sprite *sprite) {
+    return Value(CollisionMask::isTouchingColor(sprite, getColorInput(block, "COLOR2", sprite), getColorInput(block, "COLOR", sprite)));
+}
+
 Value SensingBlocks::mouseDown(Block &block, Sprite *sprite) {
     return Value(Input::mousePointer.isPressed);
 }
@@ -18,6 +18,8 @@ class SensingBlocks {
 
     static Value keyPressed(Block &block, Sprite *sprite);
     static Value touchingObject(Block &block, Sprite *sprite);
+    static Value touchingColor(Block &block, Sprite *sprite);
+    static Value colorIsTouchingColor(Block &block, Sprite *sprite);
     static Value mouseDown(Block &block, Sprite *sprite);
     static Value username(Block &block, Sprite *sprite);
 };
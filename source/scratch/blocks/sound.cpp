@@ -55,25 +55,33 @@ BlockResult SoundBlocks::playSoundUntilDone(Block &block, Sprite *sprite, bool *
                 SoundPlayer::playSound(soundFullName);
         }
 
+        block.waitTimer.start();
         BlockExecutor::addToRepeatQueue(sprite, &block);
     }
 
     // Check if sound is still playing (need to determine sound name again for check)
-    std::string checkSoundName;
+    const Sound *checkSound = nullptr;
     auto soundFind = sprite->sounds.find(inputString);
     if (soundFind != sprite->sounds.end()) {
-        checkSoundName = soundFind->second.fullName;
+        checkSound = &soundFind->second;
     } else if (Math::isNumber(inputString) && inputFind != block.parsedInputs->end() &&
                (inputFind->second.inputType == ParsedInput::BLOCK || inputFind->second.inputType == ParsedInput::VARIABLE)) {
         int soundIndex = inputValue.asInt() - 1;
         if (soundIndex >= 0 && static_cast<size_t>(soundIndex) < sprite->sounds.size()) {
             auto it = sprite->sounds.begin();
             std::advance(it, soundIndex);
-            checkSoundName = it->second.fullName;
+            checkSound = &it->second;
         }
     }
 
-    if (!checkSoundName.empty() && SoundPlayer::isSoundPlaying(checkSoundName)) {
+    if (checkSound != nullptr && SoundPlayer::isSoundPlaying(checkSound->fullName)) {
+        // the sound can't be done before it's had time to play, so sleep until then, unless "stop all sounds"
+        // wakes the script first. After that, a sound that started late because it was still loading,
+        // or that got played again, is checked every frame until it's done.
+        const int lengthMs = checkSound->sampleRate > 0 ? static_cast<int>(1000.0 * checkSound->sampleCount / checkSound->sampleRate) : 0;
+        if (!block.waitTimer.hasElapsed(lengthMs)) {
+            BlockExecutor::sleepUntilSoundDone(sprite, block, checkSound->fullName, lengthMs, withoutScreenRefresh);
+        }
         return BlockResult::RETURN;
     }
 
@@ -129,6 +137,7 @@ BlockResult SoundBlocks::playSound(Block &block, Sprite *sprite, bool *withoutSc
 BlockResult SoundBlocks::stopAllSounds(Block &block, Sprite *sprite, bool *withoutScreenRefresh, bool fromRepeat) {
     for (auto &[id, sound] : sprite->sounds) {
         SoundPlayer::stopSound(sound.fullName);
+        BlockExecutor::wakeSoundWaiters(sound.fullName);
     }
     return BlockResult::CONTINUE;
 }
@@ -10,4 +10,5 @@
 Value TranslateBlocks::getTranslate(Block &block, Sprite *sprite) {
   Value value1 = Scratch::getInputValue(block, "WORDS", sprite);
   Value value2 = Scratch::getInputValue(block, "LANGUAGE", sprite);
+  return Value();
 }
@@ -6,4 +6,4 @@ class TranslateBlocks {
   public:
     static Value getTranslate(Block &block, Sprite *sprite);
     static Value getViewerLanguage(Block &block, Sprite *sprite);
-}
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**
+ * Broadcasts waiting to start their receivers, stored as the ids from `broadcastIds`.
+ * A ring buffer that only grows when it's full, so queueing doesn't allocate once a project warms up.
+ * A broadcast that's already waiting doesn't get queued a second time: like in Scratch,
+ * broadcasting the same message several times before it runs only starts its receivers once.
+ */
+class BroadcastQueue {
+  private:
+    std::vector<int> ring;
+    std::vector<bool> waiting; // by broadcast id
+    size_t head = 0;
+    size_t count = 0;
+
+  public:
+    /**
+     * Adds a broadcast to the end of the queue, unless it's already waiting.
+     * @param broadcastId
+     */
+    void push(int broadcastId) {
+        if (broadcastId < 0) return;
+        if (static_cast<size_t>(broadcastId) >= waiting.size()) waiting.resize(broadcastId + 1, false);
+        if (waiting[broadcastId]) return;
+        waiting[broadcastId] = true;
+
+        if (count == ring.size()) {
+            // unroll into a bigger buffer so the queue stays in order
+            std::vector<int> bigger(ring.empty() ? 16 : ring.size() * 2);
+            for (size_t i = 0; i < count; i++) {
+                bigger[i] = ring[(head + i) % ring.size()];
+            }
+            ring.swap(bigger);
+            head = 0;
+        }
+        ring[(head + count) % ring.size()] = broadcastId;
+        count++;
+    }
+
+    /**
+     * Takes the broadcast at the front of the queue.
+     * @param broadcastId where the broadcast's id gets stored
+     * @return `false` if the queue is empty.
+     */
+    bool pop(int &broadcastId) {
+        if (count == 0) return false;
+        broadcastId = ring[head];
+        waiting[broadcastId] = false;
+        head = (head + 1) % ring.size();
+        count--;
+        return true;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    void clear() {
+        ring.clear();
+        waiting.clear();
+        head = 0;
+        count = 0;
+    }
+};
@@ -0,0 +1,425 @@
+#include "collisionMask.hpp"
+#include "drawOrder.hpp"
+#include "interpret.hpp"
+#include "spatialGrid.hpp"
+#include "sprite.hpp"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+bool CollisionMask::keepColors = false;
+
+namespace {
+
+std::unordered_map<std::string, CollisionMask> masks;
+
+/**
+ * Maps stage positions onto the pixels of a sprite's costume, the way the renderers draw it.
+ */
+struct MaskSampler {
+    Sprite *sprite = nullptr;
+    const CollisionMask *mask;
+    double centerX;
+    double centerY;
+    double cosAngle = 1.0;
+    double sinAngle = 0.0;
+    double flip = 1.0; // -1 when a left-right sprite faces left
+    double halfWidth;
+    double halfHeight;
+    double pixelsPerUnitX = 0.0;
+    double pixelsPerUnitY = 0.0;
+
+    /**
+     * Places a mask on the stage unrotated, like a backdrop.
+     */
+    MaskSampler(const CollisionMask *mask, double centerX, double centerY, double halfWidth, double halfHeight)
+        : mask(mask), centerX(centerX), centerY(centerY), halfWidth(halfWidth), halfHeight(halfHeight) {
+        if (mask && halfWidth > 0 && halfHeight > 0) {
+            pixelsPerUnitX = mask->width / (halfWidth * 2.0);
+            pixelsPerUnitY = mask->height / (halfHeight * 2.0);
+        } else {
+            this->mask = nullptr;
+        }
+    }
+
+    MaskSampler(Sprite *sprite, const std::vector<std::pair<double, double>> &points) : sprite(sprite) {
+        mask = CollisionMask::get(sprite->costumes[sprite->currentCostume].id);
+
+        // the mask covers the collision box, whatever the costume's resolution is
+        centerX = (points[0].first + points[1].first + points[2].first + points[3].first) / 4.0;
+        centerY = (points[0].second + points[1].second + points[2].second + points[3].second) / 4.0;
+        halfWidth = std::hypot(points[1].first - points[0].first, points[1].second - points[0].second) / 2.0;
+        halfHeight = std::hypot(points[2].first - points[1].first, points[2].second - points[1].second) / 2.0;
+        if (mask && halfWidth > 0 && halfHeight > 0) {
+            pixelsPerUnitX = mask->width / (halfWidth * 2.0);
+            pixelsPerUnitY = mask->height / (halfHeight * 2.0);
+        } else {
+            mask = nullptr;
+        }
+
+        const double radians = (sprite->rotation - 90) * M_PI / 180.0;
+        if (sprite->rotationStyle == sprite->ALL_AROUND) {
+            cosAngle = std::cos(radians);
+            sinAngle = std::sin(radians);
+        } else if (sprite->rotationStyle == sprite->LEFT_RIGHT && std::cos(radians) < 0) {
+            flip = -1.0;
+        }
+    }
+
+    /**
+     * Finds the pixel of the mask drawn at a stage position.
+     * @return `false` if the position is outside the sprite's box.
+     */
+    bool getPixel(double x, double y, int &maskX, int &maskY) const {
+        const double dx = x - centerX;
+        const double dy = y - centerY;
+
+        // undo the clockwise rotation the sprite is drawn with
+        const double localX = (dx * cosAngle - dy * sinAngle) * flip;
+        const double localY = dx * sinAngle + dy * cosAngle;
+        if (std::abs(localX) > halfWidth || std::abs(localY) > halfHeight) return false;
+
+        maskX = static_cast<int>((localX + halfWidth) * pixelsPerUnitX);
+        maskY = static_cast<int>((halfHeight - localY) * pixelsPerUnitY);
+        return true;
+    }
+
+    bool isSolidAt(double x, double y) const {
+        int maskX, maskY;
+        if (!getPixel(x, y, maskX, maskY)) return false;
+        return !mask || mask->isSolid(maskX, maskY);
+    }
+
+    bool isRotated() const {
+        return cosAngle != 1.0 || sinAngle != 0.0;
+    }
+
+    /**
+     * Samples a row of stage pixels, setting bit `i % 64` of word `i / 64` when pixel `left + i` is solid.
+     * Unrotated sprites find their mask row once, then copy it a word at a time when they're drawn at the stage's
+     * scale, or a run of solid pixels at a time when they're not. Only rotated sprites sample every pixel.
+     * @param y the row's stage y
+     * @param left stage x of the row's first pixel
+     * @param count pixels in the row
+     * @param words `(count + 63) / 64` words, all cleared
+     * @param only if set, rotated pixels whose bit isn't set here get left out, and the row stops at the first solid one
+     * that is, since the caller only wants to know if any of them are
+     */
+    void sampleRow(int y, int left, int count, uint64_t *words, const uint64_t *only = nullptr) const {
+        const double sampleY = y + 0.5;
+        if (isRotated()) {
+            for (int i = 0; i < count; i++) {
+                if (only && !((only[i >> 6] >> (i & 63)) & 1)) continue;
+                if (!isSolidAt(left + i + 0.5, sampleY)) continue;
+                words[i >> 6] |= uint64_t(1) << (i & 63);
+                if (only) return;
+            }
+            return;
+        }
+
+        // the same sums `getPixel()` does, without the rotation that's a no-op here
+        const double localY = sampleY - centerY;
+        if (std::abs(localY) > halfHeight) return;
+        auto isInBox = [&](int i) { return std::abs(left + i + 0.5 - centerX) <= halfWidth; };
+        auto getMaskX = [&](int i) { return static_cast<int>(((left + i + 0.5 - centerX) * flip + halfWidth) * pixelsPerUnitX); };
+
+        // the box covers one run of the row, found from where it should start and end then nudged onto the exact pixels
+        int first = std::max(0, static_cast<int>(std::floor(centerX - halfWidth - 0.5)) - left);
+        while (first > 0 && isInBox(first - 1)) first--;
+        while (first < count && !isInBox(first)) first++;
+        int last = std::min(count - 1, static_cast<int>(std::ceil(centerX + halfWidth - 0.5)) - left);
+        while (last + 1 < count && isInBox(last + 1)) last++;
+        while (last >= first && !isInBox(last)) last--;
+        if (first > last) return;
+
+        if (!mask) {
+            setRun(words, first, last);
+            return;
+        }
+
+        const int maskY = static_cast<int>((halfHeight - localY) * pixelsPerUnitY);
+        if (maskY < 0 || maskY >= mask->height) return;
+        const uint64_t *maskRow = &mask->bits[static_cast<size_t>(maskY) * mask->wordsPerRow];
+
+        if (flip == 1.0 && pixelsPerUnitX == 1.0) {
+            // one mask pixel per stage pixel, so the row is the mask row shifted over
+            const int offset = getMaskX(first) - first;
+            for (int word = first >> 6; word <= last >> 6; word++) {
+                uint64_t bits = getMaskBits(maskRow, word * 64 + offset);
+                if (word == first >> 6) bits &= ~uint64_t(0) << (first & 63);
+                if (word == last >> 6 && (last & 63) != 63) bits &= (uint64_t(1) << ((last & 63) + 1)) - 1;
+                words[word] |= bits;
+            }
+            return;
+        }
+
+        // otherwise every run of solid pixels in the mask row covers one run of stage pixels,
+        // and the mask column only ever goes one way along the row, so the run's ends can be searched for
+        auto getColumn = [&](int i) { return flip == 1.0 ? getMaskX(i) : -getMaskX(i); };
+        auto findFirstAtLeast = [&](int column) {
+            int low = first, high = last + 1;
+            while (low < high) {
+                const int middle = low + (high - low) / 2;
+                if (getColumn(middle) >= column) high = middle;
+                else low = middle + 1;
+            }
+            return low;
+        };
+        int fromX = getMaskX(first);
+        int toX = getMaskX(last);
+        if (fromX > toX) std::swap(fromX, toX);
+        fromX = std::max(fromX, 0);
+        toX = std::min(toX, mask->width - 1);
+        for (int runStart = findSolid(maskRow, fromX, toX, true); runStart <= toX;) {
+            const int runEnd = std::min(findSolid(maskRow, runStart, toX, false), toX + 1) - 1;
+            const int stageFirst = flip == 1.0 ? findFirstAtLeast(runStart) : findFirstAtLeast(-runEnd);
+            const int stageLast = (flip == 1.0 ? findFirstAtLeast(runEnd + 1) : findFirstAtLeast(-runStart + 1)) - 1;
+            if (stageFirst <= stageLast) setRun(words, stageFirst, stageLast);
+            runStart = findSolid(maskRow, runEnd + 1, toX, true);
+        }
+    }
+
+    /**
+     * Finds the first pixel of a mask row from `from` on that's solid, or clear.
+     * @return `to + 1` if there isn't one up to `to`.
+     */
+    static int findSolid(const uint64_t *maskRow, int from, int to, bool solid) {
+        for (int word = from >> 6; from <= to; word++) {
+            uint64_t bits = solid ? maskRow[word] : ~maskRow[word];
+            bits &= ~uint64_t(0) << (from & 63);
+            if (bits != 0) return std::min(word * 64 + __builtin_ctzll(bits), to + 1);
+            from = (word + 1) * 64;
+        }
+        return to + 1;
+    }
+
+    /**
+     * Gets 64 pixels of a mask row starting at `start`, with the ones off either end of it clear.
+     */
+    uint64_t getMaskBits(const uint64_t *maskRow, int start) const {
+        auto getWord = [&](int word) { return word >= 0 && word < mask->wordsPerRow ? maskRow[word] : 0; };
+        const int word = start >= 0 ? start / 64 : (start - 63) / 64;
+        const int shift = start - word * 64;
+        if (shift == 0) return getWord(word);
+        return (getWord(word) >> shift) | (getWord(word + 1) << (64 - shift));
+    }
+
+    static void setRun(uint64_t *words, int first, int last) {
+        for (int word = first >> 6; word <= last >> 6; word++) {
+            uint64_t bits = ~uint64_t(0);
+            if (word == first >> 6) bits &= ~uint64_t(0) << (first & 63);
+            if (word == last >> 6 && (last & 63) != 63) bits &= (uint64_t(1) << ((last & 63) + 1)) - 1;
+            words[word] |= bits;
+        }
+    }
+
+    /**
+     * Gets the color index drawn at a stage position.
+     * @return `false` if nothing is drawn there.
+     */
+    bool getColorAt(double x, double y, uint16_t &color) const {
+        int maskX, maskY;
+        if (!getPixel(x, y, maskX, maskY)) return false;
+        if (!mask) {
+            color = CollisionMask::NO_COLOR;
+            return true;
+        }
+        if (!mask->isSolid(maskX, maskY)) return false;
+        color = mask->colors.empty() ? CollisionMask::NO_COLOR : mask->colors[static_cast<size_t>(maskY) * mask->width + maskX];
+        return true;
+    }
+};
+
+/**
+ * Gets one of the row buffers `touching` checks sample into, kept between checks so they don't allocate.
+ * @param index which buffer
+ * @param words how many words it needs
+ */
+std::vector<uint64_t> &getRowBuffer(int index, size_t words) {
+    static std::vector<uint64_t> buffers[2];
+    buffers[index].resize(words);
+    return buffers[index];
+}
+
+/**
+ * Shrinks a box on the stage to the part a sprite's bounding box covers.
+ */
+void clipToSprite(Sprite *sprite, double &minX, double &minY, double &maxX, double &maxY) {
+    const CollisionBounds &bounds = getCollisionBounds(sprite);
+    minX = std::max(minX, bounds.minX);
+    maxX = std::min(maxX, bounds.maxX);
+    minY = std::max(minY, bounds.minY);
+    maxY = std::min(maxY, bounds.maxY);
+}
+
+} // namespace
+
+void CollisionMask::build(const std::string &imageId, const unsigned char *rgba, int width, int height, int pitch) {
+    if (!rgba || width <= 0 || height <= 0) {
+        masks.erase(imageId);
+        return;
+    }
+
+    CollisionMask &mask = masks[imageId];
+    mask.width = width;
+    mask.height = height;
+    mask.wordsPerRow = (width + 63) / 64;
+    mask.bits.assign(static_cast<size_t>(mask.wordsPerRow) * height, 0);
+    for (int y = 0; y < height; y++) {
+        const unsigned char *row = rgba + static_cast<size_t>(y) * pitch;
+        uint64_t *words = &mask.bits[static_cast<size_t>(y) * mask.wordsPerRow];
+        for (int x = 0; x < width; x++) {
+            if (row[x * 4 + 3] > ALPHA_THRESHOLD) words[x >> 6] |= uint64_t(1) << (x & 63);
+        }
+    }
+
+    if (!keepColors) {
+        mask.colors.clear();
+        return;
+    }
+    mask.colors.resize(static_cast<size_t>(width) * height);
+    for (int y = 0; y < height; y++) {
+        const unsigned char *row = rgba + static_cast<size_t>(y) * pitch;
+        uint16_t *colors = &mask.colors[static_cast<size_t>(y) * width];
+        for (int x = 0; x < width; x++) {
+            colors[x] = getColorIndex(row[x * 4], row[x * 4 + 1], row[x * 4 + 2]);
+        }
+    }
+}
+
+const CollisionMask *CollisionMask::get(const std::string &imageId) {
+    auto maskFind = masks.find(imageId);
+    if (maskFind == masks.end()) return nullptr;
+    return &maskFind->second;
+}
+
+bool CollisionMask::spritesOverlap(Sprite *spriteA, const std::vector<std::pair<double, double>> &pointsA,
+                                   Sprite *spriteB, const std::vector<std::pair<double, double>> &pointsB) {
+    const MaskSampler samplerA(spriteA, pointsA);
+    const MaskSampler samplerB(spriteB, pointsB);
+
+    // only the part where both boxes overlap on the stage can touch, like in Scratch
+    double minX = -Scratch::projectWidth / 2.0;
+    double maxX = Scratch::projectWidth / 2.0;
+    double minY = -Scratch::projectHeight / 2.0;
+    double maxY = Scratch::projectHeight / 2.0;
+    clipToSprite(spriteA, minX, minY, maxX, maxY);
+    clipToSprite(spriteB, minX, minY, maxX, maxY);
+    if (!(minX < maxX && minY < maxY)) return false;
+
+    // sample the overlap a row at a time into stage aligned words, and AND them:
+    // `spriteB` only gets sampled on rows, and rotated pixels, where `spriteA` is solid
+    const int left = static_cast<int>(std::floor(minX));
+    const int right = static_cast<int>(std::ceil(maxX));
+    const int bottom = static_cast<int>(std::floor(minY));
+    const int top = static_cast<int>(std::ceil(maxY));
+    const int count = right - left;
+
+    // rotated sprites sample pixel by pixel, so they go a word at a time to stop at the first hit
+    if (samplerA.isRotated() || samplerB.isRotated()) {
+        for (int y = bottom; y < top; y++) {
+            for (int wordLeft = 0; wordLeft < count; wordLeft += 64) {
+                const int wordCount = std::min(64, count - wordLeft);
+                uint64_t solidA = 0;
+                samplerA.sampleRow(y, left + wordLeft, wordCount, &solidA);
+                if (solidA == 0) continue;
+                uint64_t solidB = 0;
+                samplerB.sampleRow(y, left + wordLeft, wordCount, &solidB, &solidA);
+                if (solidA & solidB) return true;
+            }
+        }
+        return false;
+    }
+
+    const size_t words = static_cast<size_t>(count + 63) / 64;
+    std::vector<uint64_t> &rowA = getRowBuffer(0, words);
+    std::vector<uint64_t> &rowB = getRowBuffer(1, words);
+    for (int y = bottom; y < top; y++) {
+        std::fill(rowA.begin(), rowA.end(), 0);
+        samplerA.sampleRow(y, left, count, rowA.data());
+        if (std::all_of(rowA.begin(), rowA.end(), [](uint64_t word) { return word == 0; })) continue;
+
+        std::fill(rowB.begin(), rowB.end(), 0);
+        samplerB.sampleRow(y, left, count, rowB.data());
+        for (size_t word = 0; word < words; word++) {
+            if (rowA[word] & rowB[word]) return true;
+        }
+    }
+    return false;
+}
+
+bool CollisionMask::isTouchingColor(Sprite *sprite, uint16_t color, int spriteColor) {
+    if (sprite->isStage || sprite->costumes.empty()) return false;
+    const std::vector<std::pair<double, double>> &points = getCollisionPoints(sprite);
+    const MaskSampler self(sprite, points);
+
+    double minX = -Scratch::projectWidth / 2.0;
+    double maxX = Scratch::projectWidth / 2.0;
+    double minY = -Scratch::projectHeight / 2.0;
+    double maxY = Scratch::projectHeight / 2.0;
+    clipToSprite(sprite, minX, minY, maxX, maxY);
+    if (!(minX < maxX && minY < maxY)) return false;
+
+    // everything that could be drawn under the sprite, topmost first
+    std::vector<std::pair<size_t, Sprite *>> nearby;
+    for (Sprite *other : SpatialGrid::getNearby(sprite)) {
+        if (other == sprite || !other->visible || other->isDeleted || other->costumes.empty()) continue;
+        nearby.emplace_back(DrawOrder::getLayer(other), other);
+    }
+    std::stable_sort(nearby.begin(), nearby.end(), [](const auto &a, const auto &b) {
+        return a.first > b.first;
+    });
+    std::vector<MaskSampler> others;
+    others.reserve(nearby.size());
+    for (const auto &[layer, other] : nearby) {
+        others.emplace_back(other, getCollisionPoints(other));
+    }
+
+    const CollisionMask *backdropMask = nullptr;
+    for (Sprite *stage : sprites) {
+        if (!stage->isStage) continue;
+        if (!stage->costumes.empty()) backdropMask = get(stage->costumes[stage->currentCostume].id);
+        break;
+    }
+    const MaskSampler backdrop(backdropMask, 0.0, 0.0, Scratch::projectWidth / 2.0, Scratch::projectHeight / 2.0);
+    const uint16_t white = getColorIndex(255, 255, 255);
+
+    auto getColorUnder = [&](double x, double y) {
+        uint16_t under;
+        for (const MaskSampler &other : others) {
+            if (other.getColorAt(x, y, under)) return under;
+        }
+        if (backdrop.mask && backdrop.getColorAt(x, y, under)) return under;
+        return white;
+    };
+
+    // the sprite's own pixels a row at a time with the same sampler as `spritesOverlap()`,
+    // then what's under them only where the sprite is drawn (in the color asked for)
+    const int left = static_cast<int>(std::floor(minX));
+    const int right = static_cast<int>(std::ceil(maxX));
+    const int bottom = static_cast<int>(std::floor(minY));
+    const int top = static_cast<int>(std::ceil(maxY));
+    const int count = right - left;
+    std::vector<uint64_t> &drawn = getRowBuffer(0, static_cast<size_t>(count + 63) / 64);
+    for (int y = bottom; y < top; y++) {
+        const double sampleY = y + 0.5;
+        std::fill(drawn.begin(), drawn.end(), 0);
+        self.sampleRow(y, left, count, drawn.data());
+        for (size_t word = 0; word < drawn.size(); word++) {
+            int i = static_cast<int>(word * 64);
+            for (uint64_t bits = drawn[word]; bits != 0; bits >>= 1, i++) {
+                if (!(bits & 1)) continue;
+                const double sampleX = left + i + 0.5;
+                uint16_t own;
+                if (spriteColor >= 0 && (!self.getColorAt(sampleX, sampleY, own) || own != spriteColor)) continue;
+                if (getColorUnder(sampleX, sampleY) == color) return true;
+            }
+        }
+    }
+    return false;
+}
+
+void CollisionMask::clear() {
+    masks.clear();
+    keepColors = false;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Sprite;
+
+/**
+ * A costume's alpha channel at 1 bit per pixel, so `touching (sprite)?` can check if the visible
+ * pixels of two sprites overlap instead of just their boxes.
+ * When a project uses color sensing blocks, the costume's colors are kept too, as color indexes.
+ * Masks are built once when a costume gets decoded, and shared by every sprite and clone wearing it.
+ */
+class CollisionMask {
+  public:
+    int width = 0;
+    int height = 0;
+    int wordsPerRow = 0;
+    std::vector<uint64_t> bits;   // row by row, pixel `x` of a row is bit `x % 64` of word `x / 64`
+    std::vector<uint16_t> colors; // color index of every pixel, only kept when `keepColors` is set
+
+    /**
+     * Color index of a pixel whose color isn't known. Never matches a real color.
+     */
+    static constexpr uint16_t NO_COLOR = 0xFFFF;
+
+    /**
+     * Whether masks built from now on keep their colors. Set while loading a project that senses colors.
+     */
+    static bool keepColors;
+
+    /**
+     * Pixels with an alpha above this count as solid.
+     */
+    static constexpr unsigned char ALPHA_THRESHOLD = 0;
+
+    bool isSolid(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) return false;
+        return (bits[y * wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    /**
+     * Packs a color into the index color sensing blocks compare, which like in Scratch
+     * only keeps the top 5 bits of red and green and the top 4 bits of blue.
+     */
+    static uint16_t getColorIndex(unsigned char r, unsigned char g, unsigned char b) {
+        return static_cast<uint16_t>(((r >> 3) << 9) | ((g >> 3) << 4) | (b >> 4));
+    }
+
+    /**
+     * Builds the mask for a decoded costume, replacing any mask it already had.
+     * @param imageId the costume's id, without a file extension
+     * @param rgba 8 bits per channel RGBA pixels
+     * @param width
+     * @param height
+     * @param pitch bytes from one row of `rgba` to the next
+     */
+    static void build(const std::string &imageId, const unsigned char *rgba, int width, int height, int pitch);
+
+    /**
+     * Gets the mask of a costume.
+     * @param imageId the costume's id, without a file extension
+     * @return The mask, or `nullptr` if the costume hasn't been decoded.
+     */
+    static const CollisionMask *get(const std::string &imageId);
+
+    /**
+     * Checks if the visible pixels of two sprites overlap somewhere on the stage.
+     * Sprites whose costume has no mask count as solid boxes.
+     * @param spriteA
+     * @param pointsA `spriteA`'s points, from `getCollisionPoints()`
+     * @param spriteB
+     * @param pointsB `spriteB`'s points, from `getCollisionPoints()`
+     */
+    static bool spritesOverlap(Sprite *spriteA, const std::vector<std::pair<double, double>> &pointsA,
+                               Sprite *spriteB, const std::vector<std::pair<double, double>> &pointsB);
+
+    /**
+     * Checks if any visible pixel of a sprite touches a given color, in what the other sprites
+     * and the backdrop draw at that spot.
+     * @param sprite
+     * @param color the color index to look for under the sprite
+     * @param spriteColor if set, only the sprite's pixels of this color index count
+     */
+    static bool isTouchingColor(Sprite *sprite, uint16_t color, int spriteColor = -1);
+
+    /**
+     * Frees every mask and stops keeping colors.
+     */
+    static void clear();
+};
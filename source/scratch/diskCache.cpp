@@ -0,0 +1,241 @@
+#include "diskCache.hpp"
+#include "nlohmann/json.hpp"
+#include "os.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct CachedFile {
+    uint64_t size;
+    fs::file_time_type lastUsed;
+};
+
+const char *const FILE_EXTENSION = ".sedc";
+
+std::mutex cacheMutex;
+bool initialized = false;
+std::string folder;
+std::unordered_map<std::string, CachedFile> files; // by key
+uint64_t totalSize = 0;
+size_t maxSize = DiskCache::DEFAULT_MAX_SIZE;
+DiskCache::Stats stats;
+std::atomic<unsigned int> tempFileCount{0};
+
+std::string getDefaultFolder() {
+    const std::string defaultFolder = OS::getScratchFolderLocation() + "decoded-cache/";
+#ifdef __PC__
+    bool enabled = true;
+#else
+    bool enabled = false;
+#endif
+    std::ifstream settingsFile(OS::getScratchFolderLocation() + "Settings.json");
+    if (settingsFile.good()) {
+        nlohmann::json settings = nlohmann::json::parse(settingsFile, nullptr, false);
+        if (settings.is_object() && settings.contains("CacheDecodedAssets") && settings["CacheDecodedAssets"].is_boolean()) {
+            enabled = settings["CacheDecodedAssets"].get<bool>();
+        }
+    }
+    return enabled ? defaultFolder : "";
+}
+
+/**
+ * Finds every file already in the folder. Needs `cacheMutex` held.
+ */
+void scanFolder() {
+    files.clear();
+    totalSize = 0;
+    if (folder.empty()) return;
+
+    std::error_code error;
+    fs::create_directories(folder, error);
+    for (fs::directory_iterator it(folder, error), end; !error && it != end; it.increment(error)) {
+        if (!it->is_regular_file(error)) continue;
+        const fs::path &path = it->path();
+        if (path.extension() != FILE_EXTENSION) {
+            // left behind by a store that got interrupted
+            if (path.extension() == ".tmp") fs::remove(path, error);
+            continue;
+        }
+        CachedFile file;
+        file.size = it->file_size(error);
+        file.lastUsed = it->last_write_time(error);
+        files[path.stem().string()] = file;
+        totalSize += file.size;
+    }
+}
+
+/**
+ * Picks the folder and reads what's in it, the first time the cache is used. Needs `cacheMutex` held.
+ */
+void initialize() {
+    if (initialized) return;
+    initialized = true;
+    folder = getDefaultFolder();
+    scanFolder();
+}
+
+/**
+ * Deletes the files that were used longest ago until the folder fits its size limit. Needs `cacheMutex` held.
+ */
+void trimToMaxSize() {
+    if (totalSize <= maxSize) return;
+    TRACE_SCOPE("trim disk cache", "asset");
+    std::vector<std::pair<fs::file_time_type, std::string>> byAge;
+    byAge.reserve(files.size());
+    for (const auto &[key, file] : files) {
+        byAge.emplace_back(file.lastUsed, key);
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    std::error_code error;
+    for (const auto &[lastUsed, key] : byAge) {
+        if (totalSize <= maxSize) break;
+        fs::remove(folder + key + FILE_EXTENSION, error);
+        totalSize -= files[key].size;
+        files.erase(key);
+        stats.filesDeleted++;
+    }
+}
+
+} // namespace
+
+std::string DiskCache::makeKey(const std::string &md5, float scale, const std::string &format) {
+    std::string key = md5 + "_" + std::to_string(static_cast<int>(std::lround(scale * 100))) + "_" + format;
+    // ids from unzipped projects can be paths
+    std::replace_if(key.begin(), key.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-'; }, '-');
+    return key;
+}
+
+bool DiskCache::load(const std::string &key, Header &header, std::vector<unsigned char> &data) {
+    std::string path;
+    uint64_t fileSize;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        initialize();
+        if (folder.empty()) return false;
+        auto fileFind = files.find(key);
+        if (fileFind == files.end()) {
+            stats.misses++;
+            return false;
+        }
+        path = folder + key + FILE_EXTENSION;
+        fileSize = fileFind->second.size;
+    }
+
+    TRACE_SCOPE("read cached " + key, "asset");
+    bool valid = false;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file) {
+        const Header expected;
+        valid = fread(&header, sizeof(Header), 1, file) == 1 &&
+                memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 && header.version == VERSION &&
+                header.dataSize == fileSize - DATA_OFFSET && fseek(file, DATA_OFFSET, SEEK_SET) == 0;
+        if (valid) {
+            data.resize(header.dataSize);
+            valid = header.dataSize == 0 || fread(data.data(), header.dataSize, 1, file) == 1;
+        }
+        fclose(file);
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto fileFind = files.find(key);
+    if (!valid) {
+        // from an older version, or cut short, so it's no use to anyone
+        Log::logWarning("Ignoring broken cached asset: " + key);
+        std::error_code error;
+        fs::remove(path, error);
+        if (fileFind != files.end()) {
+            totalSize -= fileFind->second.size;
+            files.erase(fileFind);
+        }
+        data.clear();
+        stats.misses++;
+        return false;
+    }
+
+    // the modification time doubles as the last time it was used, so the least recently used files can go first
+    if (fileFind != files.end()) {
+        std::error_code error;
+        fileFind->second.lastUsed = fs::file_time_type::clock::now();
+        fs::last_write_time(path, fileFind->second.lastUsed, error);
+    }
+    stats.hits++;
+    return true;
+}
+
+void DiskCache::store(const std::string &key, Header header, const void *data, size_t size) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        initialize();
+        if (folder.empty()) return;
+        path = folder + key + FILE_EXTENSION;
+    }
+
+    TRACE_SCOPE("write cached " + key, "asset");
+    header.dataSize = size;
+    unsigned char headerBlock[DATA_OFFSET] = {0};
+    static_assert(sizeof(Header) <= DATA_OFFSET, "the header has to fit before the data");
+    memcpy(headerBlock, &header, sizeof(Header));
+
+    // written under another name first, so nothing ever reads a half written file
+    const std::string tempPath = path + "." + std::to_string(tempFileCount++) + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (!file) return;
+    const bool written = fwrite(headerBlock, DATA_OFFSET, 1, file) == 1 && (size == 0 || fwrite(data, size, 1, file) == 1);
+    const bool closed = fclose(file) == 0;
+    std::error_code error;
+    if (!written || !closed) {
+        fs::remove(tempPath, error);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    fs::rename(tempPath, path, error);
+    if (error) {
+        fs::remove(tempPath, error);
+        return;
+    }
+    CachedFile &cached = files[key];
+    totalSize = totalSize - cached.size + DATA_OFFSET + size;
+    cached.size = DATA_OFFSET + size;
+    cached.lastUsed = fs::file_time_type::clock::now();
+    stats.stores++;
+    trimToMaxSize();
+}
+
+void DiskCache::setFolder(const std::string &newFolder) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    initialized = true;
+    folder = newFolder;
+    scanFolder();
+}
+
+bool DiskCache::isEnabled() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    initialize();
+    return !folder.empty();
+}
+
+void DiskCache::setMaxSize(size_t bytes) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    maxSize = bytes;
+    if (initialized) trimToMaxSize();
+}
+
+DiskCache::Stats DiskCache::getStats() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return stats;
+}
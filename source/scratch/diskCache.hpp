@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps decoded costumes and sounds on disk, so playing the same project again skips inflating and decoding them.
+ * Every asset is one file named after its md5, the scale it was decoded at and its format, holding a small header
+ * followed by the data exactly as it gets uploaded, starting at `DATA_OFFSET` so the file could be mapped straight into memory.
+ * Once the folder goes over its size limit, the files that were used longest ago get deleted.
+ * Safe to use from any thread.
+ */
+class DiskCache {
+  public:
+    /**
+     * Bumped whenever the layout of cached files changes, so files from older versions get ignored.
+     */
+    static constexpr uint32_t VERSION = 1;
+
+    /**
+     * Where the data starts in a cached file. Leaves room for the header and keeps the data aligned.
+     */
+    static constexpr size_t DATA_OFFSET = 64;
+
+    /**
+     * Size the folder gets trimmed down to by default.
+     */
+    static constexpr size_t DEFAULT_MAX_SIZE = 256 * 1024 * 1024;
+
+    /**
+     * What comes before the data in every cached file.
+     */
+    struct Header {
+        char magic[4] = {'S', 'E', 'D', 'C'};
+        uint32_t version = VERSION;
+        uint32_t width = 0;  // pixels, for images
+        uint32_t height = 0; // pixels, for images
+        uint64_t dataSize = 0;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stores = 0;
+        uint64_t filesDeleted = 0;
+    };
+
+    /**
+     * Makes the name an asset gets cached under.
+     * @param md5 the asset's md5, which is its id in the project
+     * @param scale the scale it was decoded at, 1 for anything that doesn't scale
+     * @param format how the data is laid out, like `rgba8`, or a sound's sample rate, sample format and channels
+     */
+    static std::string makeKey(const std::string &md5, float scale, const std::string &format);
+
+    /**
+     * Reads a cached asset.
+     * @param key from `makeKey()`
+     * @param header filled in from the file
+     * @param data filled in with everything after the header
+     * @return `false` if the asset isn't cached, or the cache is turned off.
+     */
+    static bool load(const std::string &key, Header &header, std::vector<unsigned char> &data);
+
+    /**
+     * Caches an asset, replacing any older copy, then trims the folder if it's over its size limit.
+     * Does nothing if the cache is turned off.
+     * @param key from `makeKey()`
+     * @param header `dataSize` gets set from `size`
+     * @param data
+     * @param size size of `data` in bytes
+     */
+    static void store(const std::string &key, Header header, const void *data, size_t size);
+
+    /**
+     * Sets the folder assets get cached in.
+     * @param folder ending in a slash, or empty to turn the cache off
+     */
+    static void setFolder(const std::string &folder);
+
+    /**
+     * Checks whether assets get cached at all.
+     * Off by default everywhere but PC, and `CacheDecodedAssets` in `Settings.json` turns it on or off.
+     */
+    static bool isEnabled();
+
+    /**
+     * Sets how big the folder can get before the least recently used files get deleted.
+     * @param bytes
+     */
+    static void setMaxSize(size_t bytes);
+
+    /**
+     * Gets the hit, miss and store counts since the program started.
+     */
+    static Stats getStats();
+};
@@ -0,0 +1,201 @@
+#include "drawOrder.hpp"
+#include "interpret.hpp"
+#include "sprite.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+namespace {
+
+/**
+ * A node of an implicit treap: nodes are ordered by their position in the tree rather than a key,
+ * and each one knows how many nodes are under it, so a node's index is found by walking up to the root.
+ */
+struct Node {
+    Sprite *sprite = nullptr;
+    Node *left = nullptr;
+    Node *right = nullptr;
+    Node *parent = nullptr;
+    uint32_t priority = 0;
+    size_t count = 1; // this node and everything under it
+};
+
+std::unordered_map<Sprite *, Node> nodes; // node addresses stay the same as the map grows
+Node *root = nullptr;
+uint32_t seed = 0x9e3779b9;
+
+std::vector<Sprite *> drawOrder;
+bool changed = false;
+
+uint32_t nextPriority() {
+    // xorshift, the tree only needs its priorities to look random
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+size_t countOf(const Node *node) {
+    return node ? node->count : 0;
+}
+
+void update(Node *node) {
+    node->count = 1 + countOf(node->left) + countOf(node->right);
+    if (node->left) node->left->parent = node;
+    if (node->right) node->right->parent = node;
+}
+
+/**
+ * Splits a tree into its first `index` nodes and the rest.
+ */
+void split(Node *node, size_t index, Node *&first, Node *&rest) {
+    if (!node) {
+        first = rest = nullptr;
+        return;
+    }
+    if (countOf(node->left) < index) {
+        split(node->right, index - countOf(node->left) - 1, node->right, rest);
+        first = node;
+    } else {
+        split(node->left, index, first, node->left);
+        rest = node;
+    }
+    update(node);
+}
+
+/**
+ * Joins two trees, with every node of `first` coming before every node of `rest`.
+ */
+Node *merge(Node *first, Node *rest) {
+    if (!first) return rest;
+    if (!rest) return first;
+    if (first->priority > rest->priority) {
+        first->right = merge(first->right, rest);
+        update(first);
+        return first;
+    }
+    rest->left = merge(first, rest->left);
+    update(rest);
+    return rest;
+}
+
+void setRoot(Node *node) {
+    root = node;
+    if (root) root->parent = nullptr;
+    changed = true;
+}
+
+size_t indexOf(const Node *node) {
+    size_t index = countOf(node->left);
+    for (; node->parent; node = node->parent) {
+        if (node == node->parent->right) index += countOf(node->parent->left) + 1;
+    }
+    return index;
+}
+
+Node *findNode(Sprite *sprite) {
+    auto nodeFind = nodes.find(sprite);
+    return nodeFind != nodes.end() ? &nodeFind->second : nullptr;
+}
+
+void insertAt(Node *node, size_t index) {
+    node->left = node->right = node->parent = nullptr;
+    node->count = 1;
+    Node *first, *rest;
+    split(root, index, first, rest);
+    setRoot(merge(merge(first, node), rest));
+}
+
+void detach(Node *node) {
+    Node *first, *middle, *rest;
+    split(root, indexOf(node), first, rest);
+    split(rest, 1, middle, rest);
+    setRoot(merge(first, rest));
+}
+
+void flatten(Node *node) {
+    while (node) {
+        flatten(node->left);
+        node->sprite->layer = static_cast<int>(drawOrder.size());
+        drawOrder.push_back(node->sprite);
+        node = node->right;
+    }
+}
+
+} // namespace
+
+const std::vector<Sprite *> &DrawOrder::get() {
+    if (changed) {
+        drawOrder.clear();
+        flatten(root);
+        changed = false;
+    }
+    return drawOrder;
+}
+
+size_t DrawOrder::size() {
+    return countOf(root);
+}
+
+size_t DrawOrder::getLayer(Sprite *sprite) {
+    const Node *node = findNode(sprite);
+    return node ? indexOf(node) : size();
+}
+
+void DrawOrder::rebuild() {
+    std::vector<Sprite *> ordered;
+    for (Sprite *sprite : sprites) {
+        if (!sprite->toDelete) ordered.push_back(sprite);
+    }
+    std::stable_sort(ordered.begin(), ordered.end(), [](const Sprite *a, const Sprite *b) {
+        // the stage always comes first
+        if (a->isStage != b->isStage) return a->isStage;
+        return a->layer < b->layer;
+    });
+
+    clear();
+    for (Sprite *sprite : ordered) {
+        Node &node = nodes[sprite];
+        node.sprite = sprite;
+        node.priority = nextPriority();
+        setRoot(merge(root, &node));
+    }
+}
+
+void DrawOrder::addBehind(Sprite *sprite, Sprite *other) {
+    remove(sprite);
+
+    const Node *otherNode = other ? findNode(other) : nullptr;
+    size_t index = otherNode ? indexOf(otherNode) : size();
+    // nothing can go behind the stage
+    if (otherNode && other->isStage) index++;
+
+    Node &node = nodes[sprite];
+    node.sprite = sprite;
+    node.priority = nextPriority();
+    insertAt(&node, index);
+}
+
+void DrawOrder::moveTo(Sprite *sprite, long long layer) {
+    Node *node = findNode(sprite);
+    if (!node || sprite->isStage) return;
+
+    const size_t from = indexOf(node);
+    const long long frontLayer = static_cast<long long>(size()) - 1;
+    const size_t to = static_cast<size_t>(std::clamp(layer, std::min(1LL, frontLayer), frontLayer));
+    if (from == to) return;
+    detach(node);
+    insertAt(node, to);
+}
+
+void DrawOrder::remove(Sprite *sprite) {
+    Node *node = findNode(sprite);
+    if (!node) return;
+    detach(node);
+    nodes.erase(sprite);
+}
+
+void DrawOrder::clear() {
+    nodes.clear();
+    setRoot(nullptr);
+}
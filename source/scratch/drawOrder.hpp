@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class Sprite;
+
+/**
+ * The order sprites get drawn in, from the stage at the back to the frontmost sprite.
+ * Sprites are kept in a balanced tree ordered by position, so clones, layer blocks and deleted clones
+ * take O(log n) however many sprites there are, and a sprite's layer is found without renumbering the rest.
+ * Renderers draw the flat list from `get()`, which only gets rebuilt on the first call after something moved.
+ */
+class DrawOrder {
+  public:
+    /**
+     * Gets every sprite from back to front. The stage comes first.
+     * Rebuilding it also updates every sprite's `layer` to its index in the list.
+     */
+    static const std::vector<Sprite *> &get();
+
+    /**
+     * Gets how many sprites there are, including the stage.
+     */
+    static size_t size();
+
+    /**
+     * Gets a sprite's current layer, where the stage is 0 and `size() - 1` the front.
+     * Unlike `Sprite::layer`, this is right even if sprites moved since the last `get()`.
+     * @param sprite
+     * @return The layer, or `size()` if the sprite isn't in the draw order.
+     */
+    static size_t getLayer(Sprite *sprite);
+
+    /**
+     * Rebuilds the order from `sprites`, keeping the order their `layer` puts them in.
+     * Called once a project's sprites have loaded.
+     */
+    static void rebuild();
+
+    /**
+     * Puts a new sprite directly behind another one, like Scratch does with clones.
+     * @param sprite the new sprite
+     * @param other the sprite to go behind, or `nullptr` to go in front of everything
+     */
+    static void addBehind(Sprite *sprite, Sprite *other);
+
+    /**
+     * Moves a sprite to a layer, clamped so it stays in front of the stage.
+     * @param sprite
+     * @param layer the layer to move to, where 1 is the back and `size() - 1` the front
+     */
+    static void moveTo(Sprite *sprite, long long layer);
+
+    /**
+     * Takes a sprite out of the draw order. Called for clones as they get deleted.
+     * @param sprite
+     */
+    static void remove(Sprite *sprite);
+
+    /**
+     * Forgets every sprite. Called when sprites get cleaned up.
+     */
+    static void clear();
+};
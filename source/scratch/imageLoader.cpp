@@ -0,0 +1,263 @@
+#include "imageLoader.hpp"
+#include "assetCache.hpp"
+#include "diskCache.hpp"
+#include "image.hpp"
+#include "interpret.hpp"
+#include "mpmcQueue.hpp"
+#include "os.hpp"
+#include "trace.hpp"
+#include "unzip.hpp"
+#include "workerPool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <unordered_set>
+
+#ifdef __3DS__
+
+// the 3DS has no cores to spare for decoding, so costumes load right away
+
+void ImageLoader::request(const std::string &costumeFile) {
+    if (projectType == UNZIPPED) {
+        Image::loadImageFromFile(costumeFile);
+    } else {
+        Image::loadImageFromSB3(&Unzip::zipArchive, costumeFile);
+    }
+}
+
+void ImageLoader::loadAll(const std::vector<std::string> &costumeFiles) {
+    for (const std::string &costumeFile : costumeFiles) {
+        request(costumeFile);
+    }
+}
+
+void ImageLoader::prefetch(const std::string &costumeFile) {
+}
+
+bool ImageLoader::isLoading(const std::string &imageId) {
+    return false;
+}
+
+void ImageLoader::processUploads(size_t budget) {
+}
+
+void ImageLoader::finishAll() {
+}
+
+void ImageLoader::clear() {
+}
+
+#else
+
+namespace {
+
+// everything but the queue is only touched by the game thread
+MpmcQueue<DecodedImage> finished(ImageLoader::MAX_IN_FLIGHT);
+std::unordered_set<std::string> loading; // ids of requested costumes that haven't been uploaded yet
+std::deque<DecodedImage> waiting;        // requests waiting for a decoding slot
+std::deque<std::string> prefetches;      // costume files to load once nothing is waiting, oldest first
+size_t inFlight = 0;
+
+/**
+ * Checks whether there's room in `AssetCache`'s budget for another guess, leaving a quarter of it for costumes that get used.
+ */
+bool hasMemoryToSpare() {
+    return AssetCache::getUsage() < AssetCache::getBudget() / 4 * 3;
+}
+
+std::string getImageId(const std::string &costumeFile) {
+    return costumeFile.substr(0, costumeFile.find_last_of('.'));
+}
+
+bool isSVGFile(const std::string &costumeFile) {
+    std::string extension = costumeFile.substr(costumeFile.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == "svg";
+}
+
+void startDecoding(DecodedImage &&image) {
+    inFlight++;
+    WorkerPool::submit([image = std::move(image)]() mutable {
+        TRACE_SCOPE("decode " + image.costumeFile, "asset");
+        image.decoded = ImageLoader::load(&Unzip::zipArchive, image);
+        // there are never more decodes than slots in the queue, so this only waits if
+        // the game thread is halfway through taking a costume out of the slot it needs
+        while (!finished.push(std::move(image))) {
+            std::this_thread::yield();
+        }
+    });
+}
+
+void startWaiting() {
+    while (inFlight < ImageLoader::MAX_IN_FLIGHT && !waiting.empty()) {
+        startDecoding(std::move(waiting.front()));
+        waiting.pop_front();
+    }
+
+    // prefetches get whatever time the requests leave over
+    while (inFlight < ImageLoader::PREFETCH_IN_FLIGHT && !prefetches.empty() && hasMemoryToSpare()) {
+        DecodedImage image;
+        image.costumeFile = std::move(prefetches.front());
+        prefetches.pop_front();
+        image.id = getImageId(image.costumeFile);
+        image.prefetched = true;
+        // it may have been requested, or loaded, since it was prefetched
+        if (loading.find(image.id) != loading.end() || ImageLoader::isLoaded(image.id)) continue;
+        TRACE_INSTANT("prefetch " + image.costumeFile, "asset");
+        loading.insert(image.id);
+        startDecoding(std::move(image));
+    }
+}
+
+/**
+ * Uploads one finished costume, if there is one.
+ * @return The costume's size in bytes, or 0 if nothing had finished.
+ */
+size_t uploadNext() {
+    DecodedImage image;
+    if (!finished.pop(image)) return 0;
+    inFlight--;
+    loading.erase(image.id);
+    if (!image.decoded) {
+        Log::logWarning("Failed to load image: " + image.costumeFile);
+        return 1;
+    }
+    TRACE_SCOPE("upload " + image.costumeFile, "asset");
+    ImageLoader::upload(image);
+    return std::max<size_t>(image.rgba.size(), 1);
+}
+
+} // namespace
+
+void ImageLoader::request(const std::string &costumeFile) {
+    const std::string imageId = getImageId(costumeFile);
+    const bool loaded = isLoaded(imageId);
+    if (projectType == UNZIPPED) {
+        AssetCache::countLookup(loaded);
+        Image::loadImageFromFile(costumeFile);
+        return;
+    }
+    // an image that's still loading was already counted as a miss when it got requested
+    if (loading.find(imageId) != loading.end()) return;
+    AssetCache::countLookup(loaded);
+    if (loaded) return;
+    loading.insert(imageId);
+
+    DecodedImage image;
+    image.id = imageId;
+    image.costumeFile = costumeFile;
+    waiting.push_back(std::move(image));
+    startWaiting();
+}
+
+void ImageLoader::loadAll(const std::vector<std::string> &costumeFiles) {
+    if (projectType == UNZIPPED) {
+        for (const std::string &costumeFile : costumeFiles) {
+            Image::loadImageFromFile(costumeFile);
+        }
+        return;
+    }
+
+    std::vector<DecodedImage> images;
+    std::unordered_set<std::string> listed;
+    for (const std::string &costumeFile : costumeFiles) {
+        const std::string imageId = getImageId(costumeFile);
+        if (loading.find(imageId) != loading.end() || isLoaded(imageId) || !listed.insert(imageId).second) continue;
+        DecodedImage image;
+        image.id = imageId;
+        image.costumeFile = costumeFile;
+        images.push_back(std::move(image));
+    }
+
+    // each job only writes to its own image, and uploading waits for the whole group
+    for (size_t start = 0; start < images.size(); start += MAX_IN_FLIGHT) {
+        const size_t end = std::min(start + MAX_IN_FLIGHT, images.size());
+        for (size_t i = start; i < end; i++) {
+            DecodedImage *image = &images[i];
+            WorkerPool::submit([image]() {
+                TRACE_SCOPE("decode " + image->costumeFile, "asset");
+                image->decoded = ImageLoader::load(&Unzip::zipArchive, *image);
+            });
+        }
+        WorkerPool::waitIdle();
+
+        for (size_t i = start; i < end; i++) {
+            DecodedImage &image = images[i];
+            if (!image.decoded) {
+                Log::logWarning("Failed to load image: " + image.costumeFile);
+                continue;
+            }
+            TRACE_SCOPE("upload " + image.costumeFile, "asset");
+            upload(image);
+            image = DecodedImage();
+        }
+    }
+}
+
+void ImageLoader::prefetch(const std::string &costumeFile) {
+    if (projectType == UNZIPPED) return;
+    const std::string imageId = getImageId(costumeFile);
+    if (loading.find(imageId) != loading.end() || isLoaded(imageId)) return;
+    if (std::find(prefetches.begin(), prefetches.end(), costumeFile) != prefetches.end()) return;
+
+    prefetches.push_back(costumeFile);
+    if (prefetches.size() > MAX_PREFETCHES) prefetches.pop_front();
+    startWaiting();
+}
+
+bool ImageLoader::isLoading(const std::string &imageId) {
+    return loading.find(imageId) != loading.end();
+}
+
+void ImageLoader::processUploads(size_t budget) {
+    size_t uploaded = 0;
+    while (uploaded < budget) {
+        const size_t size = uploadNext();
+        if (size == 0) break;
+        uploaded += size;
+    }
+    startWaiting();
+}
+
+void ImageLoader::finishAll() {
+    while (!loading.empty()) {
+        WorkerPool::waitIdle();
+        processUploads(SIZE_MAX);
+    }
+}
+
+bool ImageLoader::load(mz_zip_archive *zip, DecodedImage &image) {
+    const bool isSVG = isSVGFile(image.costumeFile);
+    const std::string cacheKey = DiskCache::makeKey(image.id, 1.0f, "rgba8");
+    DiskCache::Header cached;
+    if (!isSVG && DiskCache::load(cacheKey, cached, image.rgba)) {
+        image.width = static_cast<int>(cached.width);
+        image.height = static_cast<int>(cached.height);
+        image.isSVG = false;
+        if (image.rgba.size() == static_cast<size_t>(image.width) * image.height * 4) return true;
+        image.rgba.clear();
+    }
+
+    if (!decode(zip, image)) return false;
+    if (!isSVG && !image.rgba.empty()) {
+        DiskCache::Header header;
+        header.width = static_cast<uint32_t>(image.width);
+        header.height = static_cast<uint32_t>(image.height);
+        DiskCache::store(cacheKey, header, image.rgba.data(), image.rgba.size());
+    }
+    return true;
+}
+
+void ImageLoader::clear() {
+    waiting.clear();
+    prefetches.clear();
+    WorkerPool::waitIdle();
+    DecodedImage image;
+    while (finished.pop(image)) {
+    }
+    loading.clear();
+    inFlight = 0;
+}
+
+#endif
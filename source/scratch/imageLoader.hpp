@@ -0,0 +1,129 @@
+#pragma once
+#include "miniz/miniz.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * A costume decoded on a worker thread, waiting for the game thread to turn it into a texture.
+ */
+struct DecodedImage {
+    std::string id;                  // the costume's id, without a file extension
+    std::string costumeFile;         // the costume's file name in the project
+    std::vector<unsigned char> rgba; // tightly packed, `width * 4` bytes per row
+    int width = 0;
+    int height = 0;
+    bool isSVG = false;
+    bool decoded = false;    // `false` if decoding failed
+    bool prefetched = false; // `true` if nothing had asked for the costume when it started loading
+};
+
+/**
+ * Loads costumes in the background, so switching to a costume for the first time doesn't stall the game thread
+ * for as long as inflating, decoding and uploading it takes.
+ * Worker threads decode costumes, a few at a time, and pass the pixels back through a lock-free queue.
+ * Renderers call `processUploads()` once a frame to turn finished costumes into textures, and keep drawing a
+ * sprite's previous costume until its current one is ready.
+ * Costumes that will probably be needed soon can be prefetched, which only uses decoding slots nothing else wants.
+ * Unzipped projects, and the 3DS, still load costumes right away, and don't prefetch.
+ */
+class ImageLoader {
+  public:
+    /**
+     * Most costumes that get decoded at the same time. Requests past this wait their turn.
+     */
+    static constexpr size_t MAX_IN_FLIGHT = 8;
+
+    /**
+     * Bytes of pixels `processUploads()` turns into textures per frame by default.
+     * At least one costume always gets uploaded, however big it is.
+     */
+    static constexpr size_t UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+    /**
+     * Prefetches only start decoding while fewer than this many costumes are decoding, so requests always find a free slot.
+     */
+    static constexpr size_t PREFETCH_IN_FLIGHT = 2;
+
+    /**
+     * Most prefetches that wait for a turn. Past this, the oldest guesses get dropped.
+     */
+    static constexpr size_t MAX_PREFETCHES = 64;
+
+    /**
+     * Starts loading a costume, unless it's loaded or loading already.
+     * @param costumeFile the costume's file name in the project, like `Costume::fullName`
+     */
+    static void request(const std::string &costumeFile);
+
+    /**
+     * Loads costumes right away, like the ones a project starts with. They get decoded on worker threads,
+     * `MAX_IN_FLIGHT` at a time, and uploaded in the order they're listed, whichever finishes first.
+     * @param costumeFiles the costumes' file names in the project, like `Costume::fullName`
+     */
+    static void loadAll(const std::vector<std::string> &costumeFiles);
+
+    /**
+     * Loads a costume that will probably be needed soon, once decoding slots and memory are free.
+     * Prefetching stops once `AssetCache` is three quarters full, and prefetched costumes are the first to go
+     * when it runs out of room, so they never push out ones that are in use.
+     * @param costumeFile the costume's file name in the project, like `Costume::fullName`
+     */
+    static void prefetch(const std::string &costumeFile);
+
+    /**
+     * Checks whether a costume is still being loaded.
+     * @param imageId the costume's id, without a file extension
+     */
+    static bool isLoading(const std::string &imageId);
+
+    /**
+     * Uploads costumes that finished decoding, and starts decoding the ones waiting for a turn.
+     * Called by renderers once a frame.
+     * @param budget bytes of pixels to upload before leaving the rest for the next frame
+     */
+    static void processUploads(size_t budget = UPLOAD_BUDGET);
+
+    /**
+     * Waits for every requested costume to decode, and uploads all of them.
+     */
+    static void finishAll();
+
+    /**
+     * Waits for decoding costumes to finish and throws them away. Called before a project's zip gets closed.
+     */
+    static void clear();
+
+    /**
+     * Reads a costume from `DiskCache` if it was decoded on an earlier run, or decodes it and caches it for next time.
+     * SVGs always get parsed, so they can be rasterized at other scales, and `SvgCache` caches their rasterizations itself.
+     * Safe to call from worker threads.
+     * @param zip
+     * @param image `id` and `costumeFile` are filled in, everything else gets set from the costume's pixels
+     * @return `false` if the costume couldn't be decoded.
+     */
+    static bool load(mz_zip_archive *zip, DecodedImage &image);
+
+    // implemented by each platform:
+
+    /**
+     * Checks whether a costume has been loaded.
+     * @param imageId the costume's id, without a file extension
+     */
+    static bool isLoaded(const std::string &imageId);
+
+    /**
+     * Decodes a costume from a project's zip. Called on worker threads, so it must not touch the renderer.
+     * @param zip
+     * @param image `id` and `costumeFile` are filled in, everything else gets set from the costume's pixels
+     * @return `false` if the costume couldn't be decoded.
+     */
+    static bool decode(mz_zip_archive *zip, DecodedImage &image);
+
+    /**
+     * Turns a decoded costume into something the renderer can draw, and builds its collision mask.
+     * Called on the game thread.
+     * @param image
+     */
+    static void upload(DecodedImage &image);
+};
@@ -1,11 +1,15 @@
 #pragma once
 #include "interpret.hpp"
 #include "os.hpp"
+#include "spatialGrid.hpp"
 #include <algorithm>
+#include <array>
+#include <bitset>
 #include <fstream>
 #include <map>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Input {
@@ -20,16 +24,111 @@ class Input {
     static Mouse mousePointer;
     static Sprite *draggingSprite;
 
-    static std::vector<std::string> inputButtons;
     static std::map<std::string, std::string> inputControls;
 
+    static constexpr int MAX_KEYS = 256;
+    static constexpr int ANY_KEY = 0;
+
+    /**
+     * Controller buttons, which `inputControls` maps to keys by their name in `buttonNames`.
+     */
+    enum Button {
+        BUTTON_DPAD_UP,
+        BUTTON_DPAD_DOWN,
+        BUTTON_DPAD_LEFT,
+        BUTTON_DPAD_RIGHT,
+        BUTTON_A,
+        BUTTON_B,
+        BUTTON_X,
+        BUTTON_Y,
+        BUTTON_SHOULDER_L,
+        BUTTON_SHOULDER_R,
+        BUTTON_START,
+        BUTTON_BACK,
+        BUTTON_LEFT_STICK_RIGHT,
+        BUTTON_LEFT_STICK_LEFT,
+        BUTTON_LEFT_STICK_DOWN,
+        BUTTON_LEFT_STICK_UP,
+        BUTTON_LEFT_STICK_PRESSED,
+        BUTTON_RIGHT_STICK_RIGHT,
+        BUTTON_RIGHT_STICK_LEFT,
+        BUTTON_RIGHT_STICK_DOWN,
+        BUTTON_RIGHT_STICK_UP,
+        BUTTON_RIGHT_STICK_PRESSED,
+        BUTTON_LT,
+        BUTTON_RT,
+        BUTTON_COUNT
+    };
+    static const std::array<const char *, BUTTON_COUNT> buttonNames;
+
+    // the key id every button presses, or -1 if it isn't mapped. Worked out by `applyControls()`.
+    static std::array<int, BUTTON_COUNT> buttonKeyIds;
+
+    // every key name seen so far, interned to an id into the key bitsets. "any" is always `ANY_KEY`.
+    static std::unordered_map<std::string, int> keyIds;
+    static std::vector<std::string> keyNames;
+
+    static std::bitset<MAX_KEYS> keysHeld;
+    static std::bitset<MAX_KEYS> keysHeldLastFrame;
+    static std::array<int, MAX_KEYS> keyHeldFramesById;
+
+    /**
+     * Gets the id a key name is interned to, interning it if it's new.
+     * @param key Scratch name of the key, like "space" or "left arrow".
+     * @return The key's id, or -1 if there are already `MAX_KEYS` different keys.
+     */
+    static int getKeyId(const std::string &key) {
+        auto idFind = keyIds.find(key);
+        if (idFind != keyIds.end()) return idFind->second;
+        if (keyNames.size() >= MAX_KEYS) return -1;
+        keyIds.emplace(key, static_cast<int>(keyNames.size()));
+        keyNames.push_back(key);
+        return static_cast<int>(keyNames.size()) - 1;
+    }
+
+    /**
+     * Checks if a key is held this frame.
+     * @param keyId id from `getKeyId()`.
+     */
+    static bool isKeyDown(int keyId) {
+        return keyId >= 0 && keysHeld[keyId];
+    }
+
+    static bool isKeyDown(const std::string &key) {
+        auto idFind = keyIds.find(key);
+        return idFind != keyIds.end() && keysHeld[idFind->second];
+    }
+
+    /**
+     * Gets the names of every key held this frame, including "any".
+     * Only for things that need the names, like recording input; checking keys should use their ids.
+     */
+    static std::vector<std::string> getHeldKeys() {
+        std::vector<std::string> held;
+        for (size_t keyId = 0; keyId < keyNames.size(); keyId++) {
+            if (keysHeld[keyId]) held.push_back(keyNames[keyId]);
+        }
+        return held;
+    }
+
     static bool isAbsolutePath(const std::string &path) {
         return path.size() > 0 && path[0] == '/';
     }
 
     static void applyControls(std::string controlsFilePath = "") {
         inputControls.clear();
+        loadControls(controlsFilePath);
+
+        for (size_t button = 0; button < BUTTON_COUNT; button++) {
+            auto controlFind = inputControls.find(buttonNames[button]);
+            buttonKeyIds[button] = controlFind != inputControls.end() ? getKeyId(controlFind->second) : -1;
+        }
+    }
 
+    /**
+     * Fills in `inputControls` from a controls file, or with the default controls if there isn't one.
+     */
+    static void loadControls(const std::string &controlsFilePath) {
         if (controlsFilePath != "") {
             // load controls from file
             std::ifstream file(controlsFilePath);
@@ -79,40 +178,85 @@ class Input {
         inputControls["RT"] = "f";
     }
 
-    static void buttonPress(std::string button) {
-        if (inputControls.find(button) != inputControls.end()) {
-            inputButtons.push_back(inputControls[button]);
-        }
+    /**
+     * Starts this frame's key state. Every platform's `getInput()` calls this before pressing any keys.
+     */
+    static void clearKeyStates() {
+        keysHeldLastFrame = keysHeld;
+        keysHeld.reset();
+    }
+
+    /**
+     * Holds a key down for this frame, along with "any".
+     * @param keyId id from `getKeyId()`, or -1 to only hold "any".
+     */
+    static void pressKey(int keyId) {
+        keysHeld.set(ANY_KEY);
+        if (keyId >= 0) keysHeld.set(keyId);
+    }
+
+    static void buttonPress(Button button) {
+        pressKey(buttonKeyIds[button]);
     }
 
-    static bool isKeyJustPressed(std::string scratchKey) {
-        return (std::find(Input::inputButtons.begin(), Input::inputButtons.end(), scratchKey) != Input::inputButtons.end()) &&
-               Input::keyHeldFrames < 2;
+    /**
+     * Checks if a key went down this frame.
+     * @param scratchKey Scratch name of the key.
+     */
+    static bool isKeyJustPressed(const std::string &scratchKey) {
+        auto idFind = keyIds.find(scratchKey);
+        return idFind != keyIds.end() && keysHeld[idFind->second] && !keysHeldLastFrame[idFind->second];
+    }
+
+    /**
+     * Starts the "when key pressed" scripts of every key that just went down, or that's been held long enough to repeat.
+     * Every platform's `getInput()` calls this once it's pressed this frame's keys.
+     */
+    static void updateKeyStates() {
+        keyHeldFrames = keysHeld[ANY_KEY] ? keyHeldFrames + 1 : 0;
+
+        std::bitset<MAX_KEYS> keysToStart;
+        for (size_t keyId = 0; keyId < keyNames.size(); keyId++) {
+            if (!keysHeld[keyId]) {
+                keyHeldFramesById[keyId] = 0;
+                continue;
+            }
+            keyHeldFramesById[keyId]++;
+            if (keyHeldFramesById[keyId] == 1 || keyHeldFramesById[keyId] > 13) keysToStart.set(keyId);
+        }
+        if (keysToStart.none()) return;
+
+        // gather first, since the scripts can create clones and change `sprites`
+        static std::vector<std::pair<Block *, Sprite *>> hatsToRun;
+        hatsToRun.clear();
+        for (Sprite *sprite : sprites) {
+            for (auto &[keyId, hats] : sprite->keyHats) {
+                if (!keysToStart[keyId]) continue;
+                for (Block *hat : hats) {
+                    hatsToRun.push_back({hat, sprite});
+                }
+            }
+        }
+        for (auto &[hat, sprite] : hatsToRun) {
+            executor.runBlock(*hat, sprite);
+        }
     }
 
     static void doSpriteClicking() {
         if (mousePointer.isPressed) {
             mousePointer.heldFrames++;
-            bool hasClicked = false;
-            for (auto &sprite : sprites) {
-                // click a sprite
-                if (sprite->shouldDoSpriteClick) {
-                    if (mousePointer.heldFrames < 2 && isColliding("mouse", sprite)) {
-
-                        // run all "when this sprite clicked" blocks in the sprite
-                        hasClicked = true;
-                        for (auto &[id, data] : sprite->blocks) {
-                            if (data.opcode == "event_whenthisspriteclicked") {
-                                executor.runBlock(data, sprite);
-                            }
-                        }
+            // only the frontmost sprite under the mouse gets clicked, like in Scratch
+            if (mousePointer.heldFrames < 2) {
+                Sprite *clickedSprite = getSpriteAtMouse();
+                if (clickedSprite != nullptr) {
+                    // start dragging a sprite
+                    if (draggingSprite == nullptr && clickedSprite->draggable) draggingSprite = clickedSprite;
+
+                    // run all "when this sprite clicked" blocks in the sprite
+                    for (Block *hat : clickedSprite->clickHats) {
+                        executor.runBlock(*hat, clickedSprite);
                     }
                 }
-                // start dragging a sprite
-                if (draggingSprite == nullptr && mousePointer.heldFrames < 2 && sprite->draggable && isColliding("mouse", sprite)) {
-                    draggingSprite = sprite;
-                }
-                if (hasClicked) break;
             }
         } else {
             mousePointer.heldFrames = 0;
@@ -126,6 +270,7 @@ class Input {
             }
             draggingSprite->xPosition = mousePointer.x - (draggingSprite->spriteWidth / 2);
             draggingSprite->yPosition = mousePointer.y + (draggingSprite->spriteHeight / 2);
+            SpatialGrid::markMoved(draggingSprite);
         }
     }
 
@@ -0,0 +1,349 @@
+#include "inputRecorder.hpp"
+#include "input.hpp"
+#include "interpret.hpp"
+#include "keyboard.hpp"
+#include "os.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+InputRecorder::Mode InputRecorder::mode = InputRecorder::OFF;
+std::string InputRecorder::recordPath;
+std::string InputRecorder::replayPath;
+
+namespace {
+
+/*
+ * Log layout, every number is a LEB128 varint unless said otherwise:
+ *   header:  "SEIR", format version (byte), random seed (4 bytes, little endian)
+ *   records: a flags byte, then
+ *     answer (flags == ANSWER_RECORD): length, answer text
+ *     frame:   microseconds since the previous frame,
+ *              x, y (zigzag)                       if MOUSE_MOVED
+ *              button count, (length, name) each   if BUTTONS_CHANGED
+ * Mouse position and buttons are only stored when they change, so idle frames take 2-3 bytes.
+ */
+const char magic[4] = {'S', 'E', 'I', 'R'};
+const uint8_t formatVersion = 1;
+
+enum FrameFlags : uint8_t {
+    MOUSE_PRESSED = 1 << 0,
+    MOUSE_MOVING = 1 << 1,
+    MOUSE_MOVED = 1 << 2,
+    BUTTONS_CHANGED = 1 << 3,
+    ANSWER_RECORD = 1 << 7
+};
+
+struct Frame {
+    long long deltaUs = 0;
+    uint8_t flags = 0;
+    int x = 0;
+    int y = 0;
+    std::vector<std::string> buttons;
+};
+
+// recording
+std::ofstream recordFile;
+Timer frameClock;
+Frame lastRecorded;
+std::bitset<Input::MAX_KEYS> lastRecordedKeys;
+size_t framesRecorded = 0;
+
+// replaying
+std::vector<Frame> replayFrames;
+std::deque<std::string> replayAnswers;
+size_t replayIndex = 0;
+std::vector<int> replayKeyIds;
+
+void writeVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void writeString(std::vector<uint8_t> &out, const std::string &text) {
+    writeVarint(out, text.size());
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+uint64_t zigzag(int value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63);
+}
+
+int unzigzag(uint64_t value) {
+    return static_cast<int>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1));
+}
+
+struct Reader {
+    const std::vector<uint8_t> &data;
+    size_t pos = 0;
+
+    bool atEnd() const {
+        return pos >= data.size();
+    }
+
+    bool readByte(uint8_t &value) {
+        if (atEnd()) return false;
+        value = data[pos++];
+        return true;
+    }
+
+    bool readVarint(uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!readByte(byte)) return false;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool readString(std::string &text) {
+        uint64_t length;
+        if (!readVarint(length) || length > data.size() - pos) return false;
+        text.assign(reinterpret_cast<const char *>(data.data() + pos), length);
+        pos += length;
+        return true;
+    }
+};
+
+bool readFrame(Reader &reader, uint8_t flags, Frame &frame) {
+    frame.flags = flags;
+    uint64_t value;
+    if (!reader.readVarint(value)) return false;
+    frame.deltaUs = static_cast<long long>(value);
+    if (flags & MOUSE_MOVED) {
+        uint64_t x, y;
+        if (!reader.readVarint(x) || !reader.readVarint(y)) return false;
+        frame.x = unzigzag(x);
+        frame.y = unzigzag(y);
+    }
+    if (flags & BUTTONS_CHANGED) {
+        uint64_t count;
+        if (!reader.readVarint(count) || count > 256) return false;
+        frame.buttons.resize(count);
+        for (std::string &button : frame.buttons) {
+            if (!reader.readString(button)) return false;
+        }
+    }
+    return true;
+}
+
+bool startRecording(const std::string &filePath) {
+    recordFile.open(filePath, std::ios::binary | std::ios::trunc);
+    if (!recordFile.is_open()) {
+        Log::logError("Could not open input recording for writing: " + filePath);
+        return false;
+    }
+
+    // take the seed from the current generator, so seeded runs (like headless ones) stay seeded
+    uint32_t seed = static_cast<uint32_t>(rand());
+    srand(seed);
+
+    recordFile.write(magic, sizeof(magic));
+    const uint8_t header[5] = {formatVersion, static_cast<uint8_t>(seed), static_cast<uint8_t>(seed >> 8),
+                               static_cast<uint8_t>(seed >> 16), static_cast<uint8_t>(seed >> 24)};
+    recordFile.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    lastRecorded = Frame();
+    lastRecordedKeys.reset();
+    framesRecorded = 0;
+    frameClock.start();
+    Log::log("Recording input to " + filePath);
+    return true;
+}
+
+bool startReplay(const std::string &filePath) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        Log::logError("Could not open input recording: " + filePath);
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(magic) + 5 || !std::equal(magic, magic + sizeof(magic), data.begin())) {
+        Log::logError("Not an input recording: " + filePath);
+        return false;
+    }
+    if (data[4] != formatVersion) {
+        Log::logError("Unsupported input recording version " + std::to_string(data[4]) + ": " + filePath);
+        return false;
+    }
+    uint32_t seed = data[5] | (data[6] << 8) | (data[7] << 16) | (static_cast<uint32_t>(data[8]) << 24);
+
+    replayFrames.clear();
+    replayAnswers.clear();
+    Reader reader{data, sizeof(magic) + 5};
+    bool truncated = false;
+    while (!reader.atEnd() && !truncated) {
+        uint8_t flags;
+        reader.readByte(flags);
+
+        if (flags == ANSWER_RECORD) {
+            std::string answer;
+            truncated = !reader.readString(answer);
+            if (!truncated) replayAnswers.push_back(answer);
+            continue;
+        }
+
+        Frame frame;
+        truncated = !readFrame(reader, flags, frame);
+        if (!truncated) replayFrames.push_back(std::move(frame));
+    }
+    // a recording cut off by a crash is still worth replaying up to that point
+    if (truncated) {
+        Log::logWarning("Input recording is truncated, replaying the first " + std::to_string(replayFrames.size()) + " frames.");
+    }
+    if (replayFrames.empty()) {
+        Log::logError("Input recording has no frames: " + filePath);
+        return false;
+    }
+
+    srand(seed);
+    replayIndex = 0;
+    replayKeyIds.clear();
+    Log::log("Replaying " + std::to_string(replayFrames.size()) + " frames of input from " + filePath);
+    return true;
+}
+
+void recordFrame(long long deltaUs) {
+    Frame frame;
+    frame.deltaUs = deltaUs;
+    frame.x = Input::mousePointer.x;
+    frame.y = Input::mousePointer.y;
+    if (Input::mousePointer.isPressed) frame.flags |= MOUSE_PRESSED;
+    if (Input::mousePointer.isMoving) frame.flags |= MOUSE_MOVING;
+    if (framesRecorded == 0 || frame.x != lastRecorded.x || frame.y != lastRecorded.y) frame.flags |= MOUSE_MOVED;
+    // key names are only needed in the log, and only when the held keys changed
+    if (framesRecorded == 0 || Input::keysHeld != lastRecordedKeys) {
+        frame.flags |= BUTTONS_CHANGED;
+        frame.buttons = Input::getHeldKeys();
+        lastRecordedKeys = Input::keysHeld;
+    }
+
+    std::vector<uint8_t> out;
+    out.push_back(frame.flags);
+    writeVarint(out, static_cast<uint64_t>(deltaUs));
+    if (frame.flags & MOUSE_MOVED) {
+        writeVarint(out, zigzag(frame.x));
+        writeVarint(out, zigzag(frame.y));
+    }
+    if (frame.flags & BUTTONS_CHANGED) {
+        writeVarint(out, frame.buttons.size());
+        for (const std::string &button : frame.buttons) {
+            writeString(out, button);
+        }
+    }
+    recordFile.write(reinterpret_cast<const char *>(out.data()), out.size());
+
+    lastRecorded = std::move(frame);
+    framesRecorded++;
+}
+
+/**
+ * Does what the platform's `Input::getInput()` does with the recorded buttons and mouse.
+ */
+void applyFrame(const Frame &frame) {
+    if (frame.flags & BUTTONS_CHANGED) {
+        replayKeyIds.clear();
+        for (const std::string &button : frame.buttons) {
+            replayKeyIds.push_back(Input::getKeyId(button));
+        }
+    }
+    if (frame.flags & MOUSE_MOVED) {
+        Input::mousePointer.x = frame.x;
+        Input::mousePointer.y = frame.y;
+    }
+    Input::mousePointer.isPressed = frame.flags & MOUSE_PRESSED;
+    Input::mousePointer.isMoving = frame.flags & MOUSE_MOVING;
+    Input::clearKeyStates();
+    for (int keyId : replayKeyIds) {
+        Input::pressKey(keyId);
+    }
+    Input::updateKeyStates();
+
+    Input::doSpriteClicking();
+}
+
+} // namespace
+
+void InputRecorder::begin() {
+    end();
+    if (!replayPath.empty()) {
+        if (startReplay(replayPath)) mode = REPLAYING;
+    } else if (!recordPath.empty()) {
+        if (startRecording(recordPath)) mode = RECORDING;
+    }
+    if (mode != OFF) Timer::setProjectClockActive(true);
+}
+
+void InputRecorder::getInput() {
+    switch (mode) {
+    case OFF:
+        Input::getInput();
+        break;
+    case RECORDING: {
+        long long deltaUs = frameClock.getTimeUs();
+        frameClock.start();
+        Timer::advanceProjectClock(deltaUs);
+        Input::getInput();
+        recordFrame(deltaUs);
+        break;
+    }
+    case REPLAYING:
+        if (replayIndex < replayFrames.size()) {
+            const Frame &frame = replayFrames[replayIndex++];
+            Timer::advanceProjectClock(frame.deltaUs);
+            applyFrame(frame);
+        }
+        if (replayIndex == replayFrames.size()) {
+            // stop once the last recorded frame has run
+            if (!Scratch::shouldStop) Log::log("Replay finished after " + std::to_string(replayIndex) + " frames.");
+            Scratch::shouldStop = true;
+        }
+        break;
+    }
+}
+
+std::string InputRecorder::getAnswer(const std::string &question) {
+    if (mode == REPLAYING) {
+        if (replayAnswers.empty()) {
+            Log::logWarning("Input recording has no answer left for: " + question);
+            return "";
+        }
+        std::string answer = replayAnswers.front();
+        replayAnswers.pop_front();
+        return answer;
+    }
+
+    Keyboard kbd;
+    std::string answer = kbd.openKeyboard(question.c_str());
+    if (mode == RECORDING) {
+        std::vector<uint8_t> out;
+        out.push_back(ANSWER_RECORD);
+        writeString(out, answer);
+        recordFile.write(reinterpret_cast<const char *>(out.data()), out.size());
+        // the keyboard can be open for a while, which shouldn't count as frame time
+        frameClock.start();
+    }
+    return answer;
+}
+
+void InputRecorder::end() {
+    if (recordFile.is_open()) {
+        recordFile.close();
+        Log::log("Recorded " + std::to_string(framesRecorded) + " frames of input.");
+    }
+    replayFrames.clear();
+    replayAnswers.clear();
+    replayKeyIds.clear();
+    mode = OFF;
+    Timer::setProjectClockActive(false);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+
+/**
+ * Records the input a project sees every frame (buttons, mouse, `ask` answers, frame times and the random seed)
+ * to a compact binary log, and plays such a log back frame for frame.
+ * While recording or replaying, project timers follow `Timer`'s project clock, so waits, glides and the
+ * timer block see the recorded frame times instead of real ones. Combined with a fixed timestep
+ * (like the headless build's), a replay runs the project exactly like the recorded session did.
+ */
+class InputRecorder {
+  public:
+    enum Mode {
+        OFF,
+        RECORDING,
+        REPLAYING
+    };
+    static Mode mode;
+
+    /**
+     * Where the next project's input gets recorded to. Empty to not record.
+     */
+    static std::string recordPath;
+
+    /**
+     * Recording to play back in the next project. Empty to not replay. Takes priority over `recordPath`.
+     */
+    static std::string replayPath;
+
+    /**
+     * Starts recording or replaying, depending on `recordPath` and `replayPath`.
+     * Must be called right before the green flag, since it reseeds `rand()`.
+     */
+    static void begin();
+
+    /**
+     * Moves the project clock forward and gets this frame's input, either from the platform
+     * (`Input::getInput()`) or from the recording. Replaying stops the project after the last recorded frame.
+     */
+    static void getInput();
+
+    /**
+     * Gets the answer to an `ask` block, either from the keyboard or from the recording.
+     * @param question
+     * @return The answer.
+     */
+    static std::string getAnswer(const std::string &question);
+
+    /**
+     * Finishes recording or replaying, and switches project timers back to the system clock.
+     */
+    static void end();
+};
@@ -0,0 +1,42 @@
+#include "input.hpp"
+
+// input state shared by every platform, whose `input.cpp` only reads the hardware
+
+Input::Mouse Input::mousePointer;
+Sprite *Input::draggingSprite = nullptr;
+
+std::map<std::string, std::string> Input::inputControls;
+std::unordered_map<std::string, int> Input::keyIds = {{"any", Input::ANY_KEY}};
+std::vector<std::string> Input::keyNames = {"any"};
+std::bitset<Input::MAX_KEYS> Input::keysHeld;
+std::bitset<Input::MAX_KEYS> Input::keysHeldLastFrame;
+std::array<int, Input::MAX_KEYS> Input::keyHeldFramesById = {};
+int Input::keyHeldFrames = 0;
+
+const std::array<const char *, Input::BUTTON_COUNT> Input::buttonNames = {
+    "dpadUp",
+    "dpadDown",
+    "dpadLeft",
+    "dpadRight",
+    "A",
+    "B",
+    "X",
+    "Y",
+    "shoulderL",
+    "shoulderR",
+    "start",
+    "back",
+    "LeftStickRight",
+    "LeftStickLeft",
+    "LeftStickDown",
+    "LeftStickUp",
+    "LeftStickPressed",
+    "RightStickRight",
+    "RightStickLeft",
+    "RightStickDown",
+    "RightStickUp",
+    "RightStickPressed",
+    "LT",
+    "RT",
+};
+std::array<int, Input::BUTTON_COUNT> Input::buttonKeyIds = {};
@@ -1,13 +1,23 @@
 #include "interpret.hpp"
 #include "audio.hpp"
+#include "collisionMask.hpp"
+#include "drawOrder.hpp"
 #include "image.hpp"
+#include "imageLoader.hpp"
 #include "input.hpp"
+#include "inputRecorder.hpp"
 #include "math.hpp"
 #include "nlohmann/json.hpp"
 #include "os.hpp"
+#include "perfOverlay.hpp"
+#include "prefetcher.hpp"
 #include "render.hpp"
+#include "spatialGrid.hpp"
 #include "sprite.hpp"
+#include "trace.hpp"
 #include "unzip.hpp"
+#include "workerPool.hpp"
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstring>
@@ -31,7 +41,7 @@ const uint64_t FNV_OFFSET_BASIS_64 = 14695981039346656037ULL;
 
 std::string cloudUsername;
 
-std::string projectJSON;
+uint64_t projectJSONHash = 0;
 extern bool cloudProject;
 
 std::unique_ptr<MistConnection> cloudConnection = nullptr;
@@ -42,7 +52,9 @@ std::string customUsername;
 
 std::vector<Sprite *> sprites;
 std::vector<Sprite> spritePool;
-std::vector<std::string> broadcastQueue;
+BroadcastQueue broadcastQueue;
+std::unordered_map<std::string, int> broadcastIds;
+std::vector<std::string> broadcastNames;
 std::unordered_map<std::string, Block *> blockLookup;
 std::string answer;
 bool toExit = false;
@@ -68,6 +80,14 @@ bool cloudProject = false;
 #endif
 
 #ifdef ENABLE_CLOUDVARS
+void hashProjectJSON(const char *json, size_t size) {
+    projectJSONHash = FNV_OFFSET_BASIS_64;
+    for (size_t i = 0; i < size; i++) {
+        projectJSONHash ^= static_cast<uint64_t>(static_cast<unsigned char>(json[i]));
+        projectJSONHash *= FNV_PRIME_64;
+    }
+}
+
 void initMist() {
     // Username Stuff
 
@@ -94,14 +114,8 @@ void initMist() {
     }
     fileStream.close();
 
-    uint64_t projectHash = FNV_OFFSET_BASIS_64;
-    for (char c : projectJSON) {
-        projectHash ^= static_cast<uint64_t>(static_cast<unsigned char>(c));
-        projectHash *= FNV_PRIME_64;
-    }
-
     std::ostringstream projectID;
-    projectID << "Scratch-3DS/hash-" << std::hex << std::setw(16) << std::setfill('0') << projectHash;
+    projectID << "Scratch-3DS/hash-" << std::hex << std::setw(16) << std::setfill('0') << projectJSONHash;
     cloudConnection = std::make_unique<MistConnection>(projectID.str(), cloudUsername, "contact@grady.link");
 
     cloudConnection->onConnectionStatus([](bool connected, const std::string &message) {
@@ -127,6 +141,7 @@ void initMist() {
 bool Scratch::startScratchProject() {
     customUsername = "Player";
     useCustomUsername = false;
+    PerfOverlay::benchmarkTicks = 0;
 
     std::ifstream inFile(OS::getScratchFolderLocation() + "Settings.json");
     if (inFile.good()) {
@@ -150,21 +165,39 @@ bool Scratch::startScratchProject() {
             if (hasNonSpace) customUsername = j["Username"].get<std::string>();
             else customUsername = "Player";
         }
+
+        if (j.contains("RecordInput") && j["RecordInput"].is_boolean() && j["RecordInput"].get<bool>()) {
+            InputRecorder::recordPath = OS::getScratchFolderLocation() + "input-recording.bin";
+        }
+
+        if (j.contains("ReplayInput") && j["ReplayInput"].is_string()) {
+            InputRecorder::replayPath = OS::getScratchFolderLocation() + j["ReplayInput"].get<std::string>();
+        }
+
+        if (j.contains("BenchmarkTicks") && j["BenchmarkTicks"].is_number_integer()) {
+            PerfOverlay::benchmarkTicks = std::max(0, j["BenchmarkTicks"].get<int>());
+        }
     }
 #ifdef ENABLE_CLOUDVARS
-    if (cloudProject && !projectJSON.empty()) initMist();
+    if (cloudProject && projectJSONHash != 0) initMist();
 #endif
     Scratch::nextProject = false;
 
+    InputRecorder::begin();
+    BlockExecutor::clearSleepingChains();
     BlockExecutor::runAllBlocksByOpcode("event_whenflagclicked");
     BlockExecutor::timer.start();
 
     while (Render::appShouldRun()) {
         if (Render::checkFramerate()) {
-            Input::getInput();
+            TRACE_SCOPE("Frame", "frame");
+            PerfOverlay::beginFrame();
+            InputRecorder::getInput();
             BlockExecutor::runRepeatBlocks();
             BlockExecutor::runBroadcasts();
+            PerfOverlay::logicFinished();
             Render::renderSprites();
+            PerfOverlay::endFrame();
 
             if (shouldStop) {
 #ifdef __WIIU__ // wii u freezes for some reason.. TODO fix that but for now just exit app
@@ -186,8 +219,17 @@ bool Scratch::startScratchProject() {
 }
 
 void Scratch::cleanupScratchProject() {
+    TRACE_STOP();
+    InputRecorder::end();
+    BlockExecutor::clearSleepingChains();
+    broadcastQueue.clear();
+    broadcastIds.clear();
+    broadcastNames.clear();
+    ImageLoader::clear();
+    Prefetcher::clear();
     cleanupSprites();
     Image::cleanupImages();
+    CollisionMask::clear();
     SoundPlayer::cleanupAudio();
     blockLookup.clear();
 
@@ -195,6 +237,7 @@ void Scratch::cleanupScratchProject() {
         delete text;
     }
     Render::monitorTexts.clear();
+    PerfOverlay::cleanup();
     TextObject::cleanupText();
 
     Render::visibleVariables.clear();
@@ -210,12 +253,13 @@ void Scratch::cleanupScratchProject() {
         }
         Unzip::zipBuffer.clear();
         Unzip::zipBuffer.shrink_to_fit();
+        ZipEntry::setArchiveMemory(nullptr, nullptr, 0);
+        Unzip::zipMapping.close();
         memset(&Unzip::zipArchive, 0, sizeof(Unzip::zipArchive));
     }
 
 #ifdef ENABLE_CLOUDVARS
-    projectJSON.clear();
-    projectJSON.shrink_to_fit();
+    projectJSONHash = 0;
 #endif
 
     // reset default settings
@@ -242,6 +286,37 @@ void initializeSpritePool(int poolSize) {
     }
 }
 
+int getBroadcastId(const std::string &name) {
+    auto idFind = broadcastIds.find(name);
+    if (idFind == broadcastIds.end()) return -1;
+    return idFind->second;
+}
+
+void indexHatBlocks(Sprite *sprite) {
+    sprite->broadcastHats.clear();
+    sprite->keyHats.clear();
+    sprite->clickHats.clear();
+    for (auto &[id, block] : sprite->blocks) {
+        if (block.opcode == "event_whenthisspriteclicked") {
+            sprite->clickHats.push_back(&block);
+            continue;
+        }
+        if (block.opcode == "event_whenkeypressed") {
+            int keyId = Input::getKeyId(Scratch::getFieldValue(block, "KEY_OPTION"));
+            if (keyId >= 0) sprite->keyHats[keyId].push_back(&block);
+            continue;
+        }
+        if (block.opcode != "event_whenbroadcastreceived") continue;
+        const std::string name = Scratch::getFieldValue(block, "BROADCAST_OPTION");
+        auto idFind = broadcastIds.find(name);
+        if (idFind == broadcastIds.end()) {
+            idFind = broadcastIds.emplace(name, static_cast<int>(broadcastNames.size())).first;
+            broadcastNames.push_back(name);
+        }
+        sprite->broadcastHats[idFind->second].push_back(&block);
+    }
+}
+
 Sprite *getAvailableSprite() {
     for (Sprite &sprite : spritePool) {
         if (sprite.isDeleted) {
@@ -264,10 +339,15 @@ void cleanupSprites() {
     }
     sprites.clear();
     spritePool.clear();
+    SpatialGrid::clear();
+    DrawOrder::clear();
 }
 
-std::vector<std::pair<double, double>> getCollisionPoints(Sprite *currentSprite) {
-    std::vector<std::pair<double, double>> collisionPoints;
+const std::vector<std::pair<double, double>> &getCollisionPoints(Sprite *currentSprite) {
+    std::vector<std::pair<double, double>> &collisionPoints = currentSprite->collisionPoints;
+    if (!currentSprite->collisionPointsDirty) return collisionPoints;
+    currentSprite->collisionPointsDirty = false;
+    collisionPoints.clear();
 
     double divisionAmount = 2.0;
 
@@ -289,12 +369,13 @@ std::vector<std::pair<double, double>> getCollisionPoints(Sprite *currentSprite)
             rotation = -90;
     }
 
-    double rotationRadians = (rotation - 90) * M_PI / 180.0;
+    // Scratch directions turn clockwise
+    double rotationRadians = -(rotation - 90) * M_PI / 180.0;
     double rotationCenterX = ((currentSprite->rotationCenterX - currentSprite->spriteWidth) * 0.75);
     double rotationCenterY = ((currentSprite->rotationCenterY - currentSprite->spriteHeight) * 0.75);
 
     // Define the four corners relative to the sprite's center
-    std::vector<std::pair<double, double>> corners = {
+    const std::pair<double, double> corners[4] = {
         {-halfWidth - (rotationCenterX * currentSprite->size * 0.01), -halfHeight + (rotationCenterY)}, // Top-left
         {halfWidth - (rotationCenterX * currentSprite->size * 0.01), -halfHeight + (rotationCenterY)},  // Top-right
         {halfWidth - (rotationCenterX * currentSprite->size * 0.01), halfHeight + (rotationCenterY)},   // Bottom-right
@@ -302,18 +383,31 @@ std::vector<std::pair<double, double>> getCollisionPoints(Sprite *currentSprite)
     };
 
     // Rotate and translate each corner
+    const double cosRotation = cos(rotationRadians);
+    const double sinRotation = sin(rotationRadians);
+    CollisionBounds &bounds = currentSprite->collisionBounds;
+    bounds = {INFINITY, INFINITY, -INFINITY, -INFINITY};
     for (const auto &corner : corners) {
-        double rotatedX = corner.first * cos(rotationRadians) - corner.second * sin(rotationRadians);
-        double rotatedY = corner.first * sin(rotationRadians) + corner.second * cos(rotationRadians);
+        double rotatedX = corner.first * cosRotation - corner.second * sinRotation;
+        double rotatedY = corner.first * sinRotation + corner.second * cosRotation;
 
         collisionPoints.emplace_back(
             currentSprite->xPosition + rotatedX,
             currentSprite->yPosition + rotatedY);
+        bounds.minX = std::min(bounds.minX, collisionPoints.back().first);
+        bounds.minY = std::min(bounds.minY, collisionPoints.back().second);
+        bounds.maxX = std::max(bounds.maxX, collisionPoints.back().first);
+        bounds.maxY = std::max(bounds.maxY, collisionPoints.back().second);
     }
 
     return collisionPoints;
 }
 
+const CollisionBounds &getCollisionBounds(Sprite *sprite) {
+    getCollisionPoints(sprite);
+    return sprite->collisionBounds;
+}
+
 bool isSeparated(const std::vector<std::pair<double, double>> &poly1,
                  const std::vector<std::pair<double, double>> &poly2,
                  double axisX, double axisY) {
@@ -337,64 +431,81 @@ bool isSeparated(const std::vector<std::pair<double, double>> &poly1,
     return max1 < min2 || max2 < min1;
 }
 
-bool isColliding(std::string collisionType, Sprite *currentSprite, Sprite *targetSprite, std::string targetName) {
-    // Get collision points of the current sprite
-    std::vector<std::pair<double, double>> currentSpritePoints = getCollisionPoints(currentSprite);
+/**
+ * Checks if a sprite's collision box overlaps the small square under the mouse pointer.
+ * @param spritePoints the sprite's points, from `getCollisionPoints()`.
+ */
+static bool isTouchingMouse(const std::vector<std::pair<double, double>> &spritePoints) {
+    // Define a small square centered on the mouse pointer
+    double halfWidth = 0.5;
+    double halfHeight = 0.5;
+
+    std::vector<std::pair<double, double>> mousePoints = {
+        {Input::mousePointer.x - halfWidth, Input::mousePointer.y - halfHeight}, // Top-left
+        {Input::mousePointer.x + halfWidth, Input::mousePointer.y - halfHeight}, // Top-right
+        {Input::mousePointer.x + halfWidth, Input::mousePointer.y + halfHeight}, // Bottom-right
+        {Input::mousePointer.x - halfWidth, Input::mousePointer.y + halfHeight}  // Bottom-left
+    };
 
-    if (collisionType == "mouse") {
-        // Define a small square centered on the mouse pointer
-        double halfWidth = 0.5;
-        double halfHeight = 0.5;
-
-        std::vector<std::pair<double, double>> mousePoints = {
-            {Input::mousePointer.x - halfWidth, Input::mousePointer.y - halfHeight}, // Top-left
-            {Input::mousePointer.x + halfWidth, Input::mousePointer.y - halfHeight}, // Top-right
-            {Input::mousePointer.x + halfWidth, Input::mousePointer.y + halfHeight}, // Bottom-right
-            {Input::mousePointer.x - halfWidth, Input::mousePointer.y + halfHeight}  // Bottom-left
-        };
-
-        bool collision = true;
-
-        for (int i = 0; i < 4; i++) {
-            auto edge1 = std::make_pair(
-                currentSpritePoints[(i + 1) % 4].first - currentSpritePoints[i].first,
-                currentSpritePoints[(i + 1) % 4].second - currentSpritePoints[i].second);
-            auto edge2 = std::make_pair(
-                mousePoints[(i + 1) % 4].first - mousePoints[i].first,
-                mousePoints[(i + 1) % 4].second - mousePoints[i].second);
-
-            double axis1X = -edge1.second, axis1Y = edge1.first;
-            double axis2X = -edge2.second, axis2Y = edge2.first;
-
-            double len1 = sqrt(axis1X * axis1X + axis1Y * axis1Y);
-            double len2 = sqrt(axis2X * axis2X + axis2Y * axis2Y);
-            if (len1 > 0) {
-                axis1X /= len1;
-                axis1Y /= len1;
-            }
-            if (len2 > 0) {
-                axis2X /= len2;
-                axis2Y /= len2;
-            }
+    for (int i = 0; i < 4; i++) {
+        auto edge1 = std::make_pair(
+            spritePoints[(i + 1) % 4].first - spritePoints[i].first,
+            spritePoints[(i + 1) % 4].second - spritePoints[i].second);
+        auto edge2 = std::make_pair(
+            mousePoints[(i + 1) % 4].first - mousePoints[i].first,
+            mousePoints[(i + 1) % 4].second - mousePoints[i].second);
 
-            if (isSeparated(currentSpritePoints, mousePoints, axis1X, axis1Y) ||
-                isSeparated(currentSpritePoints, mousePoints, axis2X, axis2Y)) {
-                collision = false;
-                break;
-            }
+        double axis1X = -edge1.second, axis1Y = edge1.first;
+        double axis2X = -edge2.second, axis2Y = edge2.first;
+
+        double len1 = sqrt(axis1X * axis1X + axis1Y * axis1Y);
+        double len2 = sqrt(axis2X * axis2X + axis2Y * axis2Y);
+        if (len1 > 0) {
+            axis1X /= len1;
+            axis1Y /= len1;
         }
+        if (len2 > 0) {
+            axis2X /= len2;
+            axis2Y /= len2;
+        }
+
+        if (isSeparated(spritePoints, mousePoints, axis1X, axis1Y) ||
+            isSeparated(spritePoints, mousePoints, axis2X, axis2Y)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Sprite *getSpriteAtMouse() {
+    const std::vector<Sprite *> &drawOrder = DrawOrder::get();
+    for (auto it = drawOrder.rbegin(); it != drawOrder.rend(); ++it) {
+        Sprite *sprite = *it;
+        if (sprite->isStage || !sprite->visible || sprite->toDelete) continue;
+
+        // bounding box check first, most sprites are nowhere near the mouse
+        const CollisionBounds &bounds = getCollisionBounds(sprite);
+        if (Input::mousePointer.x + 0.5 < bounds.minX || Input::mousePointer.x - 0.5 > bounds.maxX ||
+            Input::mousePointer.y + 0.5 < bounds.minY || Input::mousePointer.y - 0.5 > bounds.maxY) continue;
 
-        return collision;
+        if (isTouchingMouse(getCollisionPoints(sprite))) return sprite;
+    }
+    return nullptr;
+}
+
+bool isColliding(std::string collisionType, Sprite *currentSprite, Sprite *targetSprite, std::string targetName) {
+    // Get collision points of the current sprite
+    const std::vector<std::pair<double, double>> &currentSpritePoints = getCollisionPoints(currentSprite);
+
+    if (collisionType == "mouse") {
+        return isTouchingMouse(currentSpritePoints);
     } else if (collisionType == "edge") {
         double halfWidth = Scratch::projectWidth / 2.0;
         double halfHeight = Scratch::projectHeight / 2.0;
 
-        // Check if the current sprite is touching the edge of the screen
-        if (currentSprite->xPosition <= -halfWidth || currentSprite->xPosition >= halfWidth ||
-            currentSprite->yPosition <= -halfHeight || currentSprite->yPosition >= halfHeight) {
-            return true;
-        }
-        return false;
+        // Check if the current sprite's box reaches past the edge of the screen
+        const CollisionBounds &bounds = getCollisionBounds(currentSprite);
+        return bounds.minX < -halfWidth || bounds.maxX > halfWidth || bounds.minY < -halfHeight || bounds.maxY > halfHeight;
     } else if (collisionType == "sprite") {
         // Use targetSprite if provided, otherwise search by name
         if (targetSprite == nullptr && !targetName.empty()) {
@@ -410,7 +521,7 @@ bool isColliding(std::string collisionType, Sprite *currentSprite, Sprite *targe
             return false;
         }
 
-        std::vector<std::pair<double, double>> targetSpritePoints = getCollisionPoints(targetSprite);
+        const std::vector<std::pair<double, double>> &targetSpritePoints = getCollisionPoints(targetSprite);
 
         // Check if any point of current sprite is inside target sprite
         for (const auto &currentPoint : currentSpritePoints) {
@@ -431,7 +542,7 @@ bool isColliding(std::string collisionType, Sprite *currentSprite, Sprite *targe
             }
 
             if ((intersections % 2) == 1) {
-                return true;
+                return CollisionMask::spritesOverlap(currentSprite, currentSpritePoints, targetSprite, targetSpritePoints);
             }
         }
 
@@ -454,7 +565,7 @@ bool isColliding(std::string collisionType, Sprite *currentSprite, Sprite *targe
             }
 
             if ((intersections % 2) == 1) {
-                return true;
+                return CollisionMask::spritesOverlap(currentSprite, currentSpritePoints, targetSprite, targetSpritePoints);
             }
         }
     }
@@ -465,9 +576,10 @@ bool isColliding(std::string collisionType, Sprite *currentSprite, Sprite *targe
 void Scratch::fenceSpriteWithinBounds(Sprite *sprite) {
     double halfWidth = Scratch::projectWidth / 2.0;
     double halfHeight = Scratch::projectHeight / 2.0;
-    double scale = sprite->size / 100.0;
-    double spriteHalfWidth = (sprite->spriteWidth * scale) / 2.0;
-    double spriteHalfHeight = (sprite->spriteHeight * scale) / 2.0;
+
+    // the sprite was just moved, so its cached box needs updating first
+    SpatialGrid::markMoved(sprite);
+    const CollisionBounds &bounds = getCollisionBounds(sprite);
 
     // how much of the sprite remains visible when fenced
     const double sliverSize = 5.0;
@@ -477,335 +589,49 @@ void Scratch::fenceSpriteWithinBounds(Sprite *sprite) {
     double maxBottom = halfHeight - sliverSize;
     double minTop = -halfHeight + sliverSize;
 
-    if (sprite->xPosition - spriteHalfWidth > maxLeft) {
-        sprite->xPosition = maxLeft + spriteHalfWidth;
-    }
-    if (sprite->xPosition + spriteHalfWidth < minRight) {
-        sprite->xPosition = minRight - spriteHalfWidth;
-    }
-    if (sprite->yPosition - spriteHalfHeight > maxBottom) {
-        sprite->yPosition = maxBottom + spriteHalfHeight;
-    }
-    if (sprite->yPosition + spriteHalfHeight < minTop) {
-        sprite->yPosition = minTop - spriteHalfHeight;
-    }
+    double dx = 0;
+    double dy = 0;
+    if (bounds.minX > maxLeft) dx = maxLeft - bounds.minX;
+    if (bounds.maxX < minRight) dx = minRight - bounds.maxX;
+    if (bounds.minY > maxBottom) dy = maxBottom - bounds.minY;
+    if (bounds.maxY < minTop) dy = minTop - bounds.maxY;
+    if (dx == 0 && dy == 0) return;
+
+    sprite->xPosition += dx;
+    sprite->yPosition += dy;
+    SpatialGrid::markMoved(sprite);
 }
 
-void loadSprites(const nlohmann::json &json) {
-    Log::log("beginning to load sprites...");
-    sprites.reserve(400);
-    for (const auto &target : json["targets"]) { // "target" is sprite in Scratch speak, so for every sprite in sprites
-
-        // Sprite *newSprite = MemoryTracker::allocate<Sprite>();
-        Sprite *newSprite = new Sprite();
-        // new (newSprite) Sprite();
-        if (target.contains("name")) {
-            newSprite->name = target["name"].get<std::string>();
-        }
-        newSprite->id = Math::generateRandomString(15);
-        if (target.contains("isStage")) {
-            newSprite->isStage = target["isStage"].get<bool>();
-        }
-        if (target.contains("draggable")) {
-            newSprite->draggable = target["draggable"].get<bool>();
-        }
-        if (target.contains("visible")) {
-            newSprite->visible = target["visible"].get<bool>();
-        } else newSprite->visible = true;
-        if (target.contains("currentCostume")) {
-            newSprite->currentCostume = target["currentCostume"].get<int>();
-        }
-        if (target.contains("volume")) {
-            newSprite->volume = target["volume"].get<int>();
-        }
-        if (target.contains("x")) {
-            newSprite->xPosition = target["x"].get<int>();
-        }
-        if (target.contains("y")) {
-            newSprite->yPosition = target["y"].get<int>();
-        }
-        if (target.contains("size")) {
-            newSprite->size = target["size"].get<int>();
-        } else newSprite->size = 100;
-        if (target.contains("direction")) {
-            newSprite->rotation = target["direction"].get<int>();
-        } else newSprite->rotation = 90;
-        if (target.contains("layerOrder")) {
-            newSprite->layer = target["layerOrder"].get<int>();
-        } else newSprite->layer = 0;
-        if (target.contains("rotationStyle")) {
-            if (target["rotationStyle"].get<std::string>() == "all around")
-                newSprite->rotationStyle = newSprite->ALL_AROUND;
-            else if (target["rotationStyle"].get<std::string>() == "left-right")
-                newSprite->rotationStyle = newSprite->LEFT_RIGHT;
-            else
-                newSprite->rotationStyle = newSprite->NONE;
-        }
-        newSprite->toDelete = false;
-        newSprite->isClone = false;
-        // std::cout<<"name = "<< newSprite.name << std::endl;
-
-        // set variables
-        for (const auto &[id, data] : target["variables"].items()) {
-
-            Variable newVariable;
-            newVariable.id = id;
-            newVariable.name = data[0];
-            newVariable.value = Value::fromJson(data[1]);
-#ifdef ENABLE_CLOUDVARS
-            newVariable.cloud = data.size() == 3;
-            cloudProject = cloudProject || newVariable.cloud;
-#endif
-            newSprite->variables[newVariable.id] = newVariable; // add variable to sprite
-        }
-
-        // set Blocks
-        for (const auto &[id, data] : target["blocks"].items()) {
-
-            Block newBlock;
-            newBlock.id = id;
-            if (data.contains("opcode")) {
-                newBlock.opcode = data["opcode"].get<std::string>();
-
-                if (newBlock.opcode == "event_whenthisspriteclicked") newSprite->shouldDoSpriteClick = true;
-            }
-            if (data.contains("next") && !data["next"].is_null()) {
-                newBlock.next = data["next"].get<std::string>();
-            }
-            if (data.contains("parent") && !data["parent"].is_null()) {
-                newBlock.parent = data["parent"].get<std::string>();
-            } else newBlock.parent = "null";
-            if (data.contains("fields")) {
-                for (const auto &[fieldName, fieldData] : data["fields"].items()) {
-                    ParsedField parsedField;
-
-                    // Fields are almost always arrays with [0] being the value
-                    if (fieldData.is_array() && !fieldData.empty()) {
-                        parsedField.value = fieldData[0].get<std::string>();
-
-                        // Store ID for variables and lists
-                        if (fieldData.size() > 1 && !fieldData[1].is_null()) {
-                            parsedField.id = fieldData[1].get<std::string>();
-                        }
-                    }
-
-                    (*newBlock.parsedFields)[fieldName] = parsedField;
-                }
-            }
-            if (data.contains("inputs")) {
-
-                for (const auto &[inputName, inputData] : data["inputs"].items()) {
-                    ParsedInput parsedInput;
-
-                    int type = inputData[0];
-                    auto &inputValue = inputData[1];
-
-                    if (type == 1) {
-                        parsedInput.inputType = ParsedInput::LITERAL;
-                        parsedInput.literalValue = Value::fromJson(inputValue);
-
-                    } else if (type == 3) {
-                        if (inputValue.is_array()) {
-                            parsedInput.inputType = ParsedInput::VARIABLE;
-                            parsedInput.variableId = inputValue[2].get<std::string>();
-                        } else {
-                            parsedInput.inputType = ParsedInput::BLOCK;
-                            if (!inputValue.is_null())
-                                parsedInput.blockId = inputValue.get<std::string>();
-                        }
-                    } else if (type == 2) {
-                        parsedInput.inputType = ParsedInput::BOOLEAN;
-                        parsedInput.blockId = inputValue.get<std::string>();
-                    }
-                    (*newBlock.parsedInputs)[inputName] = parsedInput;
-                }
-            }
-            if (data.contains("topLevel")) {
-                newBlock.topLevel = data["topLevel"].get<bool>();
-            }
-            if (data.contains("shadow")) {
-                newBlock.shadow = data["shadow"].get<bool>();
-            }
-            if (data.contains("mutation")) {
-                if (data["mutation"].contains("proccode")) {
-                    newBlock.customBlockId = data["mutation"]["proccode"].get<std::string>();
-                } else {
-                    newBlock.customBlockId = "";
-                }
-            }
-            newSprite->blocks[newBlock.id] = newBlock; // add block
-
-            // add custom function blocks
-            if (newBlock.opcode == "procedures_prototype") {
-                if (!data.is_array()) {
-                    CustomBlock newCustomBlock;
-                    newCustomBlock.name = data["mutation"]["proccode"];
-                    newCustomBlock.blockId = newBlock.id;
-
-                    // custom blocks uses a different json structure for some reason?? have to parse them.
-                    std::string rawArgumentNames = data["mutation"]["argumentnames"];
-                    nlohmann::json parsedAN = nlohmann::json::parse(rawArgumentNames);
-                    newCustomBlock.argumentNames = parsedAN.get<std::vector<std::string>>();
-
-                    std::string rawArgumentDefaults = data["mutation"]["argumentdefaults"];
-                    nlohmann::json parsedAD = nlohmann::json::parse(rawArgumentDefaults);
-                    // newCustomBlock.argumentDefaults = parsedAD.get<std::vector<std::string>>();
-
-                    for (const auto &item : parsedAD) {
-                        if (item.is_string()) {
-                            newCustomBlock.argumentDefaults.push_back(item.get<std::string>());
-                        } else if (item.is_number_integer()) {
-                            newCustomBlock.argumentDefaults.push_back(std::to_string(item.get<int>()));
-                        } else if (item.is_number_float()) {
-                            newCustomBlock.argumentDefaults.push_back(std::to_string(item.get<double>()));
-                        } else {
-                            newCustomBlock.argumentDefaults.push_back(item.dump());
-                        }
-                    }
-
-                    std::string rawArgumentIds = data["mutation"]["argumentids"];
-                    nlohmann::json parsedAID = nlohmann::json::parse(rawArgumentIds);
-                    newCustomBlock.argumentIds = parsedAID.get<std::vector<std::string>>();
-
-                    if (data["mutation"]["warp"] == "true") {
-                        newCustomBlock.runWithoutScreenRefresh = true;
-                    } else newCustomBlock.runWithoutScreenRefresh = false;
-
-                    newSprite->customBlocks[newCustomBlock.name] = newCustomBlock; // add custom block
-                } else {
-                    Log::logError("Unknown Custom block data: " + data.dump()); // TODO handle these
-                }
-            }
-        }
-
-        // set Lists
-        for (const auto &[id, data] : target["lists"].items()) {
-            List newList;
-            newList.id = id;
-            newList.name = data[0];
-            for (const auto &listItem : data[1]) {
-                newList.items.push_back(Value::fromJson(listItem));
-            }
-            newSprite->lists[newList.id] = newList; // add list
-        }
-
-        // set Sounds
-        for (const auto &[id, data] : target["sounds"].items()) {
-            Sound newSound;
-            newSound.id = data["assetId"];
-            newSound.name = data["name"];
-            newSound.fullName = data["md5ext"];
-            newSound.dataFormat = data["dataFormat"];
-            newSound.sampleRate = data["rate"];
-            newSound.sampleCount = data["sampleCount"];
-            newSprite->sounds[newSound.name] = newSound;
-        }
-
-        // set Costumes
-        for (const auto &[id, data] : target["costumes"].items()) {
-            Costume newCostume;
-            newCostume.id = data["assetId"];
-            if (data.contains("name")) {
-                newCostume.name = data["name"];
-            }
-            if (data.contains("bitmapResolution")) {
-                newCostume.bitmapResolution = data["bitmapResolution"];
-            }
-            if (data.contains("dataFormat")) {
-                newCostume.dataFormat = data["dataFormat"];
-                if (newCostume.dataFormat == "svg" || newCostume.dataFormat == "SVG")
-                    newCostume.isSVG = true;
-                else
-                    newCostume.isSVG = false;
-            }
-            if (data.contains("md5ext")) {
-                newCostume.fullName = data["md5ext"];
-            }
-            if (data.contains("rotationCenterX")) {
-                newCostume.rotationCenterX = data["rotationCenterX"];
-            }
-            if (data.contains("rotationCenterY")) {
-                newCostume.rotationCenterY = data["rotationCenterY"];
-            }
-            newSprite->costumes.push_back(newCostume);
-        }
-
-        // set comments
-        for (const auto &[id, data] : target["comments"].items()) {
-            Comment newComment;
-            newComment.id = id;
-            if (data.contains("blockId") && !data["blockId"].is_null()) {
-                newComment.blockId = data["blockId"];
-            }
-            newComment.width = data["width"];
-            newComment.height = data["height"];
-            newComment.minimized = data["minimized"];
-            newComment.x = data["x"];
-            newComment.y = data["y"];
-            newComment.text = data["text"];
-            newSprite->comments[newComment.id] = newComment;
-        }
-
-        // set Broadcasts
-        for (const auto &[id, data] : target["broadcasts"].items()) {
-            Broadcast newBroadcast;
-            newBroadcast.id = id;
-            newBroadcast.name = data;
-            newSprite->broadcasts[newBroadcast.id] = newBroadcast;
-            // std::cout<<"broadcast name = "<< newBroadcast.name << std::endl;
-        }
-
-        sprites.push_back(newSprite);
+/**
+ * Finds the top level block of every block in a sprite, and builds its block chains.
+ * Only writes to the sprite's own blocks, so sprites can be linked on different threads at once.
+ * @param sprite
+ */
+static void linkScripts(Sprite *sprite) {
+    for (auto &[id, block] : sprite->blocks) {
+        if (block.topLevel) continue;                           // skip top level blocks
+        block.topLevelParentBlock = getBlockParent(&block)->id; // get parent block id
     }
 
-    for (const auto &monitor : json["monitors"]) { // "monitor" is any variable shown on screen
-        Monitor newMonitor;
-
-        if (monitor.contains("id") && !monitor["id"].is_null())
-            newMonitor.id = monitor.at("id").get<std::string>();
+    for (auto &[id, block] : sprite->blocks) {
+        if (!block.topLevel) continue;
+        std::string outID;
+        BlockChain chain;
+        chain.blockChain = getBlockChain(block.id, &outID);
+        sprite->blockChains[outID] = chain;
+        block.blockChainID = outID;
 
-        if (monitor.contains("mode") && !monitor["mode"].is_null())
-            newMonitor.mode = monitor.at("mode").get<std::string>();
-
-        if (monitor.contains("opcode") && !monitor["opcode"].is_null())
-            newMonitor.opcode = monitor.at("opcode").get<std::string>();
-
-        if (monitor.contains("params") && monitor["params"].is_object()) {
-            for (const auto &param : monitor["params"].items()) {
-                std::string key = param.key();
-                std::string value = param.value().dump();
-                newMonitor.parameters[key] = value;
+        for (auto &chainBlock : chain.blockChain) {
+            auto blockFind = sprite->blocks.find(chainBlock->id);
+            if (blockFind != sprite->blocks.end()) {
+                blockFind->second.blockChainID = outID;
             }
         }
-
-        if (monitor.contains("spriteName") && !monitor["spriteName"].is_null())
-            newMonitor.spriteName = monitor.at("spriteName").get<std::string>();
-        else
-            newMonitor.spriteName = "";
-
-        if (monitor.contains("value") && !monitor["value"].is_null())
-            newMonitor.value = Value(Math::removeQuotations(monitor.at("value").dump()));
-
-        if (monitor.contains("x") && !monitor["x"].is_null())
-            newMonitor.x = monitor.at("x").get<int>();
-
-        if (monitor.contains("y") && !monitor["y"].is_null())
-            newMonitor.y = monitor.at("y").get<int>();
-
-        if (monitor.contains("visible") && !monitor["visible"].is_null())
-            newMonitor.visible = monitor.at("visible").get<bool>();
-
-        if (monitor.contains("isDiscrete") && !monitor["isDiscrete"].is_null())
-            newMonitor.isDiscrete = monitor.at("isDiscrete").get<bool>();
-
-        if (monitor.contains("sliderMin") && !monitor["sliderMin"].is_null())
-            newMonitor.sliderMin = monitor.at("sliderMin").get<double>();
-
-        if (monitor.contains("sliderMax") && !monitor["sliderMax"].is_null())
-            newMonitor.sliderMax = monitor.at("sliderMax").get<double>();
-
-        Render::visibleVariables.push_back(newMonitor);
     }
+}
+
+void finishLoadingSprites() {
+    DrawOrder::rebuild();
 
     // load block lookup table
     blockLookup.clear();
@@ -814,15 +640,37 @@ void loadSprites(const nlohmann::json &json) {
             blockLookup[id] = &block;
         }
     }
-    // setup top level blocks
+    // intern broadcasts and keys, then resolve the ones used with a literal message or key
+    for (Sprite *currentSprite : sprites) {
+        indexHatBlocks(currentSprite);
+    }
     for (Sprite *currentSprite : sprites) {
         for (auto &[id, block] : currentSprite->blocks) {
-            if (block.topLevel) continue;                           // skip top level blocks
-            block.topLevelParentBlock = getBlockParent(&block)->id; // get parent block id
-            // std::cout<<"block id = "<< block.topLevelParentBlock << std::endl;
+            // costumes only keep their colors when something senses them
+            if (block.opcode == "sensing_touchingcolor" || block.opcode == "sensing_coloristouchingcolor") {
+                CollisionMask::keepColors = true;
+                continue;
+            }
+            if (block.opcode == "sensing_keypressed") {
+                auto inputFind = block.parsedInputs->find("KEY_OPTION");
+                if (inputFind == block.parsedInputs->end() || inputFind->second.inputType != ParsedInput::LITERAL) continue;
+                auto menuFind = currentSprite->blocks.find(inputFind->second.literalValue.asString());
+                if (menuFind != currentSprite->blocks.end())
+                    block.keyId = Input::getKeyId(Scratch::getFieldValue(menuFind->second, "KEY_OPTION"));
+                continue;
+            }
+            if (block.opcode != "event_broadcast" && block.opcode != "event_broadcastandwait") continue;
+            auto inputFind = block.parsedInputs->find("BROADCAST_INPUT");
+            if (inputFind != block.parsedInputs->end() && inputFind->second.inputType == ParsedInput::LITERAL)
+                block.broadcastId = getBroadcastId(inputFind->second.literalValue.asString());
         }
     }
 
+    // setup top level blocks and block chains, a sprite per job since they only read the lookup table
+    for (Sprite *currentSprite : sprites) {
+        WorkerPool::submit([currentSprite]() { linkScripts(currentSprite); });
+    }
+
     // try to find the advanced project settings comment
     nlohmann::json config;
     for (Sprite *currentSprite : sprites) {
@@ -962,7 +810,7 @@ void loadSprites(const nlohmann::json &json) {
             initializeSpritePool(300);
         } else if (OS::getPlatform() == "Switch") {
             initializeSpritePool(1500);
-        } else if (OS::getPlatform() == "PC") {
+        } else if (OS::getPlatform() == "PC" || OS::getPlatform() == "Headless") {
             initializeSpritePool(2000);
         } else {
             Log::logWarning("Unknown platform: " + OS::getPlatform() + " doing default clone limit.");
@@ -970,24 +818,8 @@ void loadSprites(const nlohmann::json &json) {
         }
     }
 
-    // get block chains for every block
-    for (Sprite *currentSprite : sprites) {
-        for (auto &[id, block] : currentSprite->blocks) {
-            if (!block.topLevel) continue;
-            std::string outID;
-            BlockChain chain;
-            chain.blockChain = getBlockChain(block.id, &outID);
-            currentSprite->blockChains[outID] = chain;
-            // std::cout << "ok = " << outID << std::endl;
-            block.blockChainID = outID;
-
-            for (auto &chainBlock : chain.blockChain) {
-                if (currentSprite->blocks.find(chainBlock->id) != currentSprite->blocks.end()) {
-                    currentSprite->blocks[chainBlock->id].blockChainID = outID;
-                }
-            }
-        }
-    }
+    WorkerPool::waitIdle();
+    Prefetcher::indexScripts();
 
     Unzip::loadingState = "Running Flag block";
 
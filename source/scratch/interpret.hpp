@@ -1,5 +1,6 @@
 #pragma once
 #include "blockExecutor.hpp"
+#include "broadcastQueue.hpp"
 #include "sprite.hpp"
 #include <nlohmann/json.hpp>
 #include <string>
@@ -20,7 +21,9 @@ extern ProjectType projectType;
 
 extern std::vector<Sprite *> sprites;
 extern std::vector<Sprite> spritePool;
-extern std::vector<std::string> broadcastQueue;
+extern BroadcastQueue broadcastQueue;
+extern std::unordered_map<std::string, int> broadcastIds;
+extern std::vector<std::string> broadcastNames;
 extern std::unordered_map<std::string, Block *> blockLookup;
 extern bool toExit;
 extern std::string answer;
@@ -51,23 +54,50 @@ class Scratch {
 };
 
 /**
- * Gets the Sprite's box collision points.
+ * Gets the Sprite's box collision points. They're cached on the sprite, and only
+ * worked out again after it moves, turns, resizes or changes costume.
  * @param sprite
  * @return Each point stored in a `std::pair`, where `[0]` is X, `[1]` is Y.
  */
-std::vector<std::pair<double, double>> getCollisionPoints(Sprite *currentSprite);
+const std::vector<std::pair<double, double>> &getCollisionPoints(Sprite *currentSprite);
+
+/**
+ * Gets the bounding box of the Sprite's collision points, cached along with them.
+ * @param sprite
+ */
+const CollisionBounds &getCollisionBounds(Sprite *sprite);
 
 bool isColliding(std::string collisionType, Sprite *currentSprite, Sprite *targetSprite = nullptr, std::string targetName = "");
 
+/**
+ * Finds the sprite a click at the mouse pointer lands on: the frontmost visible sprite under it.
+ * @return The sprite, or `nullptr` if the mouse is only over the stage.
+ */
+Sprite *getSpriteAtMouse();
+
 bool isSeparated(const std::vector<std::pair<double, double>> &poly1,
                  const std::vector<std::pair<double, double>> &poly2,
                  double axisX, double axisY);
 
 /**
- * Loads every Sprite from the Scratch's project.json file.
- * @param json The file to load
+ * Sets up the sprites `ProjectLoader` loaded from the project.json: links their blocks together,
+ * applies the project's advanced settings and gets their first costumes ready.
+ */
+void finishLoadingSprites();
+
+/**
+ * Gets the id a broadcast's name was interned to when the project loaded.
+ * @param name
+ * @return The broadcast's id, or -1 if nothing in the project receives it.
+ */
+int getBroadcastId(const std::string &name);
+
+/**
+ * Builds `sprite->broadcastHats`, `sprite->keyHats` and `sprite->clickHats` from the sprite's hat blocks.
+ * Has to run again whenever a sprite's blocks get copied (like for clones), since the index points into them.
+ * @param sprite
  */
-void loadSprites(const nlohmann::json &json);
+void indexHatBlocks(Sprite *sprite);
 
 /**
  * Frees every Sprite from memory.
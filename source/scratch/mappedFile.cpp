@@ -0,0 +1,45 @@
+#include "mappedFile.hpp"
+#ifdef CAN_MAP_FILES
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &path) {
+    close();
+#ifdef CAN_MAP_FILES
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *address = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file open on its own
+    ::close(fd);
+    if (address == MAP_FAILED) return false;
+
+    mapped = static_cast<const char *>(address);
+    mappedSize = static_cast<size_t>(fileStat.st_size);
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef CAN_MAP_FILES
+    if (mapped) munmap(const_cast<char *>(mapped), mappedSize);
+#endif
+    mapped = nullptr;
+    mappedSize = 0;
+}
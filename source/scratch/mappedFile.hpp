@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#if (defined(__PC__) || defined(HEADLESS_BUILD)) && (defined(__unix__) || defined(__APPLE__))
+#define CAN_MAP_FILES
+#endif
+
+/**
+ * A whole file mapped into memory, read only. Its pages only get read from disk once they're touched, and the OS
+ * can drop them again when it needs the memory, so a big file doesn't take up its whole size in RAM up front.
+ * Only supported on Linux and macOS; everywhere else `open()` fails and the file has to be read normally.
+ */
+class MappedFile {
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    /**
+     * Maps a file, unmapping whatever file was mapped before.
+     * @param path
+     * @return `false` if the file couldn't be mapped.
+     */
+    bool open(const std::string &path);
+
+    /**
+     * Unmaps the file. Anything pointing into it stops being valid.
+     */
+    void close();
+
+    const char *data() const { return mapped; }
+    size_t size() const { return mappedSize; }
+
+  private:
+    const char *mapped = nullptr;
+    size_t mappedSize = 0;
+};
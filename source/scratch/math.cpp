@@ -15,7 +15,7 @@ int Math::color(int r, int g, int b, int a) {
 
 #ifdef __3DS__
     return C2D_Color32(r, g, b, a);
-#elif defined(SDL_BUILD)
+#else
     return (r << 24) |
            (g << 16) |
            (b << 8) |
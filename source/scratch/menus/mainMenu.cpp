@@ -578,9 +578,15 @@ void SettingsMenu::cleanup() {
         ChangeUsername = nullptr;
     }
 
-    // save username and EnableUsername in json
-    std::ofstream outFile(OS::getScratchFolderLocation() + "Settings.json");
+    // save username and EnableUsername in json, keeping any other settings in there
     nlohmann::json j;
+    std::ifstream inFile(OS::getScratchFolderLocation() + "Settings.json");
+    if (inFile.good()) {
+        j = nlohmann::json::parse(inFile, nullptr, false);
+        if (!j.is_object()) j = nlohmann::json::object();
+    }
+    inFile.close();
+    std::ofstream outFile(OS::getScratchFolderLocation() + "Settings.json");
     j["EnableUsername"] = UseCostumeUsername;
     j["Username"] = username;
     outFile << j.dump(4);
@@ -921,22 +927,22 @@ void ControlsMenu::render() {
         Input::keyHeldFrames = -999;
 
         // wait till A isnt pressed
-        while (!Input::inputButtons.empty() && Render::appShouldRun()) {
+        while (Input::keysHeld.any() && Render::appShouldRun()) {
             Input::getInput();
         }
 
         while (Input::keyHeldFrames < 2 && Render::appShouldRun()) {
             Input::getInput();
         }
-        if (!Input::inputButtons.empty()) {
-
-            // remove "any" first
-            auto it = std::find(Input::inputButtons.begin(), Input::inputButtons.end(), "any");
-            if (it != Input::inputButtons.end()) {
-                Input::inputButtons.erase(it);
-            }
+        std::vector<std::string> heldKeys = Input::getHeldKeys();
 
-            std::string key = Input::inputButtons.back();
+        // remove "any" first
+        auto it = std::find(heldKeys.begin(), heldKeys.end(), "any");
+        if (it != heldKeys.end()) {
+            heldKeys.erase(it);
+        }
+        if (!heldKeys.empty()) {
+            std::string key = heldKeys.back();
             for (const auto &pair : Input::inputControls) {
                 if (pair.second == key) {
                     // Update the control value
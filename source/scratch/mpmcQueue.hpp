@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * A fixed size queue any number of threads can push to and pop from without locking.
+ * Every slot has a sequence number telling pushers and poppers whose turn it is, so a thread only
+ * ever waits on the one slot it claimed, and only while another thread is halfway through it.
+ * @tparam T moved in and out of the queue, so it should be cheap to move
+ */
+template <typename T>
+class MpmcQueue {
+  private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> pushPosition{0};
+    alignas(64) std::atomic<size_t> popPosition{0};
+
+  public:
+    /**
+     * @param capacity rounded up to a power of two
+     */
+    explicit MpmcQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots = std::make_unique<Slot[]>(size);
+        for (size_t i = 0; i < size; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mask = size - 1;
+    }
+
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    /**
+     * Adds a value to the back of the queue.
+     * @param value
+     * @return `false` if the queue is full, in which case `value` is left alone.
+     */
+    bool push(T &&value) {
+        size_t position = pushPosition.load(std::memory_order_relaxed);
+        while (true) {
+            Slot &slot = slots[position & mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (difference == 0) {
+                if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Takes the value at the front of the queue.
+     * @param value where the value gets moved to
+     * @return `false` if the queue is empty.
+     */
+    bool pop(T &value) {
+        size_t position = popPosition.load(std::memory_order_relaxed);
+        while (true) {
+            Slot &slot = slots[position & mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+            if (difference == 0) {
+                if (popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(slot.value);
+                    slot.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Gets how many values the queue can hold.
+     */
+    size_t capacity() const {
+        return mask + 1;
+    }
+};
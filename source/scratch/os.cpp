@@ -53,37 +53,95 @@ void Log::writeToFile(std::string message) {
 // Wii and Gamecube Timer implementation
 #ifdef __OGC__
 
-Timer::Timer() {
-    start();
-}
-
 void Timer::start() {
+    if (onProjectClock()) {
+        projectStartTime = projectClock;
+        return;
+    }
     startTime = gettick();
 }
 
 int Timer::getTimeMs() {
+    if (onProjectClock()) return static_cast<int>((projectClock - projectStartTime) / 1000);
     u64 currentTime = gettick();
     return ticks_to_millisecs(currentTime - startTime);
 }
 
-// everyone else...
-#else
-Timer::Timer() {
-    start();
+long long Timer::getTimeUs() {
+    if (onProjectClock()) return projectClock - projectStartTime;
+    u64 currentTime = gettick();
+    return ticks_to_microsecs(currentTime - startTime);
+}
+
+// Headless Timer implementation, driven by the runner's fixed timestep
+#elif defined(HEADLESS_BUILD)
+
+long long Timer::virtualTime = 0;
+
+void Timer::start() {
+    if (onProjectClock()) {
+        projectStartTime = projectClock;
+        return;
+    }
+    startTime = virtualTime;
+}
+
+int Timer::getTimeMs() {
+    if (onProjectClock()) return static_cast<int>((projectClock - projectStartTime) / 1000);
+    return static_cast<int>((virtualTime - startTime) / 1000);
+}
+
+long long Timer::getTimeUs() {
+    if (onProjectClock()) return projectClock - projectStartTime;
+    return virtualTime - startTime;
+}
+
+void Timer::advanceVirtualTime(long long microseconds) {
+    virtualTime += microseconds;
 }
 
+// everyone else...
+#else
 void Timer::start() {
+    if (onProjectClock()) {
+        projectStartTime = projectClock;
+        return;
+    }
     startTime = std::chrono::high_resolution_clock::now();
 }
 
 int Timer::getTimeMs() {
+    if (onProjectClock()) return static_cast<int>((projectClock - projectStartTime) / 1000);
     auto currentTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime);
     return static_cast<int>(duration.count());
 }
 
+long long Timer::getTimeUs() {
+    if (onProjectClock()) return projectClock - projectStartTime;
+    auto currentTime = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(currentTime - startTime);
+    return static_cast<long long>(duration.count());
+}
+
 #endif
 
+bool Timer::projectClockActive = false;
+long long Timer::projectClock = 0;
+
+Timer::Timer(bool followsProjectClock) : followsProjectClock(followsProjectClock) {
+    start();
+}
+
+void Timer::setProjectClockActive(bool active) {
+    projectClockActive = active;
+    projectClock = 0;
+}
+
+void Timer::advanceProjectClock(long long microseconds) {
+    projectClock += microseconds;
+}
+
 bool Timer::hasElapsed(int milliseconds) {
     return getTimeMs() >= milliseconds;
 }
@@ -109,6 +167,8 @@ std::string OS::getScratchFolderLocation() {
     return "ux0:data/scratch-vita/";
 #elif defined(__3DS__)
     return "sdmc:/3ds/scratch-everywhere/";
+#elif defined(HEADLESS_BUILD)
+    return "";
 #else
     return "scratch-everywhere/";
 #endif
@@ -137,6 +197,8 @@ std::string OS::getPlatform() {
     return "Switch";
 #elif defined(VITA)
     return "Vita";
+#elif defined(HEADLESS_BUILD)
+    return "Headless";
 #else
     return "Unknown";
 #endif
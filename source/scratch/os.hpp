@@ -166,12 +166,47 @@ class Timer {
   private:
 #ifdef __OGC__
     u64 startTime;
+#elif defined(HEADLESS_BUILD)
+    long long startTime;
+    static long long virtualTime;
 #else
     std::chrono::high_resolution_clock::time_point startTime;
 #endif
+    long long projectStartTime = 0;
+    bool followsProjectClock;
+    static bool projectClockActive;
+    static long long projectClock;
+
+    bool onProjectClock() const {
+        return followsProjectClock && projectClockActive;
+    }
 
   public:
-    Timer();
+    /**
+     * @param followsProjectClock `true` for timers the project can observe (waits, glides, the timer block).
+     * These read the project clock instead of the system clock while one is active.
+     */
+    Timer(bool followsProjectClock = false);
+    /**
+     * Switches every project timer over to a clock that only moves when `advanceProjectClock` is called,
+     * so a recorded run sees exactly the same times when it gets replayed.
+     * The project clock restarts from 0 every time it's activated.
+     * @param active
+     */
+    static void setProjectClockActive(bool active);
+    /**
+     * Moves the project clock forward.
+     * @param microseconds
+     */
+    static void advanceProjectClock(long long microseconds);
+#ifdef HEADLESS_BUILD
+    /**
+     * Moves the virtual clock every `Timer` reads from forward.
+     * Headless builds run on a fixed timestep, so time only passes when the runner says so.
+     * @param microseconds
+     */
+    static void advanceVirtualTime(long long microseconds);
+#endif
     /**
      * Starts the clock.
      */
@@ -181,6 +216,11 @@ class Timer {
      * @return time passed (in ms)
      */
     int getTimeMs();
+    /**
+     * Gets the amount of time passed in microseconds.
+     * @return time passed (in us)
+     */
+    long long getTimeUs();
     /**
      * Checks if enough time, in milliseconds, has passed since the timer started.
      * @return True if enough time has passed, False otherwise.
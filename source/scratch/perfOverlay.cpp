@@ -0,0 +1,257 @@
+#include "perfOverlay.hpp"
+#include "assetCache.hpp"
+#include "blockExecutor.hpp"
+#include "interpret.hpp"
+#include "os.hpp"
+#include "render.hpp"
+#include "sprite.hpp"
+#include "text.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+bool PerfOverlay::enabled = false;
+int PerfOverlay::benchmarkTicks = 0;
+
+namespace {
+
+// how many frames the average and p99 are taken over
+const size_t historySize = 256;
+// frame time histogram, 1 ms per bucket with everything past the end in the last one
+const size_t histogramBuckets = 100;
+// rebuilding the text every frame is expensive, especially on 3DS
+const int refreshInterval = 10;
+
+Timer frameTimer;
+long long frameStart = 0;
+long long logicEnd = 0;
+
+long long frameHistory[historySize] = {0};
+size_t historyIndex = 0;
+size_t historyCount = 0;
+uint32_t histogram[histogramBuckets] = {0};
+long long historyTotal = 0;
+
+long long lastFrameTime = 0;
+long long lastLogicTime = 0;
+long long lastRenderTime = 0;
+size_t lastBlocksRun = 0;
+size_t drawCalls = 0;
+size_t lastDrawCalls = 0;
+
+uint64_t imageHits = 0;
+uint64_t imageMisses = 0;
+
+int framesUntilRefresh = 0;
+TextObject *statsText = nullptr;
+
+// totals over every frame measured for `benchmarkTicks`, rather than the last `historySize`
+int benchmarkFrames = 0;
+long long benchmarkFrameTime = 0;
+long long benchmarkLogicTime = 0;
+long long benchmarkRenderTime = 0;
+long long benchmarkLongestFrame = 0;
+uint64_t benchmarkDrawCalls = 0;
+uint64_t benchmarkBlocks = 0;
+uint32_t benchmarkHistogram[histogramBuckets] = {0};
+
+bool isMeasuring() {
+    return PerfOverlay::enabled || PerfOverlay::benchmarkTicks > 0;
+}
+
+size_t bucketFor(long long timeUs) {
+    return std::min(static_cast<size_t>(timeUs / 1000), histogramBuckets - 1);
+}
+
+void addFrameTime(long long timeUs) {
+    if (historyCount == historySize) {
+        long long oldest = frameHistory[historyIndex];
+        histogram[bucketFor(oldest)]--;
+        historyTotal -= oldest;
+    } else {
+        historyCount++;
+    }
+    frameHistory[historyIndex] = timeUs;
+    histogram[bucketFor(timeUs)]++;
+    historyTotal += timeUs;
+    historyIndex = (historyIndex + 1) % historySize;
+}
+
+// upper edge of the histogram bucket holding the 99th percentile, in ms
+int getP99(const uint32_t *buckets, size_t count) {
+    if (count == 0) return 0;
+    size_t remaining = count / 100 + 1;
+    for (size_t i = histogramBuckets; i-- > 0;) {
+        if (buckets[i] >= remaining) return static_cast<int>(i + 1);
+        remaining -= buckets[i];
+    }
+    return 1;
+}
+
+std::string formatMs(long long timeUs) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f", timeUs / 1000.0);
+    return buffer;
+}
+
+std::string formatMB(size_t bytes) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f", bytes / (1024.0 * 1024.0));
+    return buffer;
+}
+
+std::string buildStatsText() {
+    size_t threads = 0;
+    size_t clones = 0;
+    for (Sprite *sprite : sprites) {
+        if (sprite->isClone) clones++;
+        for (auto &[id, chain] : sprite->blockChains) {
+            if (!chain.blocksToRepeat.empty()) threads++;
+        }
+    }
+
+    const long long average = historyCount > 0 ? historyTotal / static_cast<long long>(historyCount) : 0;
+    const uint64_t lookups = imageHits + imageMisses;
+    const int hitRate = lookups > 0 ? static_cast<int>(imageHits * 100 / lookups) : 100;
+
+    std::string text;
+    text += "frame " + formatMs(lastFrameTime) + " ms  avg " + formatMs(average) + "  p99 <" + std::to_string(getP99(histogram, historyCount)) + " ms\n";
+    text += "logic " + formatMs(lastLogicTime) + " ms  render " + formatMs(lastRenderTime) + " ms  draws " + std::to_string(lastDrawCalls) + "\n";
+    text += "blocks " + std::to_string(lastBlocksRun) + "  threads " + std::to_string(threads) + "  clones " + std::to_string(clones) + "\n";
+    text += "images " + std::to_string(hitRate) + "% hit (" + std::to_string(imageMisses) + " misses)\n";
+    text += "assets " + formatMB(AssetCache::getUsage()) + "/" + formatMB(AssetCache::getBudget()) + " MB  " + std::to_string(AssetCache::getStats().evictions) + " evicted\n";
+    text += "RAM " + formatMB(MemoryTracker::getCurrentUsage()) + "/" + formatMB(MemoryTracker::getMaxRamUsage()) + " MB";
+    text += "  VRAM " + formatMB(MemoryTracker::getVRAMUsage()) + "/" + formatMB(MemoryTracker::getMaxVRAMUsage()) + " MB";
+    return text;
+}
+
+void logBenchmark() {
+    const long long frames = benchmarkFrames;
+    char buffer[128];
+    Log::log("Benchmark finished after " + std::to_string(frames) + " frames");
+    snprintf(buffer, sizeof(buffer), "frame time: %.3f ms avg, p99 <%d ms, %.3f ms longest",
+             benchmarkFrameTime / 1000.0 / frames, getP99(benchmarkHistogram, benchmarkFrames), benchmarkLongestFrame / 1000.0);
+    Log::log(buffer);
+    snprintf(buffer, sizeof(buffer), "logic: %.3f ms avg, render: %.3f ms avg",
+             benchmarkLogicTime / 1000.0 / frames, benchmarkRenderTime / 1000.0 / frames);
+    Log::log(buffer);
+    snprintf(buffer, sizeof(buffer), "draw calls/frame: %.1f", static_cast<double>(benchmarkDrawCalls) / frames);
+    Log::log(buffer);
+    snprintf(buffer, sizeof(buffer), "blocks/frame: %.1f", static_cast<double>(benchmarkBlocks) / frames);
+    Log::log(buffer);
+}
+
+void addBenchmarkFrame() {
+    if (benchmarkFrames >= PerfOverlay::benchmarkTicks) return;
+    benchmarkFrames++;
+    benchmarkFrameTime += lastFrameTime;
+    benchmarkLogicTime += lastLogicTime;
+    benchmarkRenderTime += lastRenderTime;
+    benchmarkLongestFrame = std::max(benchmarkLongestFrame, lastFrameTime);
+    benchmarkDrawCalls += lastDrawCalls;
+    benchmarkBlocks += lastBlocksRun;
+    benchmarkHistogram[bucketFor(lastFrameTime)]++;
+
+    // stops the same way a finished input replay does
+    if (benchmarkFrames == PerfOverlay::benchmarkTicks) {
+        logBenchmark();
+        Scratch::shouldStop = true;
+    }
+}
+
+} // namespace
+
+void PerfOverlay::toggle() {
+    if (!Render::debugMode) return;
+    enabled = !enabled;
+    framesUntilRefresh = 0;
+    Log::log(std::string("Performance overlay ") + (enabled ? "enabled" : "disabled"));
+}
+
+void PerfOverlay::beginFrame() {
+    if (!isMeasuring()) return;
+    frameStart = frameTimer.getTimeUs();
+}
+
+void PerfOverlay::logicFinished() {
+    if (!isMeasuring()) return;
+    logicEnd = frameTimer.getTimeUs();
+    lastLogicTime = logicEnd - frameStart;
+    lastBlocksRun = blocksRun;
+}
+
+void PerfOverlay::endFrame() {
+    if (!isMeasuring()) return;
+    const long long frameEnd = frameTimer.getTimeUs();
+    lastRenderTime = frameEnd - logicEnd;
+    lastFrameTime = frameEnd - frameStart;
+    addFrameTime(lastFrameTime);
+    lastDrawCalls = drawCalls;
+    drawCalls = 0;
+    if (benchmarkTicks > 0) addBenchmarkFrame();
+}
+
+void PerfOverlay::countImageLookup(bool hit) {
+    if (!enabled) return;
+    if (hit) imageHits++;
+    else imageMisses++;
+}
+
+void PerfOverlay::countDrawCall() {
+    if (!isMeasuring()) return;
+    drawCalls++;
+}
+
+void PerfOverlay::render() {
+    if (!enabled) return;
+
+    if (framesUntilRefresh-- <= 0) {
+        framesUntilRefresh = refreshInterval;
+        if (statsText == nullptr) {
+            statsText = createTextObject(buildStatsText(), 0, 0);
+            statsText->setCenterAligned(false);
+            statsText->setColor(0xFFFFFFFF);
+            statsText->setScale(0.5f);
+        } else {
+            statsText->setText(buildStatsText());
+        }
+    }
+
+    const std::vector<float> size = statsText->getSize();
+    const int padding = 4;
+    const int boxWidth = static_cast<int>(size[0]) + padding * 2;
+    const int boxHeight = static_cast<int>(size[1]) + padding * 2;
+    Render::drawBox(boxWidth, boxHeight, boxWidth / 2, boxHeight / 2, 0, 0, 0, 160);
+
+#ifdef __3DS__
+    // 3DS text is positioned by its vertical center
+    statsText->render(padding, padding + static_cast<int>(size[1] / 2));
+#else
+    statsText->render(padding, padding);
+#endif
+}
+
+void PerfOverlay::cleanup() {
+    if (statsText != nullptr) {
+        delete statsText;
+        statsText = nullptr;
+    }
+    frameStart = 0;
+    logicEnd = 0;
+    historyIndex = 0;
+    historyCount = 0;
+    historyTotal = 0;
+    std::fill(std::begin(histogram), std::end(histogram), 0);
+    imageHits = 0;
+    imageMisses = 0;
+    drawCalls = 0;
+    lastDrawCalls = 0;
+    benchmarkFrames = 0;
+    benchmarkFrameTime = 0;
+    benchmarkLogicTime = 0;
+    benchmarkRenderTime = 0;
+    benchmarkLongestFrame = 0;
+    benchmarkDrawCalls = 0;
+    benchmarkBlocks = 0;
+    std::fill(std::begin(benchmarkHistogram), std::end(benchmarkHistogram), 0);
+}
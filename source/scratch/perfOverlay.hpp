@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * On-screen performance overlay, only available while `Render::debugMode` is on.
+ * Toggled at runtime with F3 (SDL platforms) or SELECT + START (3DS).
+ */
+class PerfOverlay {
+  public:
+    static bool enabled;
+
+    /**
+     * Frames to measure before logging a benchmark report and stopping the project, or 0 to not benchmark.
+     * Set from `"BenchmarkTicks"` in `Settings.json`, and works whether the overlay is shown or not.
+     */
+    static int benchmarkTicks;
+
+    /**
+     * Shows or hides the overlay. Does nothing outside of debug mode.
+     */
+    static void toggle();
+
+    /**
+     * Marks the start of a frame, before input and script logic run.
+     */
+    static void beginFrame();
+
+    /**
+     * Marks the end of script logic and the start of rendering.
+     */
+    static void logicFinished();
+
+    /**
+     * Marks the end of a frame, after everything has been presented.
+     */
+    static void endFrame();
+
+    /**
+     * Records an image lookup made by the renderer.
+     * @param hit whether the image was already loaded
+     */
+    static void countImageLookup(bool hit);
+
+    /**
+     * Records a draw call made by the renderer while drawing sprites.
+     */
+    static void countDrawCall();
+
+    /**
+     * Draws the overlay to the current render target. Called by the renderer before presenting.
+     */
+    static void render();
+
+    /**
+     * Frees the overlay's text and resets every statistic.
+     */
+    static void cleanup();
+};
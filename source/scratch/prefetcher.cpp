@@ -0,0 +1,81 @@
+#include "prefetcher.hpp"
+#include "imageLoader.hpp"
+#include "interpret.hpp"
+#include "sprite.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// costume files each script switches to by name, only for scripts that switch to any
+std::unordered_map<std::string, std::vector<std::string>> scriptCostumes;
+
+/**
+ * Gets the costume file a `switch costume to` or `switch backdrop to` block names in its menu.
+ * @param block
+ * @param inputName `COSTUME` or `BACKDROP`
+ * @param owner the sprite the costume belongs to
+ * @return The costume's file name, or an empty string if the block doesn't name one of `owner`'s costumes.
+ */
+std::string getNamedCostume(Block &block, const std::string &inputName, const Sprite *owner) {
+    auto inputFind = block.parsedInputs->find(inputName);
+    if (inputFind == block.parsedInputs->end() || inputFind->second.inputType != ParsedInput::LITERAL) return "";
+    Block *menuBlock = findBlock(inputFind->second.literalValue.asString());
+    if (menuBlock == nullptr) return "";
+
+    const std::string costumeName = Scratch::getFieldValue(*menuBlock, inputName);
+    for (const Costume &costume : owner->costumes) {
+        if (costume.name == costumeName) return costume.fullName;
+    }
+    return "";
+}
+
+} // namespace
+
+void Prefetcher::indexScripts() {
+    scriptCostumes.clear();
+    const Sprite *stage = nullptr;
+    for (const Sprite *sprite : sprites) {
+        if (sprite->isStage) stage = sprite;
+    }
+
+    for (Sprite *sprite : sprites) {
+        for (auto &[id, chain] : sprite->blockChains) {
+            std::vector<std::string> costumeFiles;
+            for (Block *block : chain.blockChain) {
+                std::string costumeFile;
+                if (block->opcode == "looks_switchcostumeto") {
+                    costumeFile = getNamedCostume(*block, "COSTUME", sprite);
+                } else if (block->opcode == "looks_switchbackdropto" && stage != nullptr) {
+                    costumeFile = getNamedCostume(*block, "BACKDROP", stage);
+                }
+                if (!costumeFile.empty() && std::find(costumeFiles.begin(), costumeFiles.end(), costumeFile) == costumeFiles.end()) {
+                    costumeFiles.push_back(costumeFile);
+                }
+            }
+            if (!costumeFiles.empty()) scriptCostumes[id] = std::move(costumeFiles);
+        }
+    }
+}
+
+void Prefetcher::prefetchNextCostumes(Sprite *sprite) {
+    const int costumeCount = static_cast<int>(sprite->costumes.size());
+    const int ahead = std::min(COSTUMES_AHEAD, costumeCount - 1);
+    for (int i = 1; i <= ahead; i++) {
+        ImageLoader::prefetch(sprite->costumes[(sprite->currentCostume + i) % costumeCount].fullName);
+    }
+}
+
+void Prefetcher::scriptRunning(const std::string &blockChainID) {
+    if (scriptCostumes.empty()) return;
+    auto scriptFind = scriptCostumes.find(blockChainID);
+    if (scriptFind == scriptCostumes.end()) return;
+    for (const std::string &costumeFile : scriptFind->second) {
+        ImageLoader::prefetch(costumeFile);
+    }
+}
+
+void Prefetcher::clear() {
+    scriptCostumes.clear();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+
+class Sprite;
+
+/**
+ * Guesses which costumes will be needed soon, and has `ImageLoader` load them before they get switched to.
+ * Animations mostly step through a sprite's costumes in order, and scripts switch to the costumes they name,
+ * so the costumes after a sprite's current one, and the ones named by a running script, get prefetched.
+ */
+class Prefetcher {
+  public:
+    /**
+     * How many costumes after a sprite's current one get prefetched.
+     */
+    static constexpr int COSTUMES_AHEAD = 2;
+
+    /**
+     * Finds the costumes and backdrops every script switches to by name.
+     * Called once a project's block chains have been built.
+     */
+    static void indexScripts();
+
+    /**
+     * Prefetches the costumes after a sprite's current one. Called when a sprite's costume changes,
+     * or when it gets shown.
+     * @param sprite
+     */
+    static void prefetchNextCostumes(Sprite *sprite);
+
+    /**
+     * Prefetches the costumes and backdrops a script switches to by name. Called when a script starts running
+     * across frames.
+     * @param blockChainID the script's `Block::blockChainID`
+     */
+    static void scriptRunning(const std::string &blockChainID);
+
+    /**
+     * Forgets every indexed script. Called when a project gets cleaned up.
+     */
+    static void clear();
+};
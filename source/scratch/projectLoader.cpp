@@ -0,0 +1,656 @@
+#include "projectLoader.hpp"
+#include "interpret.hpp"
+#include "math.hpp"
+#include "nlohmann/json.hpp"
+#include "os.hpp"
+#include "render.hpp"
+#include "sprite.hpp"
+#include "trace.hpp"
+#include "workerPool.hpp"
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef ENABLE_CLOUDVARS
+extern bool cloudProject;
+#endif
+
+namespace {
+
+using json = nlohmann::json;
+
+Sprite *createSprite() {
+    // Sprite *newSprite = MemoryTracker::allocate<Sprite>();
+    Sprite *newSprite = new Sprite();
+    // new (newSprite) Sprite();
+    newSprite->id = Math::generateRandomString(15);
+    newSprite->visible = true;
+    newSprite->size = 100;
+    newSprite->rotation = 90;
+    newSprite->layer = 0;
+    newSprite->toDelete = false;
+    newSprite->isClone = false;
+    return newSprite;
+}
+
+/**
+ * Sets one of the properties a target has directly, like its name or position.
+ * @param sprite
+ * @param key the property's name in the target
+ * @param value
+ */
+void loadTargetProperty(Sprite *sprite, const std::string &key, const json &value) {
+    if (key == "name") {
+        sprite->name = value.get<std::string>();
+    } else if (key == "isStage") {
+        sprite->isStage = value.get<bool>();
+    } else if (key == "draggable") {
+        sprite->draggable = value.get<bool>();
+    } else if (key == "visible") {
+        sprite->visible = value.get<bool>();
+    } else if (key == "currentCostume") {
+        sprite->currentCostume = value.get<int>();
+    } else if (key == "volume") {
+        sprite->volume = value.get<int>();
+    } else if (key == "x") {
+        sprite->xPosition = value.get<int>();
+    } else if (key == "y") {
+        sprite->yPosition = value.get<int>();
+    } else if (key == "size") {
+        sprite->size = value.get<int>();
+    } else if (key == "direction") {
+        sprite->rotation = value.get<int>();
+    } else if (key == "layerOrder") {
+        sprite->layer = value.get<int>();
+    } else if (key == "rotationStyle") {
+        if (value.get<std::string>() == "all around")
+            sprite->rotationStyle = sprite->ALL_AROUND;
+        else if (value.get<std::string>() == "left-right")
+            sprite->rotationStyle = sprite->LEFT_RIGHT;
+        else
+            sprite->rotationStyle = sprite->NONE;
+    }
+}
+
+void loadVariable(Sprite *sprite, const std::string &id, const json &data) {
+    Variable newVariable;
+    newVariable.id = id;
+    newVariable.name = data[0];
+    newVariable.value = Value::fromJson(data[1]);
+#ifdef ENABLE_CLOUDVARS
+    newVariable.cloud = data.size() == 3;
+#endif
+    sprite->variables[newVariable.id] = newVariable; // add variable to sprite
+}
+
+void loadBlock(Sprite *sprite, const std::string &id, const json &data) {
+    Block newBlock;
+    newBlock.id = id;
+    if (data.contains("opcode")) {
+        newBlock.opcode = data["opcode"].get<std::string>();
+    }
+    if (data.contains("next") && !data["next"].is_null()) {
+        newBlock.next = data["next"].get<std::string>();
+    }
+    if (data.contains("parent") && !data["parent"].is_null()) {
+        newBlock.parent = data["parent"].get<std::string>();
+    } else newBlock.parent = "null";
+    if (data.contains("fields")) {
+        for (const auto &[fieldName, fieldData] : data["fields"].items()) {
+            ParsedField parsedField;
+
+            // Fields are almost always arrays with [0] being the value
+            if (fieldData.is_array() && !fieldData.empty()) {
+                parsedField.value = fieldData[0].get<std::string>();
+
+                // Store ID for variables and lists
+                if (fieldData.size() > 1 && !fieldData[1].is_null()) {
+                    parsedField.id = fieldData[1].get<std::string>();
+                }
+            }
+
+            (*newBlock.parsedFields)[fieldName] = parsedField;
+        }
+    }
+    if (data.contains("inputs")) {
+
+        for (const auto &[inputName, inputData] : data["inputs"].items()) {
+            ParsedInput parsedInput;
+
+            int type = inputData[0];
+            auto &inputValue = inputData[1];
+
+            if (type == 1) {
+                parsedInput.inputType = ParsedInput::LITERAL;
+                parsedInput.literalValue = Value::fromJson(inputValue);
+
+            } else if (type == 3) {
+                if (inputValue.is_array()) {
+                    parsedInput.inputType = ParsedInput::VARIABLE;
+                    parsedInput.variableId = inputValue[2].get<std::string>();
+                } else {
+                    parsedInput.inputType = ParsedInput::BLOCK;
+                    if (!inputValue.is_null())
+                        parsedInput.blockId = inputValue.get<std::string>();
+                }
+            } else if (type == 2) {
+                parsedInput.inputType = ParsedInput::BOOLEAN;
+                parsedInput.blockId = inputValue.get<std::string>();
+            }
+            (*newBlock.parsedInputs)[inputName] = parsedInput;
+        }
+    }
+    if (data.contains("topLevel")) {
+        newBlock.topLevel = data["topLevel"].get<bool>();
+    }
+    if (data.contains("shadow")) {
+        newBlock.shadow = data["shadow"].get<bool>();
+    }
+    if (data.contains("mutation")) {
+        if (data["mutation"].contains("proccode")) {
+            newBlock.customBlockId = data["mutation"]["proccode"].get<std::string>();
+        } else {
+            newBlock.customBlockId = "";
+        }
+    }
+    sprite->blocks[newBlock.id] = newBlock; // add block
+
+    // add custom function blocks
+    if (newBlock.opcode == "procedures_prototype") {
+        if (!data.is_array()) {
+            CustomBlock newCustomBlock;
+            newCustomBlock.name = data["mutation"]["proccode"];
+            newCustomBlock.blockId = newBlock.id;
+
+            // custom blocks uses a different json structure for some reason?? have to parse them.
+            std::string rawArgumentNames = data["mutation"]["argumentnames"];
+            json parsedAN = json::parse(rawArgumentNames);
+            newCustomBlock.argumentNames = parsedAN.get<std::vector<std::string>>();
+
+            std::string rawArgumentDefaults = data["mutation"]["argumentdefaults"];
+            json parsedAD = json::parse(rawArgumentDefaults);
+            // newCustomBlock.argumentDefaults = parsedAD.get<std::vector<std::string>>();
+
+            for (const auto &item : parsedAD) {
+                if (item.is_string()) {
+                    newCustomBlock.argumentDefaults.push_back(item.get<std::string>());
+                } else if (item.is_number_integer()) {
+                    newCustomBlock.argumentDefaults.push_back(std::to_string(item.get<int>()));
+                } else if (item.is_number_float()) {
+                    newCustomBlock.argumentDefaults.push_back(std::to_string(item.get<double>()));
+                } else {
+                    newCustomBlock.argumentDefaults.push_back(item.dump());
+                }
+            }
+
+            std::string rawArgumentIds = data["mutation"]["argumentids"];
+            json parsedAID = json::parse(rawArgumentIds);
+            newCustomBlock.argumentIds = parsedAID.get<std::vector<std::string>>();
+
+            if (data["mutation"]["warp"] == "true") {
+                newCustomBlock.runWithoutScreenRefresh = true;
+            } else newCustomBlock.runWithoutScreenRefresh = false;
+
+            sprite->customBlocks[newCustomBlock.name] = newCustomBlock; // add custom block
+        } else {
+            Log::logError("Unknown Custom block data: " + data.dump()); // TODO handle these
+        }
+    }
+}
+
+void loadList(Sprite *sprite, const std::string &id, const json &data) {
+    List newList;
+    newList.id = id;
+    newList.name = data[0];
+    for (const auto &listItem : data[1]) {
+        newList.items.push_back(Value::fromJson(listItem));
+    }
+    sprite->lists[newList.id] = newList; // add list
+}
+
+void loadSound(Sprite *sprite, const json &data) {
+    Sound newSound;
+    newSound.id = data["assetId"];
+    newSound.name = data["name"];
+    newSound.fullName = data["md5ext"];
+    newSound.dataFormat = data["dataFormat"];
+    newSound.sampleRate = data["rate"];
+    newSound.sampleCount = data["sampleCount"];
+    sprite->sounds[newSound.name] = newSound;
+}
+
+void loadCostume(Sprite *sprite, const json &data) {
+    Costume newCostume;
+    newCostume.id = data["assetId"];
+    if (data.contains("name")) {
+        newCostume.name = data["name"];
+    }
+    if (data.contains("bitmapResolution")) {
+        newCostume.bitmapResolution = data["bitmapResolution"];
+    }
+    if (data.contains("dataFormat")) {
+        newCostume.dataFormat = data["dataFormat"];
+        if (newCostume.dataFormat == "svg" || newCostume.dataFormat == "SVG")
+            newCostume.isSVG = true;
+        else
+            newCostume.isSVG = false;
+    }
+    if (data.contains("md5ext")) {
+        newCostume.fullName = data["md5ext"];
+    }
+    if (data.contains("rotationCenterX")) {
+        newCostume.rotationCenterX = data["rotationCenterX"];
+    }
+    if (data.contains("rotationCenterY")) {
+        newCostume.rotationCenterY = data["rotationCenterY"];
+    }
+    sprite->costumes.push_back(newCostume);
+}
+
+void loadComment(Sprite *sprite, const std::string &id, const json &data) {
+    Comment newComment;
+    newComment.id = id;
+    if (data.contains("blockId") && !data["blockId"].is_null()) {
+        newComment.blockId = data["blockId"];
+    }
+    newComment.width = data["width"];
+    newComment.height = data["height"];
+    newComment.minimized = data["minimized"];
+    newComment.x = data["x"];
+    newComment.y = data["y"];
+    newComment.text = data["text"];
+    sprite->comments[newComment.id] = newComment;
+}
+
+void loadBroadcast(Sprite *sprite, const std::string &id, const json &data) {
+    Broadcast newBroadcast;
+    newBroadcast.id = id;
+    newBroadcast.name = data;
+    sprite->broadcasts[newBroadcast.id] = newBroadcast;
+    // std::cout<<"broadcast name = "<< newBroadcast.name << std::endl;
+}
+
+/**
+ * Loads one item from one of a target's lists of things, like a block or a costume.
+ * @param sprite
+ * @param section the name of the list in the target, like `blocks`
+ * @param id the item's id, for the lists keyed by id
+ * @param data
+ */
+void loadTargetItem(Sprite *sprite, const std::string &section, const std::string &id, const json &data) {
+    if (section == "blocks") loadBlock(sprite, id, data);
+    else if (section == "variables") loadVariable(sprite, id, data);
+    else if (section == "lists") loadList(sprite, id, data);
+    else if (section == "costumes") loadCostume(sprite, data);
+    else if (section == "sounds") loadSound(sprite, data);
+    else if (section == "comments") loadComment(sprite, id, data);
+    else if (section == "broadcasts") loadBroadcast(sprite, id, data);
+}
+
+bool isTargetItemList(const std::string &key) {
+    return key == "blocks" || key == "variables" || key == "lists" || key == "costumes" ||
+           key == "sounds" || key == "comments" || key == "broadcasts";
+}
+
+void loadMonitor(const json &monitor) {
+    Monitor newMonitor;
+
+    if (monitor.contains("id") && !monitor["id"].is_null())
+        newMonitor.id = monitor.at("id").get<std::string>();
+
+    if (monitor.contains("mode") && !monitor["mode"].is_null())
+        newMonitor.mode = monitor.at("mode").get<std::string>();
+
+    if (monitor.contains("opcode") && !monitor["opcode"].is_null())
+        newMonitor.opcode = monitor.at("opcode").get<std::string>();
+
+    if (monitor.contains("params") && monitor["params"].is_object()) {
+        for (const auto &param : monitor["params"].items()) {
+            std::string key = param.key();
+            std::string value = param.value().dump();
+            newMonitor.parameters[key] = value;
+        }
+    }
+
+    if (monitor.contains("spriteName") && !monitor["spriteName"].is_null())
+        newMonitor.spriteName = monitor.at("spriteName").get<std::string>();
+    else
+        newMonitor.spriteName = "";
+
+    if (monitor.contains("value") && !monitor["value"].is_null())
+        newMonitor.value = Value(Math::removeQuotations(monitor.at("value").dump()));
+
+    if (monitor.contains("x") && !monitor["x"].is_null())
+        newMonitor.x = monitor.at("x").get<int>();
+
+    if (monitor.contains("y") && !monitor["y"].is_null())
+        newMonitor.y = monitor.at("y").get<int>();
+
+    if (monitor.contains("visible") && !monitor["visible"].is_null())
+        newMonitor.visible = monitor.at("visible").get<bool>();
+
+    if (monitor.contains("isDiscrete") && !monitor["isDiscrete"].is_null())
+        newMonitor.isDiscrete = monitor.at("isDiscrete").get<bool>();
+
+    if (monitor.contains("sliderMin") && !monitor["sliderMin"].is_null())
+        newMonitor.sliderMin = monitor.at("sliderMin").get<double>();
+
+    if (monitor.contains("sliderMax") && !monitor["sliderMax"].is_null())
+        newMonitor.sliderMax = monitor.at("sliderMax").get<double>();
+
+    Render::visibleVariables.push_back(newMonitor);
+}
+
+/**
+ * Puts a map's items back in the order of their ids, the order they were added in back when the whole
+ * project.json was parsed first. Things like which hat block starts first follow the maps' order,
+ * so this keeps projects running exactly the same as they used to.
+ * @param map
+ */
+template <typename Map>
+void restoreIdOrder(Map &map) {
+    std::vector<typename Map::node_type> nodes;
+    nodes.reserve(map.size());
+    while (!map.empty()) {
+        nodes.push_back(map.extract(map.begin()));
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const auto &a, const auto &b) { return a.key() < b.key(); });
+    Map sorted;
+    for (auto &node : nodes) {
+        sorted.insert(std::move(node));
+    }
+    map.swap(sorted);
+}
+
+/**
+ * Finishes a sprite once all of its items are in it.
+ * @param sprite
+ */
+void finishSprite(Sprite *sprite) {
+    restoreIdOrder(sprite->variables);
+    restoreIdOrder(sprite->blocks);
+    restoreIdOrder(sprite->lists);
+    restoreIdOrder(sprite->comments);
+    restoreIdOrder(sprite->broadcasts);
+#ifdef ENABLE_CLOUDVARS
+    for (const auto &[id, variable] : sprite->variables) {
+        cloudProject = cloudProject || variable.cloud;
+    }
+#endif
+}
+
+template <typename Map>
+void moveItems(Map &from, Map &to) {
+    for (auto &[key, value] : from) {
+        to[key] = std::move(value);
+    }
+}
+
+// how many of a target's items one worker job loads
+const size_t ITEMS_PER_JOB = 512;
+
+struct TargetItem {
+    std::string section;
+    std::string id;
+    json data;
+};
+
+/**
+ * Some of a target's items, loaded on a worker thread into a sprite of their own.
+ */
+struct TargetPart {
+    Sprite items;
+    std::string error; // what went wrong loading them, if anything
+};
+
+/**
+ * A target whose items are being loaded on worker threads. Once they're all done,
+ * its parts get moved into its sprite in the order they were read.
+ */
+struct LoadingTarget {
+    Sprite *sprite;
+    std::vector<std::unique_ptr<TargetPart>> parts;
+};
+
+/**
+ * Gets called by the parser for every part of the project.json as it reads it. Targets become sprites as soon as
+ * they start, and every block, variable, costume and so on of them is built up as a small `nlohmann::json`,
+ * loaded into the sprite and thrown away, same as every monitor.
+ * When there are worker threads, a target's items get handed to them in batches instead, and
+ * `finish()` puts the results together once the whole file has been read.
+ */
+class ProjectHandler : public nlohmann::json_sax<json> {
+  public:
+    bool null() override { return addValue(nullptr); }
+    bool boolean(bool val) override { return addValue(val); }
+    bool number_integer(number_integer_t val) override { return addValue(val); }
+    bool number_unsigned(number_unsigned_t val) override { return addValue(val); }
+    bool number_float(number_float_t val, const string_t &) override { return addValue(val); }
+    bool string(string_t &val) override { return addValue(std::move(val)); }
+    bool binary(binary_t &val) override { return addValue(json::binary(std::move(val))); }
+    bool start_object(std::size_t) override { return open(json::object()); }
+    bool start_array(std::size_t) override { return open(json::array()); }
+    bool end_object() override { return close(); }
+    bool end_array() override { return close(); }
+
+    bool key(string_t &val) override {
+        if (!building.empty()) buildingKey = std::move(val);
+        else lastKey = std::move(val);
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &ex) override {
+        Log::logError("Failed to parse project.json at byte " + std::to_string(position) + ": " + ex.what());
+        return false;
+    }
+
+    ~ProjectHandler() override {
+        // jobs for a project that failed to load could still be writing into its parts
+        if (!loadingTargets.empty()) WorkerPool::waitIdle();
+        delete sprite; // only set if parsing stopped partway through a target
+    }
+
+    /**
+     * Waits for the target items being loaded on worker threads, and moves them into their sprites.
+     * @return `false` if any of them couldn't be loaded.
+     */
+    bool finish() {
+        if (loadingTargets.empty()) return true;
+        WorkerPool::waitIdle();
+
+        for (LoadingTarget &target : loadingTargets) {
+            for (std::unique_ptr<TargetPart> &part : target.parts) {
+                if (!part->error.empty()) {
+                    Log::logError("Failed to load project.json: " + part->error);
+                    return false;
+                }
+                Sprite &items = part->items;
+                moveItems(items.variables, target.sprite->variables);
+                moveItems(items.blocks, target.sprite->blocks);
+                moveItems(items.lists, target.sprite->lists);
+                moveItems(items.comments, target.sprite->comments);
+                moveItems(items.broadcasts, target.sprite->broadcasts);
+                moveItems(items.customBlocks, target.sprite->customBlocks);
+                moveItems(items.sounds, target.sprite->sounds);
+                std::move(items.costumes.begin(), items.costumes.end(), std::back_inserter(target.sprite->costumes));
+                part.reset();
+            }
+            finishSprite(target.sprite);
+        }
+        loadingTargets.clear();
+        return true;
+    }
+
+    bool sawTargets = false;
+
+  private:
+    // what each container outside of the item being built is
+    enum class Section {
+        ROOT,
+        TARGETS,
+        TARGET,
+        TARGET_ITEMS,
+        MONITORS,
+        IGNORED
+    };
+
+    std::vector<Section> sections;
+    std::string lastKey; // the last key read outside of the item being built
+    Sprite *sprite = nullptr;
+    std::string itemSection; // which of the target's lists the items being read are in
+    std::string itemId;
+
+    const bool loadOnWorkers = WorkerPool::getThreadCount() > 0;
+    std::vector<TargetItem> batch; // items of `sprite` not handed to a worker yet
+    std::vector<LoadingTarget> loadingTargets;
+
+    json item;                    // the block, variable, costume or monitor being built
+    std::vector<json *> building; // containers in `item` that are still open
+    std::string buildingKey;      // the last key read inside `item`
+
+    /**
+     * Adds a value to the container being built.
+     * @return The value in its place.
+     */
+    json &addToItem(json &&value) {
+        json &container = *building.back();
+        if (container.is_object()) {
+            json &added = container[buildingKey];
+            added = std::move(value);
+            return added;
+        }
+        container.push_back(std::move(value));
+        return container.back();
+    }
+
+    /**
+     * Loads an item once all of it has been read.
+     */
+    void loadItem(json &&data) {
+        Section section = sections.back();
+        if (section == Section::TARGET) {
+            loadTargetProperty(sprite, lastKey, data);
+        } else if (section == Section::TARGET_ITEMS) {
+            if (!loadOnWorkers) {
+                loadTargetItem(sprite, itemSection, lastKey, data);
+                return;
+            }
+            batch.push_back({itemSection, lastKey, std::move(data)});
+            if (batch.size() >= ITEMS_PER_JOB) submitBatch();
+        } else if (section == Section::MONITORS) {
+            loadMonitor(data);
+        }
+    }
+
+    /**
+     * Hands the batched items of the current target to a worker thread.
+     */
+    void submitBatch() {
+        if (batch.empty()) return;
+        loadingTargets.back().parts.push_back(std::make_unique<TargetPart>());
+        TargetPart *part = loadingTargets.back().parts.back().get();
+        WorkerPool::submit([part, items = std::move(batch)]() {
+            try {
+                for (const TargetItem &item : items) {
+                    loadTargetItem(&part->items, item.section, item.id, item.data);
+                }
+            } catch (const nlohmann::json::exception &e) {
+                part->error = e.what();
+            }
+        });
+        batch.clear();
+
+        // don't read too far ahead of the workers, or the whole file ends up waiting in batches
+        if (WorkerPool::getPendingJobs() > WorkerPool::getThreadCount() * 2) WorkerPool::waitIdle();
+    }
+
+    bool wantsItems() const {
+        Section section = sections.back();
+        return section == Section::TARGET_ITEMS || section == Section::MONITORS;
+    }
+
+    bool addValue(json &&value) {
+        if (!building.empty()) {
+            addToItem(std::move(value));
+        } else if (!sections.empty()) {
+            loadItem(std::move(value));
+        }
+        return true;
+    }
+
+    bool open(json &&container) {
+        if (!building.empty()) {
+            building.push_back(&addToItem(std::move(container)));
+            return true;
+        }
+        if (sections.empty()) {
+            sections.push_back(Section::ROOT);
+            return true;
+        }
+        if (wantsItems()) {
+            item = std::move(container);
+            building.push_back(&item);
+            return true;
+        }
+
+        Section section = sections.back();
+        Section opened = Section::IGNORED;
+        if (section == Section::ROOT && container.is_array()) {
+            if (lastKey == "targets") {
+                opened = Section::TARGETS;
+                sawTargets = true;
+            } else if (lastKey == "monitors") {
+                opened = Section::MONITORS;
+            }
+        } else if (section == Section::TARGETS && container.is_object()) {
+            sprite = createSprite();
+            if (loadOnWorkers) loadingTargets.push_back({sprite, {}});
+            opened = Section::TARGET;
+        } else if (section == Section::TARGET && isTargetItemList(lastKey)) {
+            itemSection = lastKey;
+            opened = Section::TARGET_ITEMS;
+        }
+        sections.push_back(opened);
+        return true;
+    }
+
+    bool close() {
+        if (!building.empty()) {
+            building.pop_back();
+            if (building.empty()) {
+                loadItem(std::move(item));
+                item = nullptr;
+            }
+            return true;
+        }
+        if (sections.back() == Section::TARGET) {
+            if (loadOnWorkers) submitBatch();
+            else finishSprite(sprite);
+            sprites.push_back(sprite);
+            sprite = nullptr;
+        }
+        sections.pop_back();
+        return true;
+    }
+};
+
+} // namespace
+
+bool ProjectLoader::load(const char *json, size_t size) {
+    TRACE_SCOPE("load project.json", "load");
+    Log::log("beginning to load sprites...");
+    sprites.reserve(400);
+
+    ProjectHandler handler;
+    try {
+        if (!nlohmann::json::sax_parse(json, json + size, &handler)) return false;
+        if (!handler.finish()) return false;
+    } catch (const nlohmann::json::exception &e) {
+        Log::logError(std::string("Failed to load project.json: ") + e.what());
+        return false;
+    }
+    return handler.sawTargets;
+}
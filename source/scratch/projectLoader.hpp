@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+
+/**
+ * Loads the sprites and monitors from a project.json while it's being parsed, instead of parsing the whole file
+ * into a `nlohmann::json` first. Only one block, variable, costume or monitor is ever held as JSON at a time,
+ * so loading a big project takes about as much memory as the file itself, not several times that.
+ * With worker threads, a target's items are held in small batches instead, and loaded on the workers while
+ * the parser keeps reading. They're put together in file order, so sprites end up the same either way.
+ */
+class ProjectLoader {
+  public:
+    /**
+     * Loads every sprite into `sprites` and every monitor into `Render::visibleVariables`.
+     * `finishLoadingSprites()` has to be called afterwards to set them up.
+     * @param json the project.json file
+     * @param size size of `json` in bytes
+     * @return `false` if the file isn't valid JSON, or isn't a project.
+     */
+    static bool load(const char *json, size_t size);
+};
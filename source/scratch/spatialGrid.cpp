@@ -0,0 +1,221 @@
+#include "spatialGrid.hpp"
+#include "interpret.hpp"
+#include "sprite.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+namespace {
+
+struct Entry {
+    Sprite *sprite = nullptr;
+    std::string group; // name the sprite is filed under, which is only updated when it gets filed again
+    int minCellX = 0;
+    int minCellY = 0;
+    int maxCellX = -1;
+    int maxCellY = -1;
+    bool inGrid = false; // filed under `group`, in its cells or in the large list
+    bool large = false;  // in the large list instead of cells
+    bool dirty = false;  // waiting in `dirtySprites`
+    unsigned int queryStamp = 0;
+};
+
+struct Group {
+    std::unordered_map<int64_t, std::vector<Entry *>> cells;
+    std::vector<Entry *> large;
+};
+
+bool active = false;
+std::unordered_map<Sprite *, Entry> entries;
+std::unordered_map<std::string, Group> groups;
+std::vector<Sprite *> dirtySprites;
+std::vector<Sprite *> nearby;
+unsigned int queryStamp = 0;
+
+int64_t cellKey(int x, int y) {
+    return (static_cast<int64_t>(x) << 32) ^ static_cast<uint32_t>(y);
+}
+
+/**
+ * Gets the cells a bounding box covers.
+ * @return `false` if it covers too many cells to list them (or isn't a real box, like with NaN positions).
+ */
+bool getCellRange(const CollisionBounds &bounds, int &minX, int &minY, int &maxX, int &maxY) {
+    // far enough out that cell numbers can't overflow, and not NaN
+    const double limit = SpatialGrid::CELL_SIZE * 1e6;
+    if (!(bounds.minX >= -limit && bounds.minY >= -limit && bounds.maxX <= limit && bounds.maxY <= limit)) return false;
+
+    minX = static_cast<int>(std::floor(bounds.minX / SpatialGrid::CELL_SIZE));
+    minY = static_cast<int>(std::floor(bounds.minY / SpatialGrid::CELL_SIZE));
+    maxX = static_cast<int>(std::floor(bounds.maxX / SpatialGrid::CELL_SIZE));
+    maxY = static_cast<int>(std::floor(bounds.maxY / SpatialGrid::CELL_SIZE));
+    return static_cast<int64_t>(maxX - minX + 1) * (maxY - minY + 1) <= SpatialGrid::MAX_CELLS_PER_SPRITE;
+}
+
+void eraseEntry(std::vector<Entry *> &list, Entry *entry) {
+    auto found = std::find(list.begin(), list.end(), entry);
+    if (found == list.end()) return;
+    *found = list.back();
+    list.pop_back();
+}
+
+void removeFromGrid(Entry &entry) {
+    if (!entry.inGrid) return;
+    entry.inGrid = false;
+
+    auto groupFind = groups.find(entry.group);
+    if (groupFind == groups.end()) return;
+    Group &group = groupFind->second;
+    if (entry.large) {
+        eraseEntry(group.large, &entry);
+        return;
+    }
+    for (int x = entry.minCellX; x <= entry.maxCellX; x++) {
+        for (int y = entry.minCellY; y <= entry.maxCellY; y++) {
+            auto cellFind = group.cells.find(cellKey(x, y));
+            if (cellFind == group.cells.end()) continue;
+            eraseEntry(cellFind->second, &entry);
+            if (cellFind->second.empty()) group.cells.erase(cellFind);
+        }
+    }
+}
+
+void addToGrid(Entry &entry) {
+    Sprite *sprite = entry.sprite;
+    entry.group = sprite->name;
+    entry.inGrid = true;
+    Group &group = groups[entry.group];
+
+    entry.large = sprite->costumes.empty() ||
+                  !getCellRange(getCollisionBounds(sprite), entry.minCellX, entry.minCellY, entry.maxCellX, entry.maxCellY);
+    if (entry.large) {
+        group.large.push_back(&entry);
+        return;
+    }
+    for (int x = entry.minCellX; x <= entry.maxCellX; x++) {
+        for (int y = entry.minCellY; y <= entry.maxCellY; y++) {
+            group.cells[cellKey(x, y)].push_back(&entry);
+        }
+    }
+}
+
+void activate() {
+    active = true;
+    for (Sprite *sprite : sprites) {
+        if (sprite->isStage || sprite->isDeleted) continue;
+        Entry &entry = entries[sprite];
+        entry.sprite = sprite;
+        addToGrid(entry);
+    }
+}
+
+void refileDirtySprites() {
+    for (Sprite *sprite : dirtySprites) {
+        auto entryFind = entries.find(sprite);
+        if (entryFind == entries.end()) continue;
+        Entry &entry = entryFind->second;
+        entry.dirty = false;
+        removeFromGrid(entry);
+        if (sprite->isDeleted) {
+            entries.erase(entryFind);
+            continue;
+        }
+        addToGrid(entry);
+    }
+    dirtySprites.clear();
+}
+
+void addNearby(const std::vector<Entry *> &list) {
+    for (Entry *entry : list) {
+        if (entry->queryStamp == queryStamp) continue;
+        entry->queryStamp = queryStamp;
+        nearby.push_back(entry->sprite);
+    }
+}
+
+void addNearbyInGroup(const Group &group, int minX, int minY, int maxX, int maxY) {
+    for (int x = minX; x <= maxX; x++) {
+        for (int y = minY; y <= maxY; y++) {
+            auto cellFind = group.cells.find(cellKey(x, y));
+            if (cellFind != group.cells.end()) addNearby(cellFind->second);
+        }
+    }
+    addNearby(group.large);
+}
+
+} // namespace
+
+void SpatialGrid::markMoved(Sprite *sprite) {
+    sprite->collisionPointsDirty = true;
+    if (!active || sprite->isStage) return;
+    Entry &entry = entries[sprite];
+    entry.sprite = sprite;
+    if (entry.dirty) return;
+    entry.dirty = true;
+    dirtySprites.push_back(sprite);
+}
+
+void SpatialGrid::setSpriteSize(Sprite *sprite, int width, int height) {
+    if (sprite->spriteWidth == width && sprite->spriteHeight == height) return;
+    sprite->spriteWidth = width;
+    sprite->spriteHeight = height;
+    markMoved(sprite);
+}
+
+void SpatialGrid::setRotationCenter(Sprite *sprite, int rotationCenterX, int rotationCenterY) {
+    if (sprite->rotationCenterX == rotationCenterX && sprite->rotationCenterY == rotationCenterY) return;
+    sprite->rotationCenterX = rotationCenterX;
+    sprite->rotationCenterY = rotationCenterY;
+    markMoved(sprite);
+}
+
+const std::vector<Sprite *> &SpatialGrid::getNearby(Sprite *sprite, const std::string &name) {
+    if (!active) activate();
+    refileDirtySprites();
+    nearby.clear();
+
+    int minX, minY, maxX, maxY;
+    if (sprite->costumes.empty() || !getCellRange(getCollisionBounds(sprite), minX, minY, maxX, maxY)) {
+        // too big to look up cell by cell, so check everything with that name
+        for (Sprite *candidate : sprites) {
+            if (candidate->name == name) nearby.push_back(candidate);
+        }
+        return nearby;
+    }
+
+    auto groupFind = groups.find(name);
+    if (groupFind == groups.end()) return nearby;
+
+    queryStamp++;
+    addNearbyInGroup(groupFind->second, minX, minY, maxX, maxY);
+    return nearby;
+}
+
+const std::vector<Sprite *> &SpatialGrid::getNearby(Sprite *sprite) {
+    if (!active) activate();
+    refileDirtySprites();
+    nearby.clear();
+
+    int minX, minY, maxX, maxY;
+    if (sprite->costumes.empty() || !getCellRange(getCollisionBounds(sprite), minX, minY, maxX, maxY)) {
+        for (Sprite *candidate : sprites) {
+            if (!candidate->isStage) nearby.push_back(candidate);
+        }
+        return nearby;
+    }
+
+    queryStamp++;
+    for (const auto &[name, group] : groups) {
+        addNearbyInGroup(group, minX, minY, maxX, maxY);
+    }
+    return nearby;
+}
+
+void SpatialGrid::clear() {
+    active = false;
+    entries.clear();
+    groups.clear();
+    dirtySprites.clear();
+    nearby.clear();
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <vector>
+
+class Sprite;
+
+/**
+ * Uniform grid of sprite bounding boxes, grouped by sprite name, used as a broadphase for
+ * `touching (sprite)?` so a check against a sprite with hundreds of clones only runs the
+ * exact collision test on the clones near the sprite asking.
+ * The grid only starts being kept once a project first checks for touching a sprite. From then on,
+ * anything that moves, turns, resizes or changes the costume of a sprite marks it with `markMoved()`,
+ * and the marked sprites get put back in the right cells right before the next query.
+ */
+class SpatialGrid {
+  public:
+    /**
+     * Width and height of a grid cell, in stage units.
+     */
+    static constexpr double CELL_SIZE = 64.0;
+
+    /**
+     * Sprites covering more cells than this are kept in a separate list that every query checks.
+     */
+    static constexpr int MAX_CELLS_PER_SPRITE = 64;
+
+    /**
+     * Marks a sprite whose collision box might have changed (or that got created or deleted).
+     * This is also what tells `getCollisionPoints()` to work the sprite's box out again.
+     * @param sprite
+     */
+    static void markMoved(Sprite *sprite);
+
+    /**
+     * Sets the costume size a renderer measured for a sprite, marking it as moved when it changed.
+     * @param sprite
+     * @param width
+     * @param height
+     */
+    static void setSpriteSize(Sprite *sprite, int width, int height);
+
+    /**
+     * Sets a sprite's rotation center, marking it as moved when it changed.
+     * @param sprite
+     * @param rotationCenterX
+     * @param rotationCenterY
+     */
+    static void setRotationCenter(Sprite *sprite, int rotationCenterX, int rotationCenterY);
+
+    /**
+     * Gets every sprite named `name` whose bounding box could overlap `sprite`'s.
+     * The list is only valid until the next call.
+     * @param sprite the sprite asking
+     * @param name the name of the sprites to look for
+     * @return The sprites to run the exact collision test against.
+     */
+    static const std::vector<Sprite *> &getNearby(Sprite *sprite, const std::string &name);
+
+    /**
+     * Gets every sprite, whatever its name, whose bounding box could overlap `sprite`'s.
+     * The stage isn't included. The list is only valid until the next call.
+     * @param sprite the sprite asking
+     * @return The sprites that could be drawn under or over `sprite`, including `sprite` itself.
+     */
+    static const std::vector<Sprite *> &getNearby(Sprite *sprite);
+
+    /**
+     * Forgets every sprite. Called when sprites get cleaned up.
+     */
+    static void clear();
+};
@@ -57,10 +57,13 @@ struct Block {
     double waitDuration;
     double glideStartX, glideStartY;
     double glideEndX, glideEndY;
-    Timer waitTimer;
+    Timer waitTimer = Timer(true);
     bool customBlockExecuted = false;
     Block *customBlockPtr = nullptr;
-    std::vector<std::pair<Block *, Sprite *>> broadcastsRun;
+    int broadcastWaitCount = 0;               // receivers a `broadcast and wait` is still waiting on
+    unsigned int broadcastWaitGeneration = 0; // bumped every time a `broadcast and wait` starts
+    int broadcastId = -1; // interned BROADCAST_INPUT for broadcast blocks with a literal message
+    int keyId = -1;       // interned KEY_OPTION for "key pressed?" blocks with a literal key
     std::vector<std::string> substackBlocksRan;
     std::string waitingIfBlock = "";
 
@@ -124,9 +127,24 @@ struct Broadcast {
     std::string name;
 };
 
+/**
+ * A `broadcast and wait` block waiting for a chain to finish.
+ * Held by id, since the waiting sprite could be a clone that gets deleted in the meantime.
+ */
+struct ChainWaiter {
+    Sprite *sprite;
+    std::string spriteId;
+    std::string blockId;
+    unsigned int generation;
+};
+
 struct BlockChain {
     std::vector<Block *> blockChain;
     std::vector<std::string> blocksToRepeat;
+    bool suspended = false;           // skipped by `runRepeatBlocks()` while its current block is a `broadcast and wait` still waiting
+    std::vector<ChainWaiter> waiters; // woken once the chain finishes
+    bool sleeping = false;            // skipped by `runRepeatBlocks()` until its wake time in the sleep queue
+    unsigned int sleepGeneration = 0; // bumped every time the chain sleeps or wakes, so old sleep queue entries get ignored
 };
 
 struct Monitor {
@@ -144,6 +162,13 @@ struct Monitor {
     bool isDiscrete;
 };
 
+struct CollisionBounds {
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+};
+
 class Sprite {
   public:
     std::string name;
@@ -154,7 +179,6 @@ class Sprite {
     bool isClone;
     bool toDelete;
     bool isDeleted = false;
-    bool shouldDoSpriteClick = false;
     int currentCostume;
     std::string lastCostumeId = "";
     float volume;
@@ -177,7 +201,9 @@ class Sprite {
     };
 
     RotationStyle rotationStyle;
-    std::vector<std::pair<double, double>> collisionPoints;
+    std::vector<std::pair<double, double>> collisionPoints; // cached by `getCollisionPoints()`
+    CollisionBounds collisionBounds;                         // bounding box of `collisionPoints`
+    bool collisionPointsDirty = true;                        // set by `SpatialGrid::markMoved()` whenever the cache is out of date
     int spriteWidth;
     int spriteHeight;
 
@@ -190,6 +216,9 @@ class Sprite {
     std::unordered_map<std::string, Broadcast> broadcasts;
     std::unordered_map<std::string, CustomBlock> customBlocks;
     std::unordered_map<std::string, BlockChain> blockChains;
+    std::unordered_map<int, std::vector<Block *>> broadcastHats; // "when I receive" blocks, by broadcast id
+    std::unordered_map<int, std::vector<Block *>> keyHats;       // "when key pressed" blocks, by key id
+    std::vector<Block *> clickHats;                              // "when this sprite clicked" blocks
 
     ~Sprite() {
         variables.clear();
@@ -201,6 +230,9 @@ class Sprite {
         broadcasts.clear();
         customBlocks.clear();
         blockChains.clear();
+        broadcastHats.clear();
+        keyHats.clear();
+        clickHats.clear();
         collisionPoints.clear();
     }
 };
@@ -0,0 +1,275 @@
+#include "svgCache.hpp"
+#include "diskCache.hpp"
+#include "os.hpp"
+#include "trace.hpp"
+#include "workerPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#define NANOSVG_IMPLEMENTATION
+#include "nanosvg.h"
+#define NANOSVGRAST_IMPLEMENTATION
+#include "nanosvgrast.h"
+
+namespace {
+
+struct CacheKey {
+    std::string id;
+    float scale;
+};
+
+struct CachedRaster {
+    std::shared_ptr<const SvgCache::Raster> raster;
+    std::list<CacheKey>::iterator lruPosition;
+};
+
+struct SvgEntry {
+    std::shared_ptr<NSVGimage> svg;
+    std::map<float, CachedRaster> rasters;
+    std::vector<float> pending; // scales being rasterized on a worker thread
+};
+
+std::mutex cacheMutex;
+std::unordered_map<std::string, SvgEntry> entries;
+std::list<CacheKey> lru; // most recently used first
+size_t memoryUsage = 0;
+size_t budget = 0; // 0 until `setBudget()` gets called, for the default
+
+size_t getBudget() {
+    return budget != 0 ? budget : MemoryTracker::getMaxRamUsage() / 8;
+}
+
+size_t getRasterSize(const SvgCache::Raster &raster) {
+    return raster.rgba.size();
+}
+
+/**
+ * Drops the least recently used rasterizations until the cache fits its budget again.
+ * The most recently used one always stays, even if it's over the budget on its own,
+ * so a raster that was just made still reaches whoever asked for it.
+ * Needs `cacheMutex` held.
+ */
+void evictOverBudget() {
+    const size_t maxUsage = getBudget();
+    while (memoryUsage > maxUsage && lru.size() > 1) {
+        const CacheKey &key = lru.back();
+        auto entryFind = entries.find(key.id);
+        if (entryFind != entries.end()) {
+            auto rasterFind = entryFind->second.rasters.find(key.scale);
+            if (rasterFind != entryFind->second.rasters.end()) {
+                memoryUsage -= getRasterSize(*rasterFind->second.raster);
+                entryFind->second.rasters.erase(rasterFind);
+            }
+        }
+        lru.pop_back();
+    }
+}
+
+/**
+ * Caches a finished rasterization. Needs `cacheMutex` held.
+ */
+void insertRaster(SvgEntry &entry, const std::string &id, std::shared_ptr<const SvgCache::Raster> raster) {
+    const float scale = raster->scale;
+    auto existing = entry.rasters.find(scale);
+    if (existing != entry.rasters.end()) {
+        lru.splice(lru.begin(), lru, existing->second.lruPosition);
+        return;
+    }
+    lru.push_front({id, scale});
+    memoryUsage += getRasterSize(*raster);
+    entry.rasters[scale] = {std::move(raster), lru.begin()};
+    evictOverBudget();
+}
+
+/**
+ * Gets a cached rasterization and marks it as used. Needs `cacheMutex` held.
+ */
+std::shared_ptr<const SvgCache::Raster> findRaster(SvgEntry &entry, float scale) {
+    auto rasterFind = entry.rasters.find(scale);
+    if (rasterFind == entry.rasters.end()) return nullptr;
+    lru.splice(lru.begin(), lru, rasterFind->second.lruPosition);
+    return rasterFind->second.raster;
+}
+
+/**
+ * Rasterizes an SVG. Safe to call from any thread, since every thread gets its own rasterizer.
+ */
+std::shared_ptr<const SvgCache::Raster> rasterizeSvg(NSVGimage *svg, float scale) {
+    if (svg->width <= 0 || svg->height <= 0) return nullptr;
+    auto raster = std::make_shared<SvgCache::Raster>();
+    raster->scale = scale;
+    raster->width = std::max(1, static_cast<int>(svg->width * scale));
+    raster->height = std::max(1, static_cast<int>(svg->height * scale));
+
+    thread_local std::unique_ptr<NSVGrasterizer, decltype(&nsvgDeleteRasterizer)> rasterizer(nsvgCreateRasterizer(), nsvgDeleteRasterizer);
+    if (!rasterizer) return nullptr;
+
+    raster->rgba.assign(static_cast<size_t>(raster->width) * raster->height * 4, 0);
+    nsvgRasterize(rasterizer.get(), svg, 0, 0, scale, raster->rgba.data(), raster->width, raster->height, raster->width * 4);
+    return raster;
+}
+
+/**
+ * Reads a rasterization an earlier run made from `DiskCache`, or rasterizes the SVG and caches it for next time.
+ */
+std::shared_ptr<const SvgCache::Raster> rasterizeCached(const std::string &id, NSVGimage *svg, float scale) {
+    const std::string cacheKey = DiskCache::makeKey(id, scale, "rgba8");
+    auto cached = std::make_shared<SvgCache::Raster>();
+    DiskCache::Header header;
+    if (DiskCache::load(cacheKey, header, cached->rgba) && cached->rgba.size() == static_cast<size_t>(header.width) * header.height * 4) {
+        cached->width = static_cast<int>(header.width);
+        cached->height = static_cast<int>(header.height);
+        cached->scale = scale;
+        return cached;
+    }
+
+    std::shared_ptr<const SvgCache::Raster> raster = rasterizeSvg(svg, scale);
+    if (raster) {
+        DiskCache::Header rasterHeader;
+        rasterHeader.width = static_cast<uint32_t>(raster->width);
+        rasterHeader.height = static_cast<uint32_t>(raster->height);
+        DiskCache::store(cacheKey, rasterHeader, raster->rgba.data(), raster->rgba.size());
+    }
+    return raster;
+}
+
+} // namespace
+
+bool SvgCache::add(const std::string &id, const void *data, size_t size) {
+    // nanosvg parses in place and needs a null terminated string
+    std::string text(static_cast<const char *>(data), size);
+    NSVGimage *parsed = nsvgParse(text.data(), "px", 96.0f);
+    if (!parsed) return false;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto entryFind = entries.find(id);
+    if (entryFind != entries.end()) {
+        for (auto &[scale, cached] : entryFind->second.rasters) {
+            memoryUsage -= getRasterSize(*cached.raster);
+            lru.erase(cached.lruPosition);
+        }
+    }
+    SvgEntry &entry = entries[id];
+    entry = SvgEntry();
+    entry.svg = std::shared_ptr<NSVGimage>(parsed, nsvgDelete);
+    return true;
+}
+
+bool SvgCache::getSize(const std::string &id, int &width, int &height) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto entryFind = entries.find(id);
+    if (entryFind == entries.end()) return false;
+    width = static_cast<int>(entryFind->second.svg->width);
+    height = static_cast<int>(entryFind->second.svg->height);
+    return true;
+}
+
+float SvgCache::getScaleBucket(int width, int height, double scale) {
+    float bucket = MIN_SCALE;
+    while (bucket < scale && bucket < MAX_SCALE) {
+        bucket *= 2.0f;
+    }
+
+    // halve it until the raster fits, both in size and in the cache's budget
+    const int largest = std::max(width, height);
+    size_t maxBytes;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        maxBytes = getBudget();
+    }
+    const auto getBytes = [&](float s) {
+        return static_cast<size_t>(std::max(1.0f, width * s)) * static_cast<size_t>(std::max(1.0f, height * s)) * 4;
+    };
+    while (bucket > MIN_SCALE && (largest * bucket > MAX_RASTER_SIZE || getBytes(bucket) > maxBytes)) {
+        bucket /= 2.0f;
+    }
+    return bucket;
+}
+
+std::shared_ptr<const SvgCache::Raster> SvgCache::rasterize(const std::string &id, float scale) {
+    std::shared_ptr<NSVGimage> svg;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto entryFind = entries.find(id);
+        if (entryFind == entries.end()) return nullptr;
+        if (auto cached = findRaster(entryFind->second, scale)) return cached;
+        svg = entryFind->second.svg;
+    }
+
+    TRACE_SCOPE("rasterize " + id, "asset");
+    std::shared_ptr<const Raster> raster = rasterizeCached(id, svg.get(), scale);
+    if (!raster) return nullptr;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto entryFind = entries.find(id);
+    if (entryFind != entries.end() && entryFind->second.svg == svg) insertRaster(entryFind->second, id, raster);
+    return raster;
+}
+
+std::shared_ptr<const SvgCache::Raster> SvgCache::request(const std::string &id, float scale) {
+    std::shared_ptr<NSVGimage> svg;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto entryFind = entries.find(id);
+        if (entryFind == entries.end()) return nullptr;
+        SvgEntry &entry = entryFind->second;
+        if (auto cached = findRaster(entry, scale)) return cached;
+        if (entry.svg->width <= 0 || entry.svg->height <= 0) return nullptr;
+        if (std::find(entry.pending.begin(), entry.pending.end(), scale) != entry.pending.end()) return nullptr;
+        entry.pending.push_back(scale);
+        svg = entry.svg;
+    }
+
+    WorkerPool::submit([id, scale, svg]() {
+        TRACE_SCOPE("rasterize " + id, "asset");
+        std::shared_ptr<const Raster> raster = rasterizeCached(id, svg.get(), scale);
+
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto entryFind = entries.find(id);
+        // the SVG might have been removed or replaced in the meantime
+        if (entryFind == entries.end() || entryFind->second.svg != svg) return;
+        SvgEntry &entry = entryFind->second;
+        entry.pending.erase(std::remove(entry.pending.begin(), entry.pending.end(), scale), entry.pending.end());
+        if (raster) insertRaster(entry, id, raster);
+    });
+
+    // without worker threads, the job already ran
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto entryFind = entries.find(id);
+    if (entryFind == entries.end()) return nullptr;
+    return findRaster(entryFind->second, scale);
+}
+
+void SvgCache::remove(const std::string &id) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto entryFind = entries.find(id);
+    if (entryFind == entries.end()) return;
+    for (auto &[scale, cached] : entryFind->second.rasters) {
+        memoryUsage -= getRasterSize(*cached.raster);
+        lru.erase(cached.lruPosition);
+    }
+    entries.erase(entryFind);
+}
+
+void SvgCache::clear() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    entries.clear();
+    lru.clear();
+    memoryUsage = 0;
+}
+
+void SvgCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    budget = bytes;
+    evictOverBudget();
+}
+
+size_t SvgCache::getMemoryUsage() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return memoryUsage;
+}
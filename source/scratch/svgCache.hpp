@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps SVG costumes as parsed vector data, and rasterizes them at the scale they're actually drawn at
+ * instead of once at their native size, so big sprites stay sharp and tiny ones don't waste memory.
+ * Scales are rounded up to a power of two, so a sprite slowly changing size doesn't rasterize every frame.
+ * Rasterizations are kept in a least recently used cache under a memory budget, and new ones are made
+ * on the worker threads while the renderer keeps drawing whatever scale it already has.
+ */
+class SvgCache {
+  public:
+    /**
+     * Smallest and largest scale an SVG gets rasterized at.
+     */
+    static constexpr float MIN_SCALE = 0.25f;
+    static constexpr float MAX_SCALE = 8.0f;
+
+    /**
+     * Rasterizations are never wider or taller than this, whatever scale is asked for.
+     */
+    static constexpr int MAX_RASTER_SIZE = 2048;
+
+    /**
+     * An SVG's pixels at one scale.
+     */
+    struct Raster {
+        std::vector<unsigned char> rgba; // tightly packed, `width * 4` bytes per row
+        int width = 0;
+        int height = 0;
+        float scale = 1.0f;
+    };
+
+    /**
+     * Parses an SVG and keeps it under an id, replacing whatever was there.
+     * @param id the costume's id, without a file extension
+     * @param data the SVG file, which doesn't need to be null terminated
+     * @param size size of `data` in bytes
+     * @return `false` if the SVG couldn't be parsed.
+     */
+    static bool add(const std::string &id, const void *data, size_t size);
+
+    /**
+     * Gets an SVG's native size, which is its size at scale 1.
+     * @return `false` if there's no SVG with that id.
+     */
+    static bool getSize(const std::string &id, int &width, int &height);
+
+    /**
+     * Rounds the scale an SVG is drawn at up to the scale it should be rasterized at.
+     * The result is small enough for one rasterization to fit `MAX_RASTER_SIZE` and the cache's budget.
+     * @param width the SVG's native width
+     * @param height the SVG's native height
+     * @param scale how many screen pixels one of the SVG's pixels covers
+     */
+    static float getScaleBucket(int width, int height, double scale);
+
+    /**
+     * Rasterizes an SVG right away on the calling thread, or gets the cached rasterization.
+     * @param id
+     * @param scale a scale from `getScaleBucket()`
+     * @return The pixels, or `nullptr` if there's no SVG with that id or it has no size.
+     */
+    static std::shared_ptr<const Raster> rasterize(const std::string &id, float scale);
+
+    /**
+     * Gets a cached rasterization, starting one on a worker thread if there isn't one yet.
+     * @param id
+     * @param scale a scale from `getScaleBucket()`
+     * @return The pixels, or `nullptr` if they aren't ready yet.
+     */
+    static std::shared_ptr<const Raster> request(const std::string &id, float scale);
+
+    /**
+     * Forgets an SVG and all its rasterizations.
+     * @param id
+     */
+    static void remove(const std::string &id);
+
+    /**
+     * Forgets every SVG. Called when a project gets cleaned up.
+     */
+    static void clear();
+
+    /**
+     * Sets how many bytes of rasterizations can be cached before the least recently used ones go.
+     * Defaults to an eighth of the platform's RAM budget.
+     * @param bytes
+     */
+    static void setBudget(size_t bytes);
+
+    /**
+     * Gets how many bytes of rasterizations are currently cached.
+     */
+    static size_t getMemoryUsage();
+};
@@ -0,0 +1,120 @@
+#include "trace.hpp"
+#ifdef ENABLE_TRACE
+#include "os.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    std::string name;
+    const char *category;
+    char phase;
+    uint64_t timestamp;
+    uint64_t duration;
+    uint32_t threadId;
+};
+
+// keep a runaway project from eating all of the memory
+const size_t maxEvents = 2000000;
+
+std::mutex eventMutex;
+std::vector<TraceEvent> events;
+std::string traceFilePath;
+std::atomic<bool> recording{false};
+std::atomic<uint32_t> nextThreadId{1};
+const auto traceEpoch = std::chrono::steady_clock::now();
+
+uint32_t currentThreadId() {
+    thread_local uint32_t threadId = nextThreadId++;
+    return threadId;
+}
+
+void record(TraceEvent &&event) {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    if (events.size() >= maxEvents) {
+        if (recording.exchange(false)) Log::logWarning("Trace buffer is full, no more events will be recorded.");
+        return;
+    }
+    events.push_back(std::move(event));
+}
+
+} // namespace
+
+void Trace::start(const std::string &filePath) {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    events.clear();
+    events.reserve(65536);
+    traceFilePath = filePath;
+    recording = true;
+    Log::log("Tracing to " + traceFilePath);
+}
+
+void Trace::stop() {
+    if (traceFilePath.empty()) return;
+    recording = false;
+
+    std::lock_guard<std::mutex> lock(eventMutex);
+    std::ofstream file(traceFilePath);
+    if (!file.is_open()) {
+        Log::logWarning("Could not open trace file: " + traceFilePath);
+        events.clear();
+        traceFilePath.clear();
+        return;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent &event = events[i];
+        file << "{\"name\":" << (event.phase == 'M' ? "\"thread_name\"" : nlohmann::json(event.name).dump())
+             << ",\"cat\":\"" << event.category
+             << "\",\"ph\":\"" << event.phase
+             << "\",\"pid\":1,\"tid\":" << event.threadId;
+        if (event.phase == 'M') {
+            file << ",\"args\":{\"name\":" << nlohmann::json(event.name).dump() << "}";
+        } else {
+            file << ",\"ts\":" << event.timestamp;
+            if (event.phase == 'X') file << ",\"dur\":" << event.duration;
+            if (event.phase == 'i') file << ",\"s\":\"t\"";
+        }
+        file << (i + 1 < events.size() ? "},\n" : "}\n");
+    }
+    file << "]}\n";
+    file.close();
+
+    Log::log("Wrote " + std::to_string(events.size()) + " trace events to " + traceFilePath);
+    events.clear();
+    events.shrink_to_fit();
+    traceFilePath.clear();
+}
+
+bool Trace::isRecording() {
+    return recording;
+}
+
+uint64_t Trace::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void Trace::complete(const std::string &name, const char *category, uint64_t startTime) {
+    if (!recording) return;
+    uint64_t endTime = now();
+    record({name, category, 'X', startTime, endTime - startTime, currentThreadId()});
+}
+
+void Trace::instant(const std::string &name, const char *category) {
+    if (!recording) return;
+    record({name, category, 'i', now(), 0, currentThreadId()});
+}
+
+void Trace::setThreadName(const std::string &name) {
+    if (!recording) return;
+    // metadata events use the name as the thread name
+    record({name, "__metadata", 'M', 0, 0, currentThreadId()});
+}
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/**
+ * Optional timeline tracing in the Chrome/Perfetto trace-event format.
+ * Only compiled in when building with `ENABLE_TRACE=1`; otherwise every
+ * `TRACE_*` macro expands to nothing, so the disabled build pays no cost.
+ * Load the resulting `trace.json` in `chrome://tracing` or https://ui.perfetto.dev
+ */
+#ifdef ENABLE_TRACE
+
+class Trace {
+  public:
+    /**
+     * Starts recording trace events. Any events from a previous session are discarded.
+     * @param filePath where the trace gets written once `stop()` is called.
+     */
+    static void start(const std::string &filePath);
+
+    /**
+     * Stops recording and writes every recorded event to the file given to `start()`.
+     */
+    static void stop();
+
+    /**
+     * Whether or not events are currently being recorded.
+     */
+    static bool isRecording();
+
+    /**
+     * Gets the current trace time in microseconds.
+     */
+    static uint64_t now();
+
+    /**
+     * Records a complete ("X") event, a span with a start and a duration.
+     * @param name Name shown on the timeline
+     * @param category Category used for filtering in the trace viewer
+     * @param startTime start of the span, from `now()`
+     */
+    static void complete(const std::string &name, const char *category, uint64_t startTime);
+
+    /**
+     * Records an instant ("i") event, a single point in time.
+     * @param name Name shown on the timeline
+     * @param category Category used for filtering in the trace viewer
+     */
+    static void instant(const std::string &name, const char *category);
+
+    /**
+     * Names the calling thread on the timeline.
+     * @param name
+     */
+    static void setThreadName(const std::string &name);
+};
+
+/**
+ * Records a complete event covering the lifetime of the object.
+ */
+class TraceScope {
+  private:
+    std::string name;
+    const char *category;
+    uint64_t startTime;
+
+  public:
+    TraceScope(std::string name, const char *category) : name(std::move(name)), category(category), startTime(Trace::now()) {}
+    ~TraceScope() {
+        Trace::complete(name, category, startTime);
+    }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name, category) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, category)
+#define TRACE_INSTANT(name, category) Trace::instant(name, category)
+#define TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+#define TRACE_START(filePath) Trace::start(filePath)
+#define TRACE_STOP() Trace::stop()
+
+#else
+
+#define TRACE_SCOPE(name, category)
+#define TRACE_INSTANT(name, category)
+#define TRACE_THREAD_NAME(name)
+#define TRACE_START(filePath)
+#define TRACE_STOP()
+
+#endif
@@ -1,6 +1,8 @@
 #include "unzip.hpp"
 #include "image.hpp"
+#include "imageLoader.hpp"
 #include "menus/loading.hpp"
+#include "trace.hpp"
 #ifdef __3DS__
 #include <3ds.h>
 #elif defined(SDL_BUILD)
@@ -13,6 +15,8 @@ volatile bool Unzip::threadFinished = false;
 std::string Unzip::filePath = "";
 mz_zip_archive Unzip::zipArchive;
 std::vector<char> Unzip::zipBuffer;
+MappedFile Unzip::zipMapping;
+std::string Unzip::zipPath = "";
 bool Unzip::UnpackedInSD = false;
 void *Unzip::trackedBufferPtr = nullptr;
 size_t Unzip::trackedBufferSize = 0;
@@ -38,6 +42,7 @@ int Unzip::openFile(std::ifstream *file) {
         // .sb3 Project in romfs:/
         Log::logWarning("No unzipped project, trying embedded.");
         projectType = EMBEDDED;
+        zipPath = embeddedFilename;
         file->open(embeddedFilename, std::ios::binary | std::ios::ate);
         if (!(*file)) {
 
@@ -54,7 +59,8 @@ int Unzip::openFile(std::ifstream *file) {
                 if (filePath.size() >= 4 && filePath.substr(filePath.size() - 4, filePath.size()) == ".sb3") {
 
                     Log::log("Normal .sb3 project in SD card ");
-                    file->open(OS::getScratchFolderLocation() + filePath, std::ios::binary | std::ios::ate);
+                    zipPath = OS::getScratchFolderLocation() + filePath;
+                    file->open(zipPath, std::ios::binary | std::ios::ate);
                     if (!(*file)) {
 
                         Log::logError("Couldnt find file. jinkies.");
@@ -81,31 +87,25 @@ int Unzip::openFile(std::ifstream *file) {
 }
 
 int projectLoaderThread(void *data) {
+    TRACE_THREAD_NAME("ProjectLoader");
     Unzip::openScratchProject(NULL);
     return 0;
 }
 
 void loadInitialImages() {
+    TRACE_SCOPE("loadInitialImages", "asset");
     Unzip::loadingState = "Loading images";
-    int sprIndex = 1;
-    if (projectType == UNZIPPED) {
-        for (auto &currentSprite : sprites) {
-            if (!currentSprite->visible || currentSprite->ghostEffect == 100) continue;
-            Unzip::loadingState = "Loading image " + std::to_string(sprIndex) + " / " + std::to_string(sprites.size());
-            Image::loadImageFromFile(currentSprite->costumes[currentSprite->currentCostume].fullName);
-            sprIndex++;
-        }
-    } else {
-        for (auto &currentSprite : sprites) {
-            if (!currentSprite->visible || currentSprite->ghostEffect == 100) continue;
-            Unzip::loadingState = "Loading image " + std::to_string(sprIndex) + " / " + std::to_string(sprites.size());
-            Image::loadImageFromSB3(&Unzip::zipArchive, currentSprite->costumes[currentSprite->currentCostume].fullName);
-            sprIndex++;
-        }
+    std::vector<std::string> costumeFiles;
+    for (auto &currentSprite : sprites) {
+        if (!currentSprite->visible || currentSprite->ghostEffect == 100) continue;
+        costumeFiles.push_back(currentSprite->costumes[currentSprite->currentCostume].fullName);
     }
+    ImageLoader::loadAll(costumeFiles);
 }
 
 bool Unzip::load() {
+    TRACE_START(OS::getScratchFolderLocation() + "trace.json");
+    TRACE_THREAD_NAME("Main");
 
     Unzip::threadFinished = false;
     Unzip::projectOpened = 0;
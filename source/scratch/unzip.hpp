@@ -1,6 +1,9 @@
 #include "interpret.hpp"
+#include "mappedFile.hpp"
 #include "miniz/miniz.h"
 #include "os.hpp"
+#include "projectLoader.hpp"
+#include "zipEntry.hpp"
 #include <filesystem>
 #include <fstream>
 #include <random>
@@ -12,7 +15,12 @@
 #endif
 
 #ifdef ENABLE_CLOUDVARS
-extern std::string projectJSON;
+/**
+ * Remembers a hash of the project.json, which identifies the project to the cloud variable server.
+ * @param json
+ * @param size
+ */
+void hashProjectJSON(const char *json, size_t size);
 #endif
 
 class Unzip {
@@ -24,6 +32,8 @@ class Unzip {
     static bool UnpackedInSD;
     static mz_zip_archive zipArchive;
     static std::vector<char> zipBuffer;
+    static MappedFile zipMapping; // used instead of `zipBuffer` where files can be mapped
+    static std::string zipPath;   // where the .sb3 being opened is
     static void *trackedBufferPtr;
     static size_t trackedBufferSize;
     static void *trackedJsonPtr;
@@ -46,15 +56,14 @@ class Unzip {
             return;
         }
         loadingState = "Unzipping Scratch project";
-        nlohmann::json project_json = unzipProject(&file);
-        if (project_json.empty()) {
-            Log::logError("Project.json is empty.");
+        if (!unzipProject(&file)) {
+            Log::logError("Could not load project.json.");
             Unzip::projectOpened = -2;
             Unzip::threadFinished = true;
             return;
         }
         loadingState = "Loading Sprites";
-        loadSprites(project_json);
+        finishLoadingSprites();
         Unzip::projectOpened = 1;
         Unzip::threadFinished = true;
         return;
@@ -154,42 +163,56 @@ class Unzip {
         return splash;
     }
 
-    static nlohmann::json unzipProject(std::ifstream *file) {
-        nlohmann::json project_json;
-
+    /**
+     * Reads the project.json, and loads the sprites in it with `ProjectLoader` as it gets parsed.
+     * @param file the .sb3 or project.json file
+     * @return `false` if the project.json couldn't be read or loaded.
+     */
+    static bool unzipProject(std::ifstream *file) {
         if (projectType != UNZIPPED) {
-            // read the file
-            Log::log("Reading SB3...");
-            std::streamsize size = file->tellg();
-            file->seekg(0, std::ios::beg);
-            zipBuffer.resize(size);
-            if (!file->read(zipBuffer.data(), size)) {
-                return project_json;
-            }
+            const char *zipData;
+            size_t zipSize;
+            if (zipMapping.open(zipPath)) {
+                // pages of the file only get read once something in them is used
+                Log::log("Mapping SB3...");
+                zipData = zipMapping.data();
+                zipSize = zipMapping.size();
+            } else {
+                // read the file
+                Log::log("Reading SB3...");
+                std::streamsize size = file->tellg();
+                file->seekg(0, std::ios::beg);
+                zipBuffer.resize(size);
+                if (!file->read(zipBuffer.data(), size)) {
+                    return false;
+                }
 
-            // Use RAW allocation function and store both pointer and size
-            trackedBufferSize = zipBuffer.size();
-            trackedBufferPtr = MemoryTracker::allocate(trackedBufferSize);
+                // Use RAW allocation function and store both pointer and size
+                trackedBufferSize = zipBuffer.size();
+                trackedBufferPtr = MemoryTracker::allocate(trackedBufferSize);
+                zipData = zipBuffer.data();
+                zipSize = zipBuffer.size();
+            }
 
             // open ZIP file
             Log::log("Opening SB3 file...");
             memset(&zipArchive, 0, sizeof(zipArchive));
-            if (!mz_zip_reader_init_mem(&zipArchive, zipBuffer.data(), zipBuffer.size(), 0)) {
-                return project_json;
+            if (!mz_zip_reader_init_mem(&zipArchive, zipData, zipSize, 0)) {
+                return false;
             }
+            ZipEntry::setArchiveMemory(&zipArchive, zipData, zipSize);
 
             // extract project.json
             Log::log("Extracting project.json...");
-            int file_index = mz_zip_reader_locate_file(&zipArchive, "project.json", NULL, 0);
-            if (file_index < 0) {
-                return project_json;
+            ZipEntry projectFile(&zipArchive, "project.json");
+            if (!projectFile.data()) {
+                return false;
             }
-
-            size_t json_size;
-            const char *json_data = static_cast<const char *>(mz_zip_reader_extract_to_heap(&zipArchive, file_index, &json_size, 0));
+            const char *json_data = static_cast<const char *>(projectFile.data());
+            const size_t json_size = projectFile.size();
 
 #ifdef ENABLE_CLOUDVARS
-            projectJSON = std::string(json_data, json_size);
+            hashProjectJSON(json_data, json_size);
 #endif
 
             // Parse JSON file
@@ -198,8 +221,8 @@ class Unzip {
             trackedJsonSize = json_size;
             trackedJsonPtr = MemoryTracker::allocate(trackedJsonSize);
 
-            project_json = nlohmann::json::parse(std::string(json_data, json_size));
-            mz_free((void *)json_data);
+            // the sprites get loaded straight out of the extracted file, without copying it or parsing all of it first
+            bool loaded = ProjectLoader::load(json_data, json_size);
 
             // FIXED: Use RAW deallocate function
             if (trackedJsonPtr) {
@@ -207,29 +230,28 @@ class Unzip {
                 trackedJsonPtr = nullptr;
                 trackedJsonSize = 0;
             }
+            return loaded;
+        }
 
-        } else {
-            file->clear();
-            file->seekg(0, std::ios::beg);
+        file->clear();
+        file->seekg(0, std::ios::beg);
 
-            // get file size
-            file->seekg(0, std::ios::end);
-            std::streamsize size = file->tellg();
-            file->seekg(0, std::ios::beg);
+        // get file size
+        file->seekg(0, std::ios::end);
+        std::streamsize size = file->tellg();
+        file->seekg(0, std::ios::beg);
 
-            // put file into string
-            std::string json_content;
-            json_content.reserve(size);
-            json_content.assign(std::istreambuf_iterator<char>(*file),
-                                std::istreambuf_iterator<char>());
+        // put file into string
+        std::string json_content;
+        json_content.reserve(size);
+        json_content.assign(std::istreambuf_iterator<char>(*file),
+                            std::istreambuf_iterator<char>());
 
 #ifdef ENABLE_CLOUDVARS
-            projectJSON = json_content;
+        hashProjectJSON(json_content.data(), json_content.size());
 #endif
 
-            project_json = nlohmann::json::parse(json_content);
-        }
-        return project_json;
+        return ProjectLoader::load(json_content.data(), json_content.size());
     }
 
     static int openFile(std::ifstream *file);
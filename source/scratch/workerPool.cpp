@@ -0,0 +1,104 @@
+#include "workerPool.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Pool {
+    std::mutex mutex;
+    std::condition_variable wake; // a job came in, or the pool is stopping
+    std::condition_variable idle; // the last pending job finished
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> threads;
+    size_t pending = 0; // queued and running jobs
+    bool started = false;
+    bool stopping = false;
+
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    void run(size_t index) {
+        TRACE_THREAD_NAME("Worker " + std::to_string(index));
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+            if (--pending == 0) idle.notify_all();
+        }
+    }
+
+    /**
+     * Starts the threads, once. Needs `mutex` held.
+     */
+    void start() {
+        if (started) return;
+        started = true;
+        // leave a core for the game thread
+        const size_t cores = std::thread::hardware_concurrency();
+        const size_t count = cores > 1 ? std::min(cores - 1, WorkerPool::MAX_THREADS) : 0;
+        for (size_t i = 0; i < count; i++) {
+            threads.emplace_back(&Pool::run, this, i);
+        }
+    }
+};
+
+Pool &getPool() {
+    static Pool pool;
+    return pool;
+}
+
+} // namespace
+
+void WorkerPool::submit(std::function<void()> job) {
+    Pool &pool = getPool();
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.start();
+        if (!pool.threads.empty()) {
+            pool.jobs.push_back(std::move(job));
+            pool.pending++;
+            pool.wake.notify_one();
+            return;
+        }
+    }
+    job();
+}
+
+void WorkerPool::waitIdle() {
+    Pool &pool = getPool();
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.idle.wait(lock, [&pool] { return pool.pending == 0; });
+}
+
+size_t WorkerPool::getThreadCount() {
+    Pool &pool = getPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.start();
+    return pool.threads.size();
+}
+
+size_t WorkerPool::getPendingJobs() {
+    Pool &pool = getPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    return pool.pending;
+}
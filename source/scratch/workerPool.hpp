@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+/**
+ * A few background threads for work that shouldn't hold up the game thread, like decoding assets.
+ * The threads start the first time a job comes in and get joined when the program exits.
+ * Platforms that can't tell how many cores they have get no threads, and jobs just run right away
+ * on whichever thread submitted them.
+ */
+class WorkerPool {
+  public:
+    /**
+     * Most threads the pool will ever start.
+     */
+    static constexpr size_t MAX_THREADS = 4;
+
+    /**
+     * Queues a job to run on a worker thread.
+     * Jobs can run in any order, and must not touch sprites or anything else the game thread owns.
+     * @param job
+     */
+    static void submit(std::function<void()> job);
+
+    /**
+     * Waits until every queued job has finished.
+     */
+    static void waitIdle();
+
+    /**
+     * Gets how many worker threads there are, which is 0 when jobs run on the submitting thread.
+     */
+    static size_t getThreadCount();
+
+    /**
+     * Gets how many jobs are queued or running.
+     */
+    static size_t getPendingJobs();
+};
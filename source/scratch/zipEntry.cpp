@@ -0,0 +1,89 @@
+#include "zipEntry.hpp"
+#include <atomic>
+
+namespace {
+
+const size_t LOCAL_HEADER_SIZE = 30;
+const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+
+const mz_zip_archive *archive = nullptr;
+const char *archiveData = nullptr;
+size_t archiveSize = 0;
+
+std::atomic<uint64_t> inPlaceCount{0};
+std::atomic<uint64_t> inPlaceBytes{0};
+std::atomic<uint64_t> extractedCount{0};
+
+uint32_t readLittleEndian(const char *data, int bytes) {
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | static_cast<unsigned char>(data[i]);
+    }
+    return value;
+}
+
+} // namespace
+
+ZipEntry::ZipEntry(mz_zip_archive *zip, int fileIndex) {
+    read(zip, fileIndex);
+}
+
+ZipEntry::ZipEntry(mz_zip_archive *zip, const std::string &fileName) {
+    read(zip, mz_zip_reader_locate_file(zip, fileName.c_str(), nullptr, 0));
+}
+
+ZipEntry::~ZipEntry() {
+    if (extracted) mz_free(const_cast<void *>(bytes));
+}
+
+void ZipEntry::read(mz_zip_archive *zip, int fileIndex) {
+    if (fileIndex < 0) return;
+    if (findInArchive(zip, fileIndex)) {
+        inPlaceCount++;
+        inPlaceBytes += length;
+        return;
+    }
+    bytes = mz_zip_reader_extract_to_heap(zip, fileIndex, &length, 0);
+    extracted = bytes != nullptr;
+    if (extracted) extractedCount++;
+}
+
+bool ZipEntry::findInArchive(mz_zip_archive *zip, int fileIndex) {
+    if (zip != archive || !archiveData) return false;
+
+    mz_zip_archive_file_stat fileStat;
+    if (!mz_zip_reader_file_stat(zip, fileIndex, &fileStat)) return false;
+    if (fileStat.m_method != 0 || fileStat.m_is_encrypted || !fileStat.m_is_supported ||
+        fileStat.m_comp_size != fileStat.m_uncomp_size) return false;
+
+    // the local header has its own copy of the name and extra field, which can differ in size from the central directory's
+    const uint64_t headerOffset = fileStat.m_local_header_ofs;
+    if (headerOffset + LOCAL_HEADER_SIZE > archiveSize) return false;
+    const char *header = archiveData + headerOffset;
+    if (readLittleEndian(header, 4) != LOCAL_HEADER_SIGNATURE) return false;
+    const uint64_t dataOffset = headerOffset + LOCAL_HEADER_SIZE + readLittleEndian(header + 26, 2) + readLittleEndian(header + 28, 2);
+    if (dataOffset + fileStat.m_uncomp_size > archiveSize) return false;
+
+    // extracting checks this too, so a damaged file doesn't get through just because it wasn't copied
+    const char *data = archiveData + dataOffset;
+    const size_t size = static_cast<size_t>(fileStat.m_uncomp_size);
+    if (mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char *>(data), size) != fileStat.m_crc32) return false;
+
+    bytes = data;
+    length = size;
+    return true;
+}
+
+void ZipEntry::setArchiveMemory(const mz_zip_archive *zip, const char *data, size_t size) {
+    archive = zip;
+    archiveData = zip ? data : nullptr;
+    archiveSize = zip ? size : 0;
+}
+
+ZipEntry::Stats ZipEntry::getStats() {
+    Stats stats;
+    stats.inPlace = inPlaceCount;
+    stats.inPlaceBytes = inPlaceBytes;
+    stats.extracted = extractedCount;
+    return stats;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "miniz/miniz.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * The contents of one file in a zip archive, for as long as the entry lives.
+ * Files stored without compression in the archive set with `setArchiveMemory()` are used right where they are in it,
+ * without being copied. Anything else gets extracted to the heap, and freed along with the entry.
+ */
+class ZipEntry {
+  public:
+    struct Stats {
+        uint64_t inPlace = 0;      // entries read straight out of the archive
+        uint64_t inPlaceBytes = 0; // bytes of them
+        uint64_t extracted = 0;    // entries copied out of the archive
+    };
+
+    /**
+     * Reads a file from an archive.
+     * @param zip
+     * @param fileIndex
+     */
+    ZipEntry(mz_zip_archive *zip, int fileIndex);
+
+    /**
+     * Reads a file from an archive.
+     * @param zip
+     * @param fileName
+     */
+    ZipEntry(mz_zip_archive *zip, const std::string &fileName);
+
+    ZipEntry(const ZipEntry &) = delete;
+    ZipEntry &operator=(const ZipEntry &) = delete;
+    ~ZipEntry();
+
+    /**
+     * Gets the file's contents.
+     * @return `nullptr` if the file couldn't be read.
+     */
+    const void *data() const { return bytes; }
+    size_t size() const { return length; }
+
+    /**
+     * Tells entries where an archive opened with `mz_zip_reader_init_mem()` is in memory, so the files stored in it
+     * can be used in place. The memory has to stay valid until this gets called again.
+     * @param zip the archive, or `nullptr` to forget it
+     * @param data
+     * @param size
+     */
+    static void setArchiveMemory(const mz_zip_archive *zip, const char *data, size_t size);
+
+    /**
+     * Gets how many entries were read in place or extracted since the program started.
+     */
+    static Stats getStats();
+
+  private:
+    const void *bytes = nullptr;
+    size_t length = 0;
+    bool extracted = false; // `bytes` has to be freed
+
+    bool findInArchive(mz_zip_archive *zip, int fileIndex);
+    void read(mz_zip_archive *zip, int fileIndex);
+};
@@ -1,11 +1,19 @@
 #include "../scratch/audio.hpp"
 #include "../scratch/os.hpp"
+#include "assetCache.hpp"
 #include "audio.hpp"
+#include "diskCache.hpp"
 #include "interpret.hpp"
 #include "miniz/miniz.h"
 #include "sprite.hpp"
+#include "trace.hpp"
+#include "zipEntry.hpp"
+#include <cstring>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #ifdef __3DS__
 #include <3ds.h>
 #endif
@@ -13,6 +21,25 @@
 std::unordered_map<std::string, std::unique_ptr<SDL_Audio>> SDL_Sounds;
 std::string currentStreamedSound = "";
 
+static int startPlaying(const std::string &soundId);
+
+#ifdef ENABLE_AUDIO
+// sounds finish loading on their own threads, but only the game thread can add them to `AssetCache`
+static std::mutex loadedSoundsMutex;
+static std::vector<std::string> loadedSounds;
+// sounds that were started and haven't been seen stopped yet, touched every frame so they can't be freed while they play
+static std::unordered_set<std::string> playingSounds;
+
+/**
+ * Hands a sound that finished loading to the game thread, which adds it to `AssetCache` in `flushAudio()`.
+ * @param soundId
+ */
+static void queueLoadedSound(const std::string &soundId) {
+    std::lock_guard<std::mutex> lock(loadedSoundsMutex);
+    loadedSounds.push_back(soundId);
+}
+#endif
+
 #ifdef ENABLE_AUDIO
 SDL_Audio::SDL_Audio() : audioChunk(nullptr) {}
 #endif
@@ -34,6 +61,8 @@ SDL_Audio::~SDL_Audio() {
 
 int soundLoaderThread(void *data) {
     SDL_Audio::SoundLoadParams *params = static_cast<SDL_Audio::SoundLoadParams *>(data);
+    TRACE_THREAD_NAME("SoundLoader");
+    TRACE_SCOPE("load sound " + params->soundId, "asset");
     bool success = false;
     if (projectType != UNZIPPED)
         success = params->player->loadSoundFromSB3(params->sprite, params->zip, params->soundId, params->streamed);
@@ -47,6 +76,8 @@ int soundLoaderThread(void *data) {
 
 void NDS_soundLoaderThread(void *data) {
     SDL_Audio::SoundLoadParams *params = static_cast<SDL_Audio::SoundLoadParams *>(data);
+    TRACE_THREAD_NAME("SoundLoader");
+    TRACE_SCOPE("load sound " + params->soundId, "asset");
     if (projectType != UNZIPPED)
         params->player->loadSoundFromSB3(params->sprite, params->zip, params->soundId, params->streamed);
     else
@@ -59,10 +90,11 @@ void NDS_soundLoaderThread(void *data) {
 
 void SoundPlayer::startSoundLoaderThread(Sprite *sprite, mz_zip_archive *zip, const std::string &soundId) {
 #ifdef ENABLE_AUDIO
-
+    // a sound that's still loading was already counted as a miss when it got requested
     if (SDL_Sounds.find(soundId) != SDL_Sounds.end()) {
         return;
     }
+    AssetCache::countLookup(false);
 
     std::unique_ptr<SDL_Audio> audio = std::make_unique<SDL_Audio>();
     SDL_Sounds[soundId] = std::move(audio);
@@ -103,6 +135,80 @@ void SoundPlayer::startSoundLoaderThread(Sprite *sprite, mz_zip_archive *zip, co
 #endif
 }
 
+#ifdef ENABLE_AUDIO
+/**
+ * Gets the name a sound's PCM gets cached under in `DiskCache`, which depends on the format the mixer plays.
+ * @param soundId
+ * @return The key, or an empty string if the mixer isn't open.
+ */
+static std::string getCacheKey(const std::string &soundId) {
+    int frequency, channels;
+    Uint16 format;
+    if (!Mix_QuerySpec(&frequency, &format, &channels)) return "";
+    const std::string pcmFormat = "pcm" + std::to_string(frequency) + "-" + std::to_string(format) + "-" + std::to_string(channels);
+    return DiskCache::makeKey(soundId.substr(0, soundId.find_last_of('.')), 1.0f, pcmFormat);
+}
+
+/**
+ * Makes a sound from PCM an earlier run already converted for the mixer, skipping the zip and the decoder.
+ * @param soundId
+ * @return The sound, or `nullptr` if it isn't cached.
+ */
+static Mix_Chunk *loadCachedChunk(const std::string &soundId) {
+    const std::string cacheKey = getCacheKey(soundId);
+    DiskCache::Header header;
+    std::vector<unsigned char> pcm;
+    if (cacheKey.empty() || !DiskCache::load(cacheKey, header, pcm) || pcm.empty()) return nullptr;
+
+    Uint8 *buffer = static_cast<Uint8 *>(SDL_malloc(pcm.size()));
+    if (!buffer) return nullptr;
+    memcpy(buffer, pcm.data(), pcm.size());
+    Mix_Chunk *chunk = Mix_QuickLoad_RAW(buffer, static_cast<Uint32>(pcm.size()));
+    if (!chunk) {
+        SDL_free(buffer);
+        return nullptr;
+    }
+    // so `Mix_FreeChunk()` frees the buffer along with the chunk
+    chunk->allocated = 1;
+    return chunk;
+}
+
+/**
+ * Puts a sound that finished loading in `SDL_Sounds`, and starts playing it.
+ * @param sprite the sprite that asked for the sound
+ * @param soundId
+ * @param chunk the sound, if it isn't streamed
+ * @param music the sound, if it's streamed
+ */
+static void addLoadedSound(Sprite *sprite, const std::string &soundId, Mix_Chunk *chunk, Mix_Music *music) {
+    // Log::log("Creating SDL sound object...");
+
+    // Create SDL_Audio object
+    auto it = SDL_Sounds.find(soundId);
+    if (it == SDL_Sounds.end()) {
+        std::unique_ptr<SDL_Audio> audio;
+        audio = std::make_unique<SDL_Audio>();
+        SDL_Sounds[soundId] = std::move(audio);
+    }
+
+    if (chunk != nullptr) {
+        SDL_Sounds[soundId]->audioChunk = chunk;
+    } else {
+        SDL_Sounds[soundId]->music = music;
+        SDL_Sounds[soundId]->isStreaming = true;
+    }
+    SDL_Sounds[soundId]->audioId = soundId;
+
+    Log::log("Successfully loaded audio!");
+    // Log::log("memory usage: " + std::to_string(MemoryTracker::getCurrentUsage() / 1024) + " KB");
+    SDL_Sounds[soundId]->isLoaded = true;
+    SDL_Sounds[soundId]->channelId = SDL_Sounds.size();
+    startPlaying(soundId);
+    SoundPlayer::setSoundVolume(soundId, sprite->volume);
+    queueLoadedSound(soundId);
+}
+#endif
+
 bool SoundPlayer::loadSoundFromSB3(Sprite *sprite, mz_zip_archive *zip, const std::string &soundId, const bool &streamed) {
 #ifdef ENABLE_AUDIO
     if (!zip) {
@@ -112,6 +218,13 @@ bool SoundPlayer::loadSoundFromSB3(Sprite *sprite, mz_zip_archive *zip, const st
 
     // Log::log("Loading sound: '" + soundId + "'");
 
+    if (!streamed) {
+        if (Mix_Chunk *chunk = loadCachedChunk(soundId)) {
+            addLoadedSound(sprite, soundId, chunk, nullptr);
+            return true;
+        }
+    }
+
     int file_count = (int)mz_zip_reader_get_num_files(zip);
     if (file_count <= 0) {
         Log::logWarning("Error: No files found in zip archive");
@@ -142,9 +255,10 @@ bool SoundPlayer::loadSoundFromSB3(Sprite *sprite, mz_zip_archive *zip, const st
                 continue;
             }
 
-            size_t file_size;
             // Log::log("Extracting sound from sb3...");
-            void *file_data = mz_zip_reader_extract_to_heap(zip, i, &file_size, 0);
+            ZipEntry file(zip, i);
+            const void *file_data = file.data();
+            const size_t file_size = file.size();
             if (!file_data || file_size == 0) {
                 Log::logWarning("Failed to extract: " + zipFileName);
                 return false;
@@ -154,20 +268,20 @@ bool SoundPlayer::loadSoundFromSB3(Sprite *sprite, mz_zip_archive *zip, const st
             Mix_Chunk *chunk = nullptr;
 
             if (!streamed) {
-                SDL_RWops *rw = SDL_RWFromMem(file_data, (int)file_size);
+                SDL_RWops *rw = SDL_RWFromConstMem(file_data, (int)file_size);
                 if (!rw) {
                     Log::logWarning("Failed to create RWops for: " + zipFileName);
-                    mz_free(file_data);
                     return false;
                 }
                 // Log::log("Converting sound into SDL sound...");
                 chunk = Mix_LoadWAV_RW(rw, 1);
-                mz_free(file_data);
 
                 if (!chunk) {
                     Log::logWarning("Failed to load audio from memory: " + zipFileName + " - SDL_mixer Error: " + Mix_GetError());
                     return false;
                 }
+                const std::string cacheKey = getCacheKey(soundId);
+                if (!cacheKey.empty()) DiskCache::store(cacheKey, DiskCache::Header(), chunk->abuf, chunk->alen);
             } else {
                 // need to write to a temp file because this is a zip file
                 std::string tempDir = OS::getScratchFolderLocation() + "/cache";
@@ -178,20 +292,17 @@ bool SoundPlayer::loadSoundFromSB3(Sprite *sprite, mz_zip_archive *zip, const st
                     std::filesystem::create_directories(tempDir);
                 } catch (const std::exception &e) {
                     Log::logWarning(std::string("Failed to create temp directory: ") + e.what());
-                    mz_free(file_data);
                     return false;
                 }
 
                 FILE *fp = fopen(tempFile.c_str(), "wb");
                 if (!fp) {
                     Log::logWarning("Failed to create temp file for streaming");
-                    mz_free(file_data);
                     return false;
                 }
 
                 fwrite(file_data, 1, file_size, fp);
                 fclose(fp);
-                mz_free(file_data);
 
                 // Log::log("Converting sound into SDL streamed music...");
                 music = Mix_LoadMUS(tempFile.c_str());
@@ -205,30 +316,7 @@ bool SoundPlayer::loadSoundFromSB3(Sprite *sprite, mz_zip_archive *zip, const st
                 }
             }
 
-            // Log::log("Creating SDL sound object...");
-
-            // Create SDL_Audio object
-            auto it = SDL_Sounds.find(soundId);
-            if (it == SDL_Sounds.end()) {
-                std::unique_ptr<SDL_Audio> audio;
-                audio = std::make_unique<SDL_Audio>();
-                SDL_Sounds[soundId] = std::move(audio);
-            }
-
-            if (!streamed) {
-                SDL_Sounds[soundId]->audioChunk = chunk;
-            } else {
-                SDL_Sounds[soundId]->music = music;
-                SDL_Sounds[soundId]->isStreaming = true;
-            }
-            SDL_Sounds[soundId]->audioId = soundId;
-
-            Log::log("Successfully loaded audio!");
-            // Log::log("memory usage: " + std::to_string(MemoryTracker::getCurrentUsage() / 1024) + " KB");
-            SDL_Sounds[soundId]->isLoaded = true;
-            SDL_Sounds[soundId]->channelId = SDL_Sounds.size();
-            playSound(soundId);
-            setSoundVolume(soundId, sprite->volume);
+            addLoadedSound(sprite, soundId, chunk, music);
             return true;
         }
     }
@@ -294,20 +382,26 @@ bool SoundPlayer::loadSoundFromFile(Sprite *sprite, std::string fileName, const
     Log::log("Successfully loaded audio!");
     SDL_Sounds[fileName]->isLoaded = true;
     SDL_Sounds[fileName]->channelId = SDL_Sounds.size();
-    playSound(fileName);
+    startPlaying(fileName);
     setSoundVolume(fileName, sprite->volume);
+    queueLoadedSound(fileName);
     return true;
 #endif
     return false;
 }
 
-int SoundPlayer::playSound(const std::string &soundId) {
+/**
+ * Starts playing a loaded sound. Safe to call from a loader thread, since it leaves `AssetCache` alone.
+ * @param soundId
+ * @return The channel the sound plays on, or -1 if it couldn't be played.
+ */
+static int startPlaying(const std::string &soundId) {
 #ifdef ENABLE_AUDIO
     auto it = SDL_Sounds.find(soundId);
     if (it != SDL_Sounds.end()) {
 
         if (!currentStreamedSound.empty() && it->second->isStreaming) {
-            stopStreamedSound();
+            SoundPlayer::stopStreamedSound();
         }
 
         it->second->isPlaying = true;
@@ -334,6 +428,20 @@ int SoundPlayer::playSound(const std::string &soundId) {
     return -1;
 }
 
+int SoundPlayer::playSound(const std::string &soundId) {
+#ifdef ENABLE_AUDIO
+    auto it = SDL_Sounds.find(soundId);
+    if (it != SDL_Sounds.end() && it->second->isLoaded) {
+        AssetCache::countLookup(true);
+        if (it->second->cacheEntry != nullptr) {
+            AssetCache::touch(it->second->cacheEntry);
+            playingSounds.insert(soundId);
+        }
+    }
+#endif
+    return startPlaying(soundId);
+}
+
 void SoundPlayer::setSoundVolume(const std::string &soundId, float volume) {
 #ifdef ENABLE_AUDIO
     auto soundFind = SDL_Sounds.find(soundId);
@@ -453,22 +561,37 @@ void SoundPlayer::freeAudio(const std::string &soundId) {
     if (it != SDL_Sounds.end()) {
         Log::log("A sound has been freed!");
         SDL_Sounds.erase(it);
+        playingSounds.erase(soundId);
+        AssetCache::remove(soundId);
     } else Log::logWarning("Could not find sound to free: " + soundId);
 #endif
 }
 
 void SoundPlayer::flushAudio() {
 #ifdef ENABLE_AUDIO
-    if (SDL_Sounds.empty()) return;
-    for (auto &[id, audio] : SDL_Sounds) {
-        if (!isSoundPlaying(id)) {
-            audio->freeTimer -= 1;
-            if (audio->freeTimer <= 0) {
-                freeAudio(id);
-                return;
-            }
+    std::vector<std::string> newSounds;
+    {
+        std::lock_guard<std::mutex> lock(loadedSoundsMutex);
+        newSounds.swap(loadedSounds);
+    }
+    for (const std::string &id : newSounds) {
+        auto soundFind = SDL_Sounds.find(id);
+        if (soundFind == SDL_Sounds.end() || soundFind->second->cacheEntry != nullptr) continue;
+        SDL_Audio &audio = *soundFind->second;
+        const size_t cost = audio.audioChunk != nullptr ? audio.audioChunk->alen : audio.memorySize;
+        audio.cacheEntry = AssetCache::add(id, cost, SoundPlayer::freeAudio);
+        // loading sounds start playing as soon as they're ready
+        playingSounds.insert(id);
+    }
 
-        } else audio->freeTimer = 240;
+    for (auto playingIt = playingSounds.begin(); playingIt != playingSounds.end();) {
+        auto soundFind = SDL_Sounds.find(*playingIt);
+        if (soundFind == SDL_Sounds.end() || soundFind->second->cacheEntry == nullptr || !isSoundPlaying(*playingIt)) {
+            playingIt = playingSounds.erase(playingIt);
+            continue;
+        }
+        AssetCache::touch(soundFind->second->cacheEntry);
+        ++playingIt;
     }
 #endif
 }
@@ -477,7 +600,15 @@ void SoundPlayer::cleanupAudio() {
 #ifdef ENABLE_AUDIO
     Mix_HaltMusic();
     Mix_HaltChannel(-1);
+    for (auto &[id, audio] : SDL_Sounds) {
+        AssetCache::remove(id);
+    }
     SDL_Sounds.clear();
+    playingSounds.clear();
+    {
+        std::lock_guard<std::mutex> lock(loadedSoundsMutex);
+        loadedSounds.clear();
+    }
 
 #endif
 }
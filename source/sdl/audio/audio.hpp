@@ -3,6 +3,7 @@
 #include <SDL2/SDL_mixer.h>
 #endif
 #include "../../scratch/audio.hpp"
+#include "assetCache.hpp"
 #include "miniz/miniz.h"
 #include "sprite.hpp"
 #include <string>
@@ -20,7 +21,7 @@ class SDL_Audio {
     bool isStreaming = false;
     bool needsToBePlayed = true;
     size_t memorySize = 0;
-    size_t freeTimer = 240;
+    AssetCache::Entry *cacheEntry = nullptr; // set on the game thread once the sound has loaded, touched while it plays
 
     SDL_Audio();
     ~SDL_Audio();
@@ -1,12 +1,20 @@
 #include "image.hpp"
 #include "../scratch/image.hpp"
+#include "assetCache.hpp"
+#include "collisionMask.hpp"
+#include "imageLoader.hpp"
 #include "miniz/miniz.h"
 #include "os.hpp"
 #include "render.hpp"
+#include "svgCache.hpp"
+#include "textureAtlas.hpp"
+#include "trace.hpp"
 #include "unzip.hpp"
+#include "zipEntry.hpp"
 #include <algorithm>
 #include <cctype>
 #include <cstddef>
+#include <cstring>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -14,6 +22,110 @@
 std::unordered_map<std::string, SDL_Image *> images;
 static std::vector<std::string> toDelete;
 
+/**
+ * Adds a loaded image to `images`, and has `AssetCache` keep track of it.
+ * @param imgId
+ * @param image
+ * @param prefetched `true` if nothing has asked for the image yet
+ */
+static void addImage(const std::string &imgId, SDL_Image *image, bool prefetched = false) {
+    images[imgId] = image;
+    image->cacheEntry = AssetCache::add(imgId, image->memorySize, Image::freeImage, prefetched);
+}
+
+/**
+ * Builds a costume's collision mask from its decoded pixels.
+ * @param imgId the costume's id, without a file extension
+ * @param surface
+ */
+static void buildCollisionMask(const std::string &imgId, SDL_Surface *surface) {
+    SDL_Surface *rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    if (!rgba) return;
+    SDL_LockSurface(rgba);
+    CollisionMask::build(imgId, static_cast<const unsigned char *>(rgba->pixels), rgba->w, rgba->h, rgba->pitch);
+    SDL_UnlockSurface(rgba);
+    SDL_FreeSurface(rgba);
+}
+
+/**
+ * Puts an image's pixels on the GPU, and fills in its texture rect and memory usage.
+ * @param image
+ * @param surface the decoded image
+ * @param useAtlas whether the image may go in the texture atlas, which is only worth it for costumes
+ * @return `false` if no texture could be made.
+ */
+static bool uploadTexture(SDL_Image *image, SDL_Surface *surface, bool useAtlas) {
+    if (useAtlas && TextureAtlas::add(surface, image->atlasRegion)) {
+        image->spriteTexture = image->atlasRegion.texture;
+        image->textureRect = image->atlasRegion.rect;
+        image->textureWidth = TextureAtlas::PAGE_SIZE;
+        image->textureHeight = TextureAtlas::PAGE_SIZE;
+    } else {
+        image->spriteTexture = SDL_CreateTextureFromSurface(renderer, surface);
+        if (!image->spriteTexture) return false;
+        SDL_QueryTexture(image->spriteTexture, nullptr, nullptr, &image->textureWidth, &image->textureHeight);
+        image->textureRect = {0, 0, image->textureWidth, image->textureHeight};
+    }
+
+    // atlas images only count their own part of the page, so freeing them still frees memory
+    image->memorySize = static_cast<size_t>(surface->w) * surface->h * 4;
+    MemoryTracker::allocateVRAM(image->memorySize);
+    return true;
+}
+
+/**
+ * Gives back an image's texture, or its spot in the atlas.
+ * @param image
+ */
+static void releaseTexture(SDL_Image *image) {
+    MemoryTracker::deallocateVRAM(image->memorySize);
+    image->memorySize = 0;
+    if (image->atlasRegion.texture) {
+        TextureAtlas::remove(image->atlasRegion);
+        image->atlasRegion = TextureAtlas::Region();
+    } else if (image->spriteTexture) {
+        SDL_DestroyTexture(image->spriteTexture);
+    }
+    image->spriteTexture = nullptr;
+}
+
+/**
+ * Copies an SVG rasterization into a surface that owns its pixels.
+ * @param raster
+ */
+static SDL_Surface *createSurface(const SvgCache::Raster &raster) {
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, raster.width, raster.height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!surface) return nullptr;
+    SDL_LockSurface(surface);
+    for (int y = 0; y < raster.height; y++) {
+        memcpy(static_cast<unsigned char *>(surface->pixels) + static_cast<size_t>(y) * surface->pitch,
+               &raster.rgba[static_cast<size_t>(y) * raster.width * 4], static_cast<size_t>(raster.width) * 4);
+    }
+    SDL_UnlockSurface(surface);
+    return surface;
+}
+
+/**
+ * Parses an SVG costume into `SvgCache`, and rasterizes it at its native size.
+ * @param imgId the costume's id, without a file extension
+ * @param data the SVG file
+ * @param size size of `data` in bytes
+ * @return The rasterized costume, or `nullptr` if the SVG couldn't be parsed.
+ */
+static SDL_Surface *decodeSVG(const std::string &imgId, const void *data, size_t size) {
+    if (!SvgCache::add(imgId, data, size)) return nullptr;
+    std::shared_ptr<const SvgCache::Raster> raster = SvgCache::rasterize(imgId, 1.0f);
+    if (!raster) return nullptr;
+    return createSurface(*raster);
+}
+
+static bool isSVGPath(const std::string &path) {
+    if (path.size() < 4) return false;
+    std::string ext = path.substr(path.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".svg";
+}
+
 Image::Image(std::string filePath) {
     if (!loadImageFromFile(filePath, false)) return;
     std::string imgId = filePath.substr(0, filePath.find_last_of('.'));
@@ -55,7 +167,7 @@ void Image::render(double xPos, double yPos, bool centered) {
 
         SDL_Point center = {image->renderRect.w / 2, image->renderRect.h / 2};
 
-        image->freeTimer = image->maxFreeTime;
+        AssetCache::touch(image->cacheEntry);
         SDL_RenderCopyEx(renderer, image->spriteTexture, &image->textureRect, &image->renderRect, rotation, &center, SDL_FLIP_NONE);
     }
 }
@@ -78,16 +190,9 @@ bool Image::loadImageFromFile(std::string filePath, bool fromScratchProject) {
     if (Unzip::UnpackedInSD) finalPath = Unzip::filePath + filePath;
     // SDL_Image *image = new SDL_Image(finalPath);
     SDL_Image *image = MemoryTracker::allocate<SDL_Image>();
-    new (image) SDL_Image(finalPath);
-
-    // Track texture memory
-    if (image->spriteTexture) {
-        size_t textureMemory = image->width * image->height * 4;
-        MemoryTracker::allocateVRAM(textureMemory);
-        image->memorySize = textureMemory;
-    }
+    new (image) SDL_Image(finalPath, fromScratchProject ? imgId : "");
 
-    images[imgId] = image;
+    addImage(imgId, image);
     return true;
 }
 
@@ -99,21 +204,34 @@ bool Image::loadImageFromFile(std::string filePath, bool fromScratchProject) {
 void Image::loadImageFromSB3(mz_zip_archive *zip, const std::string &costumeId) {
     std::string imgId = costumeId.substr(0, costumeId.find_last_of('.'));
     if (images.find(imgId) != images.end()) return;
+    TRACE_SCOPE("decode " + costumeId, "asset");
+
+    DecodedImage image;
+    image.id = imgId;
+    image.costumeFile = costumeId;
+    if (ImageLoader::load(zip, image)) ImageLoader::upload(image);
+}
 
+bool ImageLoader::isLoaded(const std::string &imageId) {
+    return images.find(imageId) != images.end();
+}
+
+bool ImageLoader::decode(mz_zip_archive *zip, DecodedImage &image) {
+    const std::string &costumeId = image.costumeFile;
     // Log::log("Loading single image: " + costumeId);
 
     // Find the file in the zip
     int file_index = mz_zip_reader_locate_file(zip, costumeId.c_str(), nullptr, 0);
     if (file_index < 0) {
         Log::logWarning("Image file not found in zip: " + costumeId);
-        return;
+        return false;
     }
 
     // Get file stats
     mz_zip_archive_file_stat file_stat;
     if (!mz_zip_reader_file_stat(zip, file_index, &file_stat)) {
         Log::logWarning("Failed to get file stats for: " + costumeId);
-        return;
+        return false;
     }
 
     // Check if file is bitmap or SVG
@@ -130,77 +248,106 @@ void Image::loadImageFromSB3(mz_zip_archive *zip, const std::string &costumeId)
 
     if (!isSupported) {
         Log::logWarning("File is not a supported image format: " + costumeId);
-        return;
+        return false;
     }
 
-    // Extract file data
-    size_t file_size;
-    void *file_data = mz_zip_reader_extract_to_heap(zip, file_index, &file_size, 0);
-    if (!file_data) {
+    // Extract file data, or find it in the archive if it's stored uncompressed
+    ZipEntry file(zip, file_index);
+    if (!file.data()) {
         Log::logWarning("Failed to extract: " + costumeId);
-        return;
+        return false;
     }
 
-    // Use SDL_RWops to load image from memory
-    SDL_RWops *rw = SDL_RWFromMem(file_data, file_size);
-    if (!rw) {
-        Log::logWarning("Failed to create RWops for: " + costumeId);
-        mz_free(file_data);
-        return;
-    }
+    image.isSVG = isSVGPath(costumeId);
+    if (image.isSVG) {
+        // SVGs stay parsed, so they can be rasterized again at the size they get drawn at
+        std::shared_ptr<const SvgCache::Raster> raster;
+        if (SvgCache::add(image.id, file.data(), file.size())) raster = SvgCache::rasterize(image.id, 1.0f);
+        if (!raster) {
+            Log::logWarning("Failed to decode SVG: " + costumeId);
+            return false;
+        }
+        image.rgba = raster->rgba;
+        image.width = raster->width;
+        image.height = raster->height;
+    } else {
+        // Use SDL_RWops to load image from memory
+        SDL_RWops *rw = SDL_RWFromConstMem(file.data(), static_cast<int>(file.size()));
+        if (!rw) {
+            Log::logWarning("Failed to create RWops for: " + costumeId);
+            return false;
+        }
 
-    SDL_Surface *surface = IMG_Load_RW(rw, 0);
-    SDL_RWclose(rw);
-    mz_free(file_data);
+        SDL_Surface *surface = IMG_Load_RW(rw, 0);
+        SDL_RWclose(rw);
 
-    if (!surface) {
-        Log::logWarning("Failed to load image from memory: " + costumeId);
-        Log::logWarning("IMG Error: " + std::string(IMG_GetError()));
-        return;
-    }
+        if (!surface) {
+            Log::logWarning("Failed to load image from memory: " + costumeId);
+            Log::logWarning("IMG Error: " + std::string(IMG_GetError()));
+            return false;
+        }
 
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-    if (!texture) {
-        Log::logWarning("Failed to create texture: " + costumeId);
+        SDL_Surface *rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
         SDL_FreeSurface(surface);
-        return;
+        if (!rgba) {
+            Log::logWarning("Failed to convert image: " + costumeId);
+            return false;
+        }
+        image.width = rgba->w;
+        image.height = rgba->h;
+        image.rgba.resize(static_cast<size_t>(image.width) * image.height * 4);
+        SDL_LockSurface(rgba);
+        for (int y = 0; y < image.height; y++) {
+            memcpy(&image.rgba[static_cast<size_t>(y) * image.width * 4],
+                   static_cast<const unsigned char *>(rgba->pixels) + static_cast<size_t>(y) * rgba->pitch, static_cast<size_t>(image.width) * 4);
+        }
+        SDL_UnlockSurface(rgba);
+        SDL_FreeSurface(rgba);
     }
+    return true;
+}
 
-    SDL_FreeSurface(surface);
+void ImageLoader::upload(DecodedImage &decoded) {
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(decoded.rgba.data(), decoded.width, decoded.height, 32,
+                                                              decoded.width * 4, SDL_PIXELFORMAT_RGBA32);
+    if (!surface) {
+        Log::logWarning("Failed to create surface: " + decoded.costumeFile);
+        return;
+    }
 
     // Build SDL_Image object
     SDL_Image *image = MemoryTracker::allocate<SDL_Image>();
     new (image) SDL_Image();
-    image->spriteTexture = texture;
-    SDL_QueryTexture(texture, nullptr, nullptr, &image->width, &image->height);
+    const bool uploaded = uploadTexture(image, surface, true);
+    SDL_FreeSurface(surface);
+    if (!uploaded) {
+        Log::logWarning("Failed to create texture: " + decoded.costumeFile);
+        image->~SDL_Image();
+        MemoryTracker::deallocate<SDL_Image>(image);
+        if (decoded.isSVG) SvgCache::remove(decoded.id);
+        return;
+    }
+    image->width = decoded.width;
+    image->height = decoded.height;
     image->renderRect = {0, 0, image->width, image->height};
-    image->textureRect = {0, 0, image->width, image->height};
-
-    // calculate VRAM usage
-    Uint32 format;
-    int w, h;
-    SDL_QueryTexture(texture, &format, NULL, &w, &h);
-    int bpp;
-    Uint32 Rmask, Gmask, Bmask, Amask;
-    SDL_PixelFormatEnumToMasks(format, &bpp, &Rmask, &Gmask, &Bmask, &Amask);
-    image->memorySize = (w * h * bpp) / 8;
-    MemoryTracker::allocateVRAM(image->memorySize);
+    if (decoded.isSVG) image->svgId = decoded.id;
+    CollisionMask::build(decoded.id, decoded.rgba.data(), decoded.width, decoded.height, decoded.width * 4);
 
     // Log::log("Successfully loaded image: " + costumeId);
-    images[imgId] = image;
+    addImage(decoded.id, image, decoded.prefetched);
 }
 
+
 void Image::cleanupImages() {
     for (auto &[id, image] : images) {
-        if (image->memorySize > 0) {
-            MemoryTracker::deallocateVRAM(image->memorySize);
-        }
+        AssetCache::remove(id);
         // delete image;
         image->~SDL_Image();
         MemoryTracker::deallocate<SDL_Image>(image);
     }
     images.clear();
     toDelete.clear();
+    SvgCache::clear();
 }
 
 /**
@@ -218,111 +365,98 @@ void Image::freeImage(const std::string &costumeId) {
         MemoryTracker::deallocate<SDL_Image>(image);
 
         images.erase(imageIt);
+        AssetCache::remove(costumeId);
+        SvgCache::remove(costumeId);
     }
 }
 
 /**
- * Checks every `SDL_Image` in memory to see if they can be freed.
- * An `SDL_Image` will get freed if it goes unused for 120 frames.
+ * Frees images queued with `queueFreeImage()`, and lets `AssetCache` free the least recently used ones
+ * if everything together takes up too much memory.
  */
 void Image::FlushImages() {
-
-    // Free images if ram usage is too high
-    if (MemoryTracker::getVRAMUsage() + MemoryTracker::getCurrentUsage() > MemoryTracker::getMaxVRAMUsage() * 0.8) {
-
-        size_t times = 0;
-        while (MemoryTracker::getVRAMUsage() + MemoryTracker::getCurrentUsage() > MemoryTracker::getMaxVRAMUsage() * 0.5 && !images.empty()) {
-            SDL_Image *imgToDelete = nullptr;
-            std::string toDeleteStr = "";
-
-            for (auto &[id, img] : images) {
-                if (imgToDelete == nullptr && img->freeTimer != img->maxFreeTime) {
-                    imgToDelete = img;
-                    toDeleteStr = id;
-                    continue;
-                }
-                if (imgToDelete != nullptr && img->freeTimer < imgToDelete->freeTimer && img->freeTimer != img->maxFreeTime) {
-                    imgToDelete = img;
-                    toDeleteStr = id;
-                }
-            }
-
-            if (toDeleteStr != "") {
-                Image::freeImage(toDeleteStr);
-            } else {
-                break;
-            }
-            times++;
-            if (times > 15) break;
-        }
-    } else {
-        // Free images based on a timer
-        for (auto &[id, img] : images) {
-            if (img->freeTimer <= 0) {
-                toDelete.push_back(id);
-            } else {
-                img->freeTimer -= 1;
-            }
-        }
-
-        for (const std::string &id : toDelete) {
-            Image::freeImage(id);
-        }
-        toDelete.clear();
+    for (const std::string &id : toDelete) {
+        Image::freeImage(id);
     }
+    toDelete.clear();
+    AssetCache::endFrame();
 }
 
 SDL_Image::SDL_Image() {}
 
-SDL_Image::SDL_Image(std::string filePath) {
-    spriteSurface = IMG_Load(filePath.c_str());
+SDL_Image::SDL_Image(std::string filePath, const std::string &collisionMaskId) {
+    if (!collisionMaskId.empty() && isSVGPath(filePath)) {
+        // costumes keep their SVG around, like the ones loaded from an sb3
+        SDL_RWops *rw = SDL_RWFromFile(filePath.c_str(), "rb");
+        size_t fileSize = 0;
+        void *fileData = rw ? SDL_LoadFile_RW(rw, &fileSize, 1) : nullptr;
+        if (fileData) {
+            spriteSurface = decodeSVG(collisionMaskId, fileData, fileSize);
+            SDL_free(fileData);
+        }
+        if (spriteSurface) svgId = collisionMaskId;
+    } else {
+        spriteSurface = IMG_Load(filePath.c_str());
+    }
     if (spriteSurface == NULL) {
         Log::logWarning(std::string("Error loading image: ") + IMG_GetError());
         return;
     }
-    spriteTexture = SDL_CreateTextureFromSurface(renderer, spriteSurface);
-    if (spriteTexture == NULL) {
+    if (!uploadTexture(this, spriteSurface, !collisionMaskId.empty())) {
         Log::logWarning("Error creating texture");
+        SDL_FreeSurface(spriteSurface);
         return;
     }
+    width = spriteSurface->w;
+    height = spriteSurface->h;
+    renderRect = {0, 0, width, height};
+    if (!collisionMaskId.empty()) buildCollisionMask(collisionMaskId, spriteSurface);
     SDL_FreeSurface(spriteSurface);
 
-    // get width and height of image
-    int texW = 0;
-    int texH = 0;
-    SDL_QueryTexture(spriteTexture, NULL, NULL, &texW, &texH);
-    width = texW;
-    height = texH;
-    renderRect.w = width;
-    renderRect.h = height;
-    textureRect.w = width;
-    textureRect.h = height;
-    textureRect.x = 0;
-    textureRect.y = 0;
-
-    // calculate VRAM usage
-    Uint32 format;
-    int w, h;
-    SDL_QueryTexture(spriteTexture, &format, NULL, &w, &h);
-    int bpp;
-    Uint32 Rmask, Gmask, Bmask, Amask;
-    SDL_PixelFormatEnumToMasks(format, &bpp, &Rmask, &Gmask, &Bmask, &Amask);
-    memorySize = (w * h * bpp) / 8;
-    MemoryTracker::allocateVRAM(memorySize);
-
     // Log::log("Image loaded!");
 }
 
 /**
- * currently does nothing in the SDL version 😁😁
+ * Queues an image to be freed the next time `FlushImages()` is called.
  */
 void Image::queueFreeImage(const std::string &costumeId) {
     toDelete.push_back(costumeId);
 }
 
 SDL_Image::~SDL_Image() {
-    MemoryTracker::deallocateVRAM(memorySize);
-    SDL_DestroyTexture(spriteTexture);
+    releaseTexture(this);
+}
+
+void SDL_Image::updateResolution() {
+    const float bucket = SvgCache::getScaleBucket(width, height, wantedScale);
+    wantedScale = 0.0;
+    if (svgId.empty() || bucket == rasterScale) return;
+
+    // keep drawing the current resolution until the new one is ready
+    std::shared_ptr<const SvgCache::Raster> raster = SvgCache::request(svgId, bucket);
+    if (!raster) return;
+    SDL_Surface *surface = createSurface(*raster);
+    if (!surface) return;
+
+    SDL_Image previous;
+    previous.spriteTexture = spriteTexture;
+    previous.atlasRegion = atlasRegion;
+    previous.memorySize = memorySize;
+    atlasRegion = TextureAtlas::Region();
+    if (uploadTexture(this, surface, true)) {
+        // `previous` frees the old texture on its way out
+        rasterScale = bucket;
+        if (cacheEntry != nullptr) AssetCache::setCost(cacheEntry, memorySize);
+    } else {
+        Log::logWarning("Failed to create texture for " + svgId);
+        spriteTexture = previous.spriteTexture;
+        atlasRegion = previous.atlasRegion;
+        memorySize = previous.memorySize;
+        previous.spriteTexture = nullptr;
+        previous.atlasRegion = TextureAtlas::Region();
+        previous.memorySize = 0;
+    }
+    SDL_FreeSurface(surface);
 }
 
 void SDL_Image::setScale(float amount) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "assetCache.hpp"
+#include "textureAtlas.hpp"
 #include <SDL2/SDL_image.h>
 #include <string>
 #include <unordered_map>
@@ -7,22 +9,23 @@
 class SDL_Image {
   public:
     size_t imageUsageCount = 0;
-    SDL_Surface *spriteSurface;
-    SDL_Texture *spriteTexture;
-    SDL_Rect renderRect;  // this rect is for rendering to the screen
-    SDL_Rect textureRect; // this is for like texture UV's
-    size_t memorySize;
+    SDL_Surface *spriteSurface = nullptr;
+    SDL_Texture *spriteTexture = nullptr; // an atlas page if the image is in the atlas
+    SDL_Rect renderRect;                  // this rect is for rendering to the screen
+    SDL_Rect textureRect;                 // this is for like texture UV's
+    TextureAtlas::Region atlasRegion;     // where the image is in the atlas, if it is
+    size_t memorySize = 0;
     float scale = 1.0f;
     int width;
     int height;
+    // size of `spriteTexture`, which is a whole page for atlas images
+    int textureWidth;
+    int textureHeight;
     float rotation = 0.0f;
-#ifdef GAMECUBE
-    int maxFreeTime = 2;
-#else
-    int maxFreeTime = 480;
-#endif
-
-    int freeTimer = maxFreeTime;
+    std::string svgId;                       // the costume's id in `SvgCache`, if it's an SVG
+    float rasterScale = 1.0f;                // the scale the SVG's pixels were last rasterized at
+    double wantedScale = 0.0;                // the largest scale the SVG got drawn at this frame
+    AssetCache::Entry *cacheEntry = nullptr; // touched whenever the image gets drawn
 
     /**
      * Scales an image by a scale factor.
@@ -35,6 +38,12 @@ class SDL_Image {
      */
     void setRotation(float amount);
 
+    /**
+     * Swaps an SVG costume's texture to the resolution matching `wantedScale`, once it's been rasterized,
+     * and resets `wantedScale` for the next frame.
+     */
+    void updateResolution();
+
     /**
      * A Simple Image object using SDL.
      */
@@ -42,8 +51,9 @@ class SDL_Image {
     /**
      * A Simple Image object using SDL.
      * @param filePath
+     * @param collisionMaskId if not empty, a collision mask gets built from the image under this id
      */
-    SDL_Image(std::string filePath);
+    SDL_Image(std::string filePath, const std::string &collisionMaskId = "");
 
     ~SDL_Image();
 };
@@ -1,8 +1,10 @@
 #include "input.hpp"
 #include "blockExecutor.hpp"
+#include "perfOverlay.hpp"
 #include "render.hpp"
 #include "sprite.hpp"
 #include <algorithm>
+#include <array>
 #include <cctype>
 #include <cstddef>
 #include <map>
@@ -27,13 +29,6 @@ extern char nickname[0x21];
 #include <ogc/conf.h>
 #endif
 
-Input::Mouse Input::mousePointer;
-Sprite *Input::draggingSprite = nullptr;
-
-std::vector<std::string> Input::inputButtons;
-std::map<std::string, std::string> Input::inputControls;
-int Input::keyHeldFrames = 0;
-
 extern SDL_GameController *controller;
 extern bool touchActive;
 extern SDL_Point touchPosition;
@@ -59,13 +54,44 @@ std::vector<int> Input::getTouchPosition() {
     return pos;
 }
 
+static constexpr int UNKNOWN_KEY = -2;
+
+/**
+ * Gets the key id of an SDL scancode, or -1 for keys Scratch has no name for.
+ * A scancode's name only gets worked out and interned the first time it's pressed, after that it's a table lookup.
+ */
+static int getScancodeKeyId(int scancode) {
+    static std::array<int, SDL_NUM_SCANCODES> keyIds = [] {
+        std::array<int, SDL_NUM_SCANCODES> ids;
+        ids.fill(UNKNOWN_KEY);
+        return ids;
+    }();
+    if (keyIds[scancode] != UNKNOWN_KEY) return keyIds[scancode];
+
+    const char *name = SDL_GetScancodeName(static_cast<SDL_Scancode>(scancode));
+    if (!name || name[0] == '\0') return keyIds[scancode] = -1;
+    std::string keyName(name);
+    std::transform(keyName.begin(), keyName.end(), keyName.begin(), ::tolower);
+
+    if (keyName == "up") keyName = "up arrow";
+    else if (keyName == "down") keyName = "down arrow";
+    else if (keyName == "left") keyName = "left arrow";
+    else if (keyName == "right") keyName = "right arrow";
+    else if (keyName == "return") keyName = "enter";
+    return keyIds[scancode] = Input::getKeyId(keyName);
+}
+
 void Input::getInput() {
-    inputButtons.clear();
+    clearKeyStates();
     mousePointer.isPressed = false;
     mousePointer.isMoving = false;
 
     const Uint8 *keyStates = SDL_GetKeyboardState(NULL);
-    bool anyKeyPressed = false;
+
+    // F3 toggles the performance overlay in debug mode
+    static bool overlayKeyHeld = false;
+    if (keyStates[SDL_SCANCODE_F3] && !overlayKeyHeld) PerfOverlay::toggle();
+    overlayKeyHeld = keyStates[SDL_SCANCODE_F3];
 
     // prints what buttons are being pressed (debug)
     // for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; ++i) {
@@ -82,145 +108,104 @@ void Input::getInput() {
     // }
 
     for (int scancode = 0; scancode < SDL_NUM_SCANCODES; ++scancode) {
-        if (keyStates[scancode]) {
-            const char *name = SDL_GetScancodeName(static_cast<SDL_Scancode>(scancode));
-            if (name && name[0] != '\0') {
-                std::string keyName(name);
-                std::transform(keyName.begin(), keyName.end(), keyName.begin(), ::tolower);
-
-                if (keyName == "up") keyName = "up arrow";
-                else if (keyName == "down") keyName = "down arrow";
-                else if (keyName == "left") keyName = "left arrow";
-                else if (keyName == "right") keyName = "right arrow";
-                else if (keyName == "return") keyName = "enter";
-
-                inputButtons.push_back(keyName);
-                anyKeyPressed = true;
-            }
-        }
+        if (!keyStates[scancode]) continue;
+        const int keyId = getScancodeKeyId(scancode);
+        if (keyId != -1) pressKey(keyId);
     }
 
     // TODO: Clean this up
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_DPAD_UP)) {
-        Input::buttonPress("dpadUp");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_DPAD_UP);
         if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_LEFTSHOULDER)) mousePointer.y += 3;
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_DPAD_DOWN)) {
-        Input::buttonPress("dpadDown");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_DPAD_DOWN);
         if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_LEFTSHOULDER)) mousePointer.y -= 3;
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_DPAD_LEFT)) {
-        Input::buttonPress("dpadLeft");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_DPAD_LEFT);
         if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_LEFTSHOULDER)) mousePointer.x -= 3;
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_DPAD_RIGHT)) {
-        Input::buttonPress("dpadRight");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_DPAD_RIGHT);
         if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_LEFTSHOULDER)) mousePointer.x += 3;
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_A)) {
-        Input::buttonPress("A");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_A);
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_B)) {
-        Input::buttonPress("B");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_B);
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_X)) {
-        Input::buttonPress("X");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_X);
 #ifdef __OGC__ // SDL 'x' is the A button on a wii remote
         mousePointer.isPressed = true;
 #endif
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_Y)) {
-        Input::buttonPress("Y");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_Y);
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_LEFTSHOULDER)) {
-        Input::buttonPress("shoulderL");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_SHOULDER_L);
         mousePointer.isMoving = true;
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_RIGHTSHOULDER)) {
-        Input::buttonPress("shoulderR");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_SHOULDER_R);
         if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_LEFTSHOULDER)) mousePointer.isPressed = true;
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_START)) {
-        Input::buttonPress("start");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_START);
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_BACK)) {
-        Input::buttonPress("back");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_BACK);
 #ifdef WII
         toExit = true;
 #endif
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_LEFTSTICK)) {
-        Input::buttonPress("LeftStickPressed");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_LEFT_STICK_PRESSED);
     }
     if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton::SDL_CONTROLLER_BUTTON_RIGHTSTICK)) {
-        Input::buttonPress("RightStickPressed");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_RIGHT_STICK_PRESSED);
     }
     float joyLeftX = SDL_GameControllerGetAxis(controller, SDL_GameControllerAxis::SDL_CONTROLLER_AXIS_LEFTX);
     float joyLeftY = SDL_GameControllerGetAxis(controller, SDL_GameControllerAxis::SDL_CONTROLLER_AXIS_LEFTY);
     if (joyLeftX > CONTROLLER_DEADZONE_X) {
-        Input::buttonPress("LeftStickRight");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_LEFT_STICK_RIGHT);
     }
     if (joyLeftX < -CONTROLLER_DEADZONE_X) {
-        Input::buttonPress("LeftStickLeft");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_LEFT_STICK_LEFT);
     }
     if (joyLeftY > CONTROLLER_DEADZONE_Y) {
-        Input::buttonPress("LeftStickDown");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_LEFT_STICK_DOWN);
     }
     if (joyLeftY < -CONTROLLER_DEADZONE_Y) {
-        Input::buttonPress("LeftStickUp");
-        inputButtons.push_back("up arrow");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_LEFT_STICK_UP);
+        static const int upArrowKeyId = getKeyId("up arrow");
+        pressKey(upArrowKeyId);
     }
     float joyRightX = SDL_GameControllerGetAxis(controller, SDL_GameControllerAxis::SDL_CONTROLLER_AXIS_RIGHTX);
     float joyRightY = SDL_GameControllerGetAxis(controller, SDL_GameControllerAxis::SDL_CONTROLLER_AXIS_RIGHTY);
     if (joyRightX > CONTROLLER_DEADZONE_X) {
-        Input::buttonPress("RightStickRight");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_RIGHT_STICK_RIGHT);
     }
     if (joyRightX < -CONTROLLER_DEADZONE_X) {
-        Input::buttonPress("RightStickLeft");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_RIGHT_STICK_LEFT);
     }
     if (joyRightY > CONTROLLER_DEADZONE_Y) {
-        Input::buttonPress("RightStickDown");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_RIGHT_STICK_DOWN);
     }
     if (joyRightY < -CONTROLLER_DEADZONE_Y) {
-        Input::buttonPress("RightStickUp");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_RIGHT_STICK_UP);
     }
     if (SDL_GameControllerGetAxis(controller, SDL_GameControllerAxis::SDL_CONTROLLER_AXIS_TRIGGERLEFT) > CONTROLLER_DEADZONE_TRIGGER) {
-        Input::buttonPress("LT");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_LT);
     }
     if (SDL_GameControllerGetAxis(controller, SDL_GameControllerAxis::SDL_CONTROLLER_AXIS_TRIGGERRIGHT) > CONTROLLER_DEADZONE_TRIGGER) {
-        Input::buttonPress("RT");
-        anyKeyPressed = true;
+        Input::buttonPress(Input::BUTTON_RT);
     }
 
-    if (anyKeyPressed) {
-        keyHeldFrames++;
-        inputButtons.push_back("any");
-        if (keyHeldFrames == 1 || keyHeldFrames > 13)
-            BlockExecutor::runAllBlocksByOpcode("event_whenkeypressed");
-    } else keyHeldFrames = 0;
+    updateKeyStates();
 
     // TODO: Add way to disable touch input (currently overrides mouse input.)
     if (SDL_GetNumTouchDevices() > 0) {
@@ -1,12 +1,18 @@
 #include "../scratch/render.hpp"
 #include "../scratch/image.hpp"
+#include "assetCache.hpp"
 #include "audio.hpp"
+#include "drawOrder.hpp"
 #include "image.hpp"
+#include "imageLoader.hpp"
 #include "interpret.hpp"
 #include "math.hpp"
+#include "perfOverlay.hpp"
 #include "render.hpp"
+#include "spatialGrid.hpp"
 #include "sprite.hpp"
 #include "text.hpp"
+#include "trace.hpp"
 #include "unzip.hpp"
 #include <SDL2/SDL.h>
 #include <algorithm>
@@ -291,56 +297,158 @@ void drawBlackBars(int screenWidth, int screenHeight) {
     }
 }
 
+namespace {
+
+/**
+ * Collects sprite quads that share a texture and blend mode, so a run of them (like the clones
+ * of one sprite) gets drawn with a single `SDL_RenderGeometry()` call instead of one call per sprite.
+ * Quads are never reordered, so anything else drawn in between has to `flush()` first.
+ */
+struct SpriteBatch {
+    SDL_Texture *texture = nullptr;
+    SDL_BlendMode blendMode = SDL_BLENDMODE_BLEND;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+
+    /**
+     * Queues a texture drawn like `SDL_RenderCopyEx()` would, rotated around the middle of `dst`.
+     * @param quadTexture
+     * @param quadBlendMode
+     * @param image the image whose `textureRect` gets drawn into its `renderRect`
+     * @param angle clockwise rotation, in radians
+     * @param flip whether to mirror the image horizontally
+     * @param color color and alpha the texture is multiplied by
+     */
+    void add(SDL_Texture *quadTexture, SDL_BlendMode quadBlendMode, const SDL_Image *image, double angle, bool flip, SDL_Color color) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        if (quadTexture != texture || quadBlendMode != blendMode) {
+            flush();
+            texture = quadTexture;
+            blendMode = quadBlendMode;
+        }
+
+        const SDL_Rect &dst = image->renderRect;
+        const SDL_Rect &src = image->textureRect;
+        const float centerX = dst.x + dst.w / 2;
+        const float centerY = dst.y + dst.h / 2;
+        const float cosAngle = std::cos(angle);
+        const float sinAngle = std::sin(angle);
+        float left = static_cast<float>(src.x) / image->textureWidth;
+        float right = static_cast<float>(src.x + src.w) / image->textureWidth;
+        const float top = static_cast<float>(src.y) / image->textureHeight;
+        const float bottom = static_cast<float>(src.y + src.h) / image->textureHeight;
+        if (flip) std::swap(left, right);
+
+        const int first = static_cast<int>(vertices.size());
+        const float corners[4][4] = {
+            {static_cast<float>(dst.x), static_cast<float>(dst.y), left, top},
+            {static_cast<float>(dst.x + dst.w), static_cast<float>(dst.y), right, top},
+            {static_cast<float>(dst.x + dst.w), static_cast<float>(dst.y + dst.h), right, bottom},
+            {static_cast<float>(dst.x), static_cast<float>(dst.y + dst.h), left, bottom}};
+        for (const auto &corner : corners) {
+            const float x = corner[0] - centerX;
+            const float y = corner[1] - centerY;
+            vertices.push_back({{centerX + x * cosAngle - y * sinAngle, centerY + x * sinAngle + y * cosAngle}, color, {corner[2], corner[3]}});
+        }
+        for (int index : {0, 1, 2, 0, 2, 3}) {
+            indices.push_back(first + index);
+        }
+#else
+        // no geometry rendering on older SDL versions, so draw it right away
+        SDL_Point center = {image->renderRect.w / 2, image->renderRect.h / 2};
+        SDL_SetTextureBlendMode(quadTexture, quadBlendMode);
+        SDL_SetTextureColorMod(quadTexture, color.r, color.g, color.b);
+        SDL_SetTextureAlphaMod(quadTexture, color.a);
+        SDL_RenderCopyEx(renderer, quadTexture, &image->textureRect, &image->renderRect, Math::radiansToDegrees(angle), &center,
+                         flip ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
+        SDL_SetTextureBlendMode(quadTexture, SDL_BLENDMODE_BLEND);
+        PerfOverlay::countDrawCall();
+#endif
+    }
+
+    /**
+     * Draws everything queued so far.
+     */
+    void flush() {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        if (indices.empty()) return;
+        // the texture's own modulation would multiply with the vertex colors
+        SDL_SetTextureColorMod(texture, 255, 255, 255);
+        SDL_SetTextureAlphaMod(texture, 255);
+        SDL_SetTextureBlendMode(texture, blendMode);
+        SDL_RenderGeometry(renderer, texture, vertices.data(), static_cast<int>(vertices.size()), indices.data(), static_cast<int>(indices.size()));
+        if (blendMode != SDL_BLENDMODE_BLEND) SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        PerfOverlay::countDrawCall();
+
+        vertices.clear();
+        indices.clear();
+        texture = nullptr;
+#endif
+    }
+};
+
+SpriteBatch spriteBatch;
+
+} // namespace
+
 void Render::renderSprites() {
+    TRACE_SCOPE("renderSprites", "render");
     SDL_GetWindowSizeInPixels(window, &windowWidth, &windowHeight);
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_RenderClear(renderer);
+    ImageLoader::processUploads();
 
     double scaleX = static_cast<double>(windowWidth) / Scratch::projectWidth;
     double scaleY = static_cast<double>(windowHeight) / Scratch::projectHeight;
     double scale;
     scale = std::min(scaleX, scaleY);
 
-    // Sort sprites by layer with stage always being first
-    std::vector<Sprite *> spritesByLayer = sprites;
-    std::sort(spritesByLayer.begin(), spritesByLayer.end(),
-              [](const Sprite *a, const Sprite *b) {
-                  // Stage sprite always comes first
-                  if (a->isStage && !b->isStage) return true;
-                  if (!a->isStage && b->isStage) return false;
-                  // Otherwise sort by layer
-                  return a->layer < b->layer;
-              });
+    // already in layer order, with the stage first
+    const std::vector<Sprite *> &spritesByLayer = DrawOrder::get();
+    std::vector<SDL_Image *> drawnSVGs;
 
     for (Sprite *currentSprite : spritesByLayer) {
         if (!currentSprite->visible) continue;
 
         bool legacyDrawing = false;
-        auto imgFind = images.find(currentSprite->costumes[currentSprite->currentCostume].id);
+        const Costume *costume = &currentSprite->costumes[currentSprite->currentCostume];
+        auto imgFind = images.find(costume->id);
+        PerfOverlay::countImageLookup(imgFind != images.end());
+        if (imgFind == images.end() && ImageLoader::isLoading(costume->id)) {
+            // keep showing the previous costume until the new one is ready
+            imgFind = images.find(currentSprite->lastCostumeId);
+            if (imgFind == images.end()) continue;
+            for (const Costume &previous : currentSprite->costumes) {
+                if (previous.id == currentSprite->lastCostumeId) costume = &previous;
+            }
+        }
         if (imgFind == images.end()) {
             legacyDrawing = true;
         } else {
-            currentSprite->rotationCenterX = currentSprite->costumes[currentSprite->currentCostume].rotationCenterX;
-            currentSprite->rotationCenterY = currentSprite->costumes[currentSprite->currentCostume].rotationCenterY;
+            currentSprite->lastCostumeId = costume->id;
+            SpatialGrid::setRotationCenter(currentSprite, costume->rotationCenterX, costume->rotationCenterY);
         }
         if (!legacyDrawing) {
             SDL_Image *image = imgFind->second;
-            image->freeTimer = image->maxFreeTime;
-            SDL_RendererFlip flip = SDL_FLIP_NONE;
+            AssetCache::touch(image->cacheEntry);
+            bool flip = false;
             image->setScale((currentSprite->size * 0.01) * scale / 2.0f);
-            currentSprite->spriteWidth = image->textureRect.w / 2;
-            currentSprite->spriteHeight = image->textureRect.h / 2;
+            SpatialGrid::setSpriteSize(currentSprite, image->width / 2, image->height / 2);
 
             // double the image scale if the image is an SVG
-            if (currentSprite->costumes[currentSprite->currentCostume].isSVG) {
+            if (costume->isSVG) {
                 image->setScale(image->scale * 2);
             }
+            if (!image->svgId.empty()) {
+                if (image->wantedScale == 0.0) drawnSVGs.push_back(image);
+                image->wantedScale = std::max(image->wantedScale, static_cast<double>(image->scale));
+            }
 
             const double rotation = Math::degreesToRadians(currentSprite->rotation - 90.0f);
             double renderRotation = rotation;
             if (currentSprite->rotationStyle == currentSprite->LEFT_RIGHT) {
                 if (std::cos(rotation) < 0) {
-                    flip = SDL_FLIP_HORIZONTAL;
+                    flip = true;
                 }
                 renderRotation = 0;
             }
@@ -353,50 +461,30 @@ void Render::renderSprites() {
             const double offsetY = rotationCenterY * (currentSprite->size * 0.01);
             image->renderRect.x = ((currentSprite->xPosition * scale) + (windowWidth / 2) - (image->renderRect.w / 2)) - offsetX * std::cos(rotation) + offsetY * std::sin(renderRotation);
             image->renderRect.y = ((currentSprite->yPosition * -scale) + (windowHeight / 2) - (image->renderRect.h / 2)) - offsetX * std::sin(rotation) - offsetY * std::cos(renderRotation);
-            SDL_Point center = {image->renderRect.w / 2, image->renderRect.h / 2};
 
             // set ghost effect
             float ghost = std::clamp(currentSprite->ghostEffect, 0.0f, 100.0f);
             Uint8 alpha = static_cast<Uint8>(255 * (1.0f - ghost / 100.0f));
-            SDL_SetTextureAlphaMod(image->spriteTexture, alpha);
+            SDL_Color color = {255, 255, 255, alpha};
 
             // set brightness effect
-            if (currentSprite->brightnessEffect != 0) {
-                float brightness = currentSprite->brightnessEffect * 0.01f;
-
-                // TODO: find a better way to do this because i hate this
-                if (brightness > 0.0f) {
-                    // render the normal image first
-                    SDL_RenderCopyEx(renderer, image->spriteTexture, &image->textureRect, &image->renderRect,
-                                     Math::radiansToDegrees(renderRotation), &center, flip);
-
-                    // render another, blended image on top
-                    SDL_SetTextureBlendMode(image->spriteTexture, SDL_BLENDMODE_ADD);
-                    SDL_SetTextureAlphaMod(image->spriteTexture, (Uint8)(brightness * 255 * (alpha / 255.0f)));
-                    SDL_RenderCopyEx(renderer, image->spriteTexture, &image->textureRect, &image->renderRect,
-                                     Math::radiansToDegrees(renderRotation), &center, flip);
-
-                    // reset for next frame
-                    SDL_SetTextureBlendMode(image->spriteTexture, SDL_BLENDMODE_BLEND);
-                } else {
-                    // darkening is quite shrimple really
-                    Uint8 col = static_cast<Uint8>(255 * (1.0f + brightness));
-                    SDL_SetTextureColorMod(image->spriteTexture, col, col, col);
-
-                    SDL_RenderCopyEx(renderer, image->spriteTexture, &image->textureRect, &image->renderRect,
-                                     Math::radiansToDegrees(renderRotation), &center, flip);
-                    // reset for next frame
-                    SDL_SetTextureColorMod(image->spriteTexture, 255, 255, 255);
-                }
-            } else {
-                // if no brightness just render normal image
-                SDL_SetTextureColorMod(image->spriteTexture, 255, 255, 255);
-                SDL_RenderCopyEx(renderer, image->spriteTexture, &image->textureRect, &image->renderRect,
-                                 Math::radiansToDegrees(renderRotation), &center, flip);
+            float brightness = currentSprite->brightnessEffect * 0.01f;
+            if (brightness < 0.0f) {
+                // darkening is quite shrimple really
+                Uint8 col = static_cast<Uint8>(255 * (1.0f + brightness));
+                color = {col, col, col, alpha};
+            }
+            spriteBatch.add(image->spriteTexture, SDL_BLENDMODE_BLEND, image, renderRotation, flip, color);
+
+            // TODO: find a better way to do this because i hate this
+            if (brightness > 0.0f) {
+                // render another, blended image on top
+                SDL_Color added = {255, 255, 255, static_cast<Uint8>(brightness * 255 * (alpha / 255.0f))};
+                spriteBatch.add(image->spriteTexture, SDL_BLENDMODE_ADD, image, renderRotation, flip, added);
             }
         } else {
-            currentSprite->spriteWidth = 64;
-            currentSprite->spriteHeight = 64;
+            SpatialGrid::setSpriteSize(currentSprite, 64, 64);
+            spriteBatch.flush();
             SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
             SDL_Rect rect;
             rect.x = (currentSprite->xPosition * scale) + (windowWidth / 2);
@@ -423,9 +511,16 @@ void Render::renderSprites() {
         //     SDL_RenderFillRect(renderer, &debugPointRect);
         // }
     }
+    spriteBatch.flush();
+
+    // nothing is waiting to be drawn with the old textures anymore, so SVGs can swap resolutions
+    for (SDL_Image *image : drawnSVGs) {
+        image->updateResolution();
+    }
 
     drawBlackBars(windowWidth, windowHeight);
     renderVisibleVariables();
+    PerfOverlay::render();
 
     SDL_RenderPresent(renderer);
     Image::FlushImages();
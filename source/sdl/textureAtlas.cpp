@@ -0,0 +1,173 @@
+#include "textureAtlas.hpp"
+#include "os.hpp"
+#include "render.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// a transparent pixel around every image, so filtering never picks up its neighbours
+const int padding = 1;
+// shelf heights get rounded up to this, so similar sized images share shelves
+const int shelfStep = 8;
+
+struct Slot {
+    int x;
+    int width;
+};
+
+struct Shelf {
+    int y;
+    int height;
+    int nextX = 0;               // where the unused part of the shelf starts
+    std::vector<Slot> freeSlots; // space left by removed images, before `nextX`
+};
+
+struct Page {
+    SDL_Texture *texture = nullptr;
+    std::vector<Shelf> shelves;
+    int nextShelfY = 0;
+    size_t imageCount = 0;
+};
+
+std::vector<std::unique_ptr<Page>> pages;
+
+/**
+ * Finds room for a `width` by `height` block on a page.
+ * @return `false` if the page is full.
+ */
+bool allocate(Page &page, int width, int height, int &shelfIndex, int &slotX) {
+    // the shortest shelf the block fits in wastes the least space
+    int best = -1;
+    for (size_t i = 0; i < page.shelves.size(); i++) {
+        const Shelf &shelf = page.shelves[i];
+        if (shelf.height < height || (best >= 0 && shelf.height >= page.shelves[best].height)) continue;
+        bool hasRoom = shelf.nextX + width <= TextureAtlas::PAGE_SIZE;
+        for (const Slot &slot : shelf.freeSlots) {
+            hasRoom = hasRoom || slot.width >= width;
+        }
+        if (hasRoom) best = static_cast<int>(i);
+    }
+
+    if (best < 0) {
+        const int shelfHeight = std::min((height + shelfStep - 1) / shelfStep * shelfStep, TextureAtlas::PAGE_SIZE);
+        if (page.nextShelfY + shelfHeight > TextureAtlas::PAGE_SIZE) return false;
+        page.shelves.push_back({page.nextShelfY, shelfHeight});
+        page.nextShelfY += shelfHeight;
+        best = static_cast<int>(page.shelves.size()) - 1;
+    }
+
+    Shelf &shelf = page.shelves[best];
+    shelfIndex = best;
+    for (size_t i = 0; i < shelf.freeSlots.size(); i++) {
+        Slot &slot = shelf.freeSlots[i];
+        if (slot.width < width) continue;
+        slotX = slot.x;
+        // keep whatever the block doesn't use for the next one
+        slot.x += width;
+        slot.width -= width;
+        if (slot.width == 0) shelf.freeSlots.erase(shelf.freeSlots.begin() + i);
+        return true;
+    }
+    slotX = shelf.nextX;
+    shelf.nextX += width;
+    return true;
+}
+
+Page *createPage() {
+    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
+                                             TextureAtlas::PAGE_SIZE, TextureAtlas::PAGE_SIZE);
+    if (!texture) {
+        Log::logWarning(std::string("Could not create texture atlas page: ") + SDL_GetError());
+        return nullptr;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    auto page = std::make_unique<Page>();
+    page->texture = texture;
+    for (auto &slot : pages) {
+        if (!slot) {
+            slot = std::move(page);
+            return slot.get();
+        }
+    }
+    pages.push_back(std::move(page));
+    return pages.back().get();
+}
+
+} // namespace
+
+bool TextureAtlas::add(SDL_Surface *surface, Region &region) {
+    if (!surface || surface->w > MAX_IMAGE_SIZE || surface->h > MAX_IMAGE_SIZE) return false;
+    const int width = surface->w + padding * 2;
+    const int height = surface->h + padding * 2;
+
+    Page *page = nullptr;
+    int shelfIndex = -1;
+    int slotX = 0;
+    for (auto &candidate : pages) {
+        if (candidate && allocate(*candidate, width, height, shelfIndex, slotX)) {
+            page = candidate.get();
+            break;
+        }
+    }
+    if (!page) {
+        page = createPage();
+        if (!page || !allocate(*page, width, height, shelfIndex, slotX)) return false;
+    }
+
+    SDL_Surface *rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    if (!rgba) {
+        page->shelves[shelfIndex].freeSlots.push_back({slotX, width});
+        return false;
+    }
+
+    // upload the image with its transparent border, since the page starts out with undefined pixels
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4, 0);
+    SDL_LockSurface(rgba);
+    for (int y = 0; y < rgba->h; y++) {
+        memcpy(&pixels[(static_cast<size_t>(y + padding) * width + padding) * 4],
+               static_cast<const unsigned char *>(rgba->pixels) + static_cast<size_t>(y) * rgba->pitch, static_cast<size_t>(rgba->w) * 4);
+    }
+    SDL_UnlockSurface(rgba);
+    SDL_FreeSurface(rgba);
+
+    const Shelf &shelf = page->shelves[shelfIndex];
+    const SDL_Rect uploadRect = {slotX, shelf.y, width, height};
+    SDL_UpdateTexture(page->texture, &uploadRect, pixels.data(), width * 4);
+    page->imageCount++;
+
+    region.texture = page->texture;
+    region.rect = {slotX + padding, shelf.y + padding, surface->w, surface->h};
+    region.page = static_cast<int>(std::find_if(pages.begin(), pages.end(), [page](const auto &p) { return p.get() == page; }) - pages.begin());
+    region.shelf = shelfIndex;
+    region.slotX = slotX;
+    region.slotWidth = width;
+    return true;
+}
+
+void TextureAtlas::remove(const Region &region) {
+    if (!region.texture || region.page < 0 || static_cast<size_t>(region.page) >= pages.size()) return;
+    std::unique_ptr<Page> &page = pages[region.page];
+    if (!page || page->texture != region.texture) return;
+
+    if (--page->imageCount == 0) {
+        // nothing left on the page, so give its memory back instead of keeping a fragmented page around
+        SDL_DestroyTexture(page->texture);
+        page.reset();
+        return;
+    }
+
+    Shelf &shelf = page->shelves[region.shelf];
+    if (region.slotX + region.slotWidth == shelf.nextX) {
+        shelf.nextX = region.slotX;
+    } else {
+        shelf.freeSlots.push_back({region.slotX, region.slotWidth});
+    }
+}
+
+size_t TextureAtlas::getPageCount() {
+    return std::count_if(pages.begin(), pages.end(), [](const auto &page) { return page != nullptr; });
+}
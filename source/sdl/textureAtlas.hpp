@@ -0,0 +1,54 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstddef>
+
+/**
+ * Packs small costumes into a few large textures ("pages"), so sprites wearing different costumes
+ * can still be drawn in one batch, and tiny costumes don't each pay for a texture of their own.
+ * Pages are split into shelves, rows as tall as the first image put in them, filled left to right.
+ * Removed images leave a slot that later images of the same shelf can reuse, and a page whose
+ * images are all gone gets destroyed, so the next images start on a clean page.
+ */
+class TextureAtlas {
+  public:
+    /**
+     * Width and height of a page, small enough for every platform's texture size limit.
+     */
+    static constexpr int PAGE_SIZE = 1024;
+
+    /**
+     * Images wider or taller than this get their own texture instead.
+     */
+    static constexpr int MAX_IMAGE_SIZE = 256;
+
+    /**
+     * Where an image lives in the atlas.
+     */
+    struct Region {
+        SDL_Texture *texture = nullptr; // the page, or `nullptr` if the image isn't in the atlas
+        SDL_Rect rect = {0, 0, 0, 0};   // the image's pixels on the page
+        int page = -1;
+        int shelf = -1;
+        int slotX = 0;
+        int slotWidth = 0; // including the transparent border around the image
+    };
+
+    /**
+     * Copies an image into the atlas.
+     * @param surface the decoded image
+     * @param region set to where the image went
+     * @return `false` if the image is too big or no page could be made, in which case it needs its own texture.
+     */
+    static bool add(SDL_Surface *surface, Region &region);
+
+    /**
+     * Frees an image's spot in the atlas.
+     * @param region the region `add()` gave the image
+     */
+    static void remove(const Region &region);
+
+    /**
+     * Gets how many pages currently exist.
+     */
+    static size_t getPageCount();
+};
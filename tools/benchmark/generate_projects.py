@@ -0,0 +1,689 @@
+#!/usr/bin/env python3
+"""
+Generates the synthetic benchmark projects used by run_benchmarks.py.
+
+Each project stresses one part of the interpreter. The output is fully
+deterministic (fixed ids, fixed zip timestamps) so the same generator always
+produces byte-identical .sb3 files and the state hashes stay comparable.
+
+    python3 tools/benchmark/generate_projects.py [output folder]
+"""
+
+import hashlib
+import json
+import os
+import struct
+import sys
+import zipfile
+import zlib
+
+ZIP_DATE = (2020, 1, 1, 0, 0, 0)
+
+
+# ---------- assets ----------
+
+def make_svg(width, height, color):
+    return ('<svg xmlns="http://www.w3.org/2000/svg" width="%d" height="%d" viewBox="0 0 %d %d">'
+            '<rect width="%d" height="%d" fill="%s"/></svg>' % (width, height, width, height, width, height, color)).encode()
+
+
+def make_png(width, height, rgb):
+    """Solid color RGBA png with a transparent 2px border."""
+    rows = b""
+    for y in range(height):
+        row = b"\x00"
+        for x in range(width):
+            border = x < 2 or y < 2 or x >= width - 2 or y >= height - 2
+            row += bytes(rgb) + (b"\x00" if border else b"\xff")
+        rows += row
+
+    def chunk(kind, data):
+        return struct.pack(">I", len(data)) + kind + data + struct.pack(">I", zlib.crc32(kind + data) & 0xFFFFFFFF)
+
+    header = struct.pack(">IIBBBBB", width, height, 8, 6, 0, 0, 0)
+    return b"\x89PNG\r\n\x1a\n" + chunk(b"IHDR", header) + chunk(b"IDAT", zlib.compress(rows, 9)) + chunk(b"IEND", b"")
+
+
+class Asset:
+    def __init__(self, name, data, data_format, width, height):
+        self.name = name
+        self.data = data
+        self.data_format = data_format
+        self.md5 = hashlib.md5(data).hexdigest()
+        self.width = width
+        self.height = height
+
+    def costume_json(self):
+        bitmap = self.data_format != "svg"
+        return {
+            "name": self.name,
+            "assetId": self.md5,
+            "md5ext": self.md5 + "." + self.data_format,
+            "dataFormat": self.data_format,
+            "bitmapResolution": 2 if bitmap else 1,
+            "rotationCenterX": self.width // 2,
+            "rotationCenterY": self.height // 2,
+        }
+
+
+def svg_costume(name, width, height, color):
+    return Asset(name, make_svg(width, height, color), "svg", width, height)
+
+
+def png_costume(name, width, height, rgb):
+    return Asset(name, make_png(width, height, rgb), "png", width, height)
+
+
+# ---------- project building ----------
+
+def num(value):
+    return [1, [4, str(value)]]
+
+
+def text(value):
+    return [1, [10, str(value)]]
+
+
+def reporter(block_id):
+    return [3, block_id, [10, ""]]
+
+
+def boolean(block_id):
+    return [2, block_id]
+
+
+def substack(block_id):
+    return [2, block_id]
+
+
+def menu(block_id):
+    return [1, block_id]
+
+
+class Target:
+    def __init__(self, project, name, is_stage=False):
+        self.project = project
+        self.name = name
+        self.is_stage = is_stage
+        self.blocks = {}
+        self.variables = {}
+        self.lists = {}
+        self.broadcasts = {}
+        self.comments = {}
+        self.costumes = []
+        self.x = 0
+        self.y = 0
+        self.size = 100
+        self.direction = 90
+        self.visible = True
+
+    def _id(self):
+        return self.project.next_id()
+
+    def variable(self, name, value=0):
+        var_id = "var-" + self.name + "-" + name
+        self.variables[var_id] = [name, value]
+        return [name, var_id]
+
+    def list(self, name, items=None):
+        list_id = "list-" + self.name + "-" + name
+        self.lists[list_id] = [name, items or []]
+        return [name, list_id]
+
+    def block(self, opcode, inputs=None, fields=None, shadow=False, mutation=None):
+        block_id = self._id()
+        inputs = inputs or {}
+        block = {
+            "opcode": opcode,
+            "next": None,
+            "parent": None,
+            "inputs": inputs,
+            "fields": fields or {},
+            "shadow": shadow,
+            "topLevel": False,
+        }
+        if mutation is not None:
+            block["mutation"] = mutation
+        self.blocks[block_id] = block
+        for value in inputs.values():
+            if value[0] in (2, 3) and isinstance(value[1], str):
+                self.blocks[value[1]]["parent"] = block_id
+            elif value[0] == 1 and isinstance(value[1], str):
+                self.blocks[value[1]]["parent"] = block_id
+        return block_id
+
+    def chain(self, *block_ids):
+        """Links blocks into a stack and returns the first one."""
+        for previous, current in zip(block_ids, block_ids[1:]):
+            self.blocks[previous]["next"] = current
+            self.blocks[current]["parent"] = previous
+        return block_ids[0]
+
+    def script(self, hat, *block_ids):
+        self.blocks[hat]["topLevel"] = True
+        self.blocks[hat]["x"] = 0
+        self.blocks[hat]["y"] = 0
+        if block_ids:
+            self.chain(hat, *block_ids)
+        return hat
+
+    # --- common blocks ---
+
+    def when_flag(self):
+        return self.block("event_whenflagclicked")
+
+    def when_clone(self):
+        return self.block("control_start_as_clone")
+
+    def when_receive(self, message):
+        return self.block("event_whenbroadcastreceived", fields={"BROADCAST_OPTION": [message, self.project.broadcast_id(message)]})
+
+    def broadcast(self, message):
+        return self.block("event_broadcast", {"BROADCAST_INPUT": [1, [11, message, self.project.broadcast_id(message)]]})
+
+    def forever(self, *body):
+        return self.block("control_forever", {"SUBSTACK": substack(self.chain(*body))})
+
+    def repeat(self, times, *body):
+        return self.block("control_repeat", {"TIMES": num(times), "SUBSTACK": substack(self.chain(*body))})
+
+    def if_then(self, condition, *body):
+        return self.block("control_if", {"CONDITION": boolean(condition), "SUBSTACK": substack(self.chain(*body))})
+
+    def set_var(self, var, value):
+        return self.block("data_setvariableto", {"VALUE": value}, {"VARIABLE": var})
+
+    def change_var(self, var, value):
+        return self.block("data_changevariableby", {"VALUE": value}, {"VARIABLE": var})
+
+    def var(self, var):
+        return [3, [12, var[0], var[1]], [10, ""]]
+
+    def op(self, opcode, a, b, names=("NUM1", "NUM2")):
+        return self.block(opcode, {names[0]: a, names[1]: b})
+
+    def create_clone(self):
+        option = self.block("control_create_clone_of_menu", fields={"CLONE_OPTION": ["_myself_", None]}, shadow=True)
+        return self.block("control_create_clone_of", {"CLONE_OPTION": menu(option)})
+
+    def touching(self, sprite_name):
+        option = self.block("sensing_touchingobjectmenu", fields={"TOUCHINGOBJECTMENU": [sprite_name, None]}, shadow=True)
+        return self.block("sensing_touchingobject", {"TOUCHINGOBJECTMENU": menu(option)})
+
+    def define(self, proccode, argument_names, warp):
+        """Adds a custom block definition and returns (definition id, argument ids)."""
+        argument_ids = ["arg-%s-%d" % (self._id(), i) for i in range(len(argument_names))]
+        argument_inputs = {}
+        for argument_id, name in zip(argument_ids, argument_names):
+            reporter_id = self.block("argument_reporter_string_number", fields={"VALUE": [name, None]}, shadow=True)
+            argument_inputs[argument_id] = [1, reporter_id]
+        prototype = self.block("procedures_prototype", argument_inputs, shadow=True, mutation={
+            "tagName": "mutation",
+            "children": [],
+            "proccode": proccode,
+            "argumentids": json.dumps(argument_ids),
+            "argumentnames": json.dumps(list(argument_names)),
+            "argumentdefaults": json.dumps(["" for _ in argument_names]),
+            "warp": "true" if warp else "false",
+        })
+        definition = self.block("procedures_definition", {"custom_block": [1, prototype]})
+        return definition, argument_ids
+
+    def call(self, proccode, argument_ids, values, warp):
+        inputs = {argument_id: value for argument_id, value in zip(argument_ids, values)}
+        return self.block("procedures_call", inputs, mutation={
+            "tagName": "mutation",
+            "children": [],
+            "proccode": proccode,
+            "argumentids": json.dumps(argument_ids),
+            "warp": "true" if warp else "false",
+        })
+
+    def argument(self, name):
+        return self.block("argument_reporter_string_number", fields={"VALUE": [name, None]})
+
+    def to_json(self, layer):
+        data = {
+            "isStage": self.is_stage,
+            "name": self.name,
+            "variables": self.variables,
+            "lists": self.lists,
+            "broadcasts": self.broadcasts,
+            "blocks": self.blocks,
+            "comments": self.comments,
+            "currentCostume": 0,
+            "costumes": [costume.costume_json() for costume in self.costumes],
+            "sounds": [],
+            "volume": 100,
+            "layerOrder": layer,
+        }
+        if self.is_stage:
+            data.update({"tempo": 60, "videoTransparency": 50, "videoState": "on", "textToSpeechLanguage": None})
+        else:
+            data.update({"visible": self.visible, "x": self.x, "y": self.y, "size": self.size,
+                         "direction": self.direction, "draggable": False, "rotationStyle": "all around"})
+        return data
+
+
+class Project:
+    def __init__(self):
+        self._next_id = 0
+        self.stage = Target(self, "Stage", is_stage=True)
+        self.stage.costumes.append(svg_costume("backdrop", 480, 360, "#ffffff"))
+        self.sprites = []
+
+    def next_id(self):
+        self._next_id += 1
+        return "b%d" % self._next_id
+
+    def broadcast_id(self, message):
+        broadcast_id = "broadcast-" + message
+        self.stage.broadcasts[broadcast_id] = message
+        return broadcast_id
+
+    def runtime_options(self, **options):
+        """Adds a TurboWarp settings comment to the stage, the same way TurboWarp stores them."""
+        config = {"framerate": 30, "runtimeOptions": options}
+        self.stage.comments["config"] = {
+            "blockId": None, "x": 0, "y": 0, "width": 350, "height": 170, "minimized": False,
+            "text": "Configuration for https://turbowarp.org/\nYou can move, resize, and minimize this comment, "
+                    "but don't edit it by hand. This comment can be deleted to remove the stored settings.\n"
+                    + json.dumps(config, sort_keys=True) + " // _twconfig_",
+        }
+
+    def sprite(self, name, costumes=None):
+        target = Target(self, name)
+        target.costumes = costumes or [svg_costume("costume", 40, 40, "#4c97ff")]
+        self.sprites.append(target)
+        return target
+
+    def write(self, path):
+        targets = [self.stage.to_json(0)] + [sprite.to_json(i + 1) for i, sprite in enumerate(self.sprites)]
+        project = {"targets": targets, "monitors": [], "extensions": [],
+                   "meta": {"semver": "3.0.0", "vm": "0.2.0", "agent": "benchmark generator"}}
+
+        assets = {}
+        for target in [self.stage] + self.sprites:
+            for costume in target.costumes:
+                assets[costume.md5 + "." + costume.data_format] = costume.data
+
+        with zipfile.ZipFile(path, "w", zipfile.ZIP_DEFLATED) as archive:
+            def add(name, data):
+                info = zipfile.ZipInfo(name, ZIP_DATE)
+                # formats that are compressed already get stored as they are, like most .sb3 exports do
+                stored = name.endswith((".png", ".wav", ".mp3"))
+                info.compress_type = zipfile.ZIP_STORED if stored else zipfile.ZIP_DEFLATED
+                archive.writestr(info, data)
+
+            add("project.json", json.dumps(project, sort_keys=True))
+            for name in sorted(assets):
+                add(name, assets[name])
+
+
+# ---------- benchmarks ----------
+
+def arithmetic():
+    """Tight arithmetic in a warp custom block, 500 iterations per tick."""
+    project = Project()
+    stage = project.stage
+    a = stage.variable("a", 1)
+    total = stage.variable("total", 0)
+
+    sprite = project.sprite("Cruncher")
+    definition, _ = sprite.define("crunch", [], warp=True)
+    step = sprite.set_var(a, reporter(sprite.op("operator_mod",
+                                                 reporter(sprite.op("operator_add",
+                                                                    reporter(sprite.op("operator_multiply", sprite.var(a), num(31))),
+                                                                    num(7))),
+                                                 num(1009))))
+    accumulate = sprite.change_var(total, reporter(sprite.op("operator_divide", sprite.var(a), num(3))))
+    sprite.script(definition, sprite.repeat(500, step, accumulate))
+    sprite.script(sprite.when_flag(), sprite.forever(sprite.call("crunch", [], [], warp=True)))
+    return project
+
+
+def recursion():
+    """A custom block calling itself 200 levels deep, ten times a tick, all without screen refresh."""
+    project = Project()
+    depth = project.stage.variable("depth", 0)
+    calls = project.stage.variable("calls", 0)
+
+    sprite = project.sprite("Recurser")
+    definition, argument_ids = sprite.define("recurse %s", ["n"], warp=True)
+    recursive_call = sprite.call("recurse %s", argument_ids,
+                                 [reporter(sprite.op("operator_subtract", reporter(sprite.argument("n")), num(1)))], warp=True)
+    body = sprite.if_then(sprite.op("operator_gt", reporter(sprite.argument("n")), num(0), ("OPERAND1", "OPERAND2")),
+                          sprite.change_var(depth, num(1)), recursive_call)
+    sprite.script(definition, body)
+
+    run, _ = sprite.define("run", [], warp=True)
+    sprite.script(run, sprite.repeat(10,
+                                     sprite.set_var(depth, num(0)),
+                                     sprite.call("recurse %s", argument_ids, [num(200)], warp=True)))
+    sprite.script(sprite.when_flag(), sprite.forever(
+        sprite.call("run", [], [], warp=True),
+        sprite.change_var(calls, num(1))))
+    return project
+
+
+def recursion_refresh():
+    """A custom block calling itself 100 levels deep once a tick, with screen refresh, counting each level as it returns."""
+    project = Project()
+    depth = project.stage.variable("depth", 0)
+    returns = project.stage.variable("returns", 0)
+    calls = project.stage.variable("calls", 0)
+
+    sprite = project.sprite("Climber")
+    definition, argument_ids = sprite.define("climb %s", ["n"], warp=False)
+    recursive_call = sprite.call("climb %s", argument_ids,
+                                 [reporter(sprite.op("operator_subtract", reporter(sprite.argument("n")), num(1)))], warp=False)
+    body = sprite.if_then(sprite.op("operator_gt", reporter(sprite.argument("n")), num(0), ("OPERAND1", "OPERAND2")),
+                          sprite.change_var(depth, num(1)), recursive_call, sprite.change_var(returns, num(1)))
+    sprite.script(definition, body)
+
+    sprite.script(sprite.when_flag(), sprite.forever(
+        sprite.call("climb %s", argument_ids, [num(100)], warp=False),
+        sprite.change_var(calls, num(1))))
+    return project
+
+
+def clones():
+    """2000 moving, bouncing clones, all created on the first tick."""
+    project = Project()
+    project.runtime_options(maxClones=1000000)
+    moves = project.stage.variable("moves", 0)
+
+    sprite = project.sprite("Bouncer")
+    sprite.size = 50
+    definition, _ = sprite.define("spawn", [], warp=True)
+    sprite.script(definition, sprite.repeat(2000, sprite.create_clone(), sprite.block("motion_turnright", {"DEGREES": num(37)})))
+    sprite.script(sprite.when_flag(), sprite.call("spawn", [], [], warp=True))
+    sprite.script(sprite.when_clone(), sprite.forever(
+        sprite.block("motion_movesteps", {"STEPS": num(4)}),
+        sprite.block("motion_ifonedgebounce"),
+        sprite.change_var(moves, num(1))))
+    return project
+
+
+def lists():
+    """List add/insert/search/replace on a list that grows to 3000 items."""
+    project = Project()
+    counter = project.stage.variable("counter", 0)
+    found = project.stage.variable("found", 0)
+
+    sprite = project.sprite("Lister")
+    items = sprite.list("items")
+
+    def list_block(opcode, inputs):
+        return sprite.block(opcode, inputs, {"LIST": items})
+
+    definition, _ = sprite.define("work", [], warp=True)
+    body = sprite.repeat(50,
+                         sprite.change_var(counter, num(1)),
+                         list_block("data_addtolist", {"ITEM": [3, [12, counter[0], counter[1]], [10, ""]]}),
+                         list_block("data_insertatlist", {"ITEM": text("front"), "INDEX": num(1)}),
+                         sprite.set_var(found, reporter(list_block("data_itemnumoflist", {"ITEM": [3, [12, counter[0], counter[1]], [10, ""]]}))),
+                         list_block("data_replaceitemoflist", {"INDEX": num(2), "ITEM": sprite.var(found)}))
+    trim = sprite.if_then(sprite.op("operator_gt", reporter(list_block("data_lengthoflist", {})), num(3000), ("OPERAND1", "OPERAND2")),
+                          list_block("data_deletealloflist", {}))
+    sprite.script(definition, body, trim)
+    sprite.script(sprite.when_flag(), sprite.forever(sprite.call("work", [], [], warp=True)))
+    return project
+
+
+def broadcasts():
+    """Ten broadcasts a tick to many receivers, some of which broadcast again."""
+    project = Project()
+    pings = project.stage.variable("pings", 0)
+    pongs = project.stage.variable("pongs", 0)
+
+    stage = project.stage
+    stage.script(stage.when_flag(), stage.forever(*[stage.broadcast("ping") for _ in range(10)]))
+    for i in range(8):
+        sprite = project.sprite("Receiver%d" % i)
+        sprite.x = i * 20 - 80
+        sprite.script(sprite.when_receive("ping"), sprite.change_var(pings, num(1)))
+        sprite.script(sprite.when_receive("ping"), sprite.block("motion_turnright", {"DEGREES": num(1)}))
+        if i % 2 == 0:
+            sprite.script(sprite.when_receive("ping"), sprite.broadcast("pong"))
+        sprite.script(sprite.when_receive("pong"), sprite.change_var(pongs, num(1)))
+    return project
+
+
+def messages():
+    """Forty different broadcasts a tick to many receivers, some of which broadcast again.
+
+    The messages all differ, since repeats of one message within a tick only start its receivers once.
+    """
+    project = Project()
+    pings = project.stage.variable("pings", 0)
+    pongs = project.stage.variable("pongs", 0)
+
+    stage = project.stage
+    stage.script(stage.when_flag(), stage.forever(*[stage.broadcast("ping%d" % i) for i in range(40)]))
+    for i in range(8):
+        sprite = project.sprite("Receiver%d" % i)
+        sprite.x = i * 20 - 80
+        for message in range(40):
+            sprite.script(sprite.when_receive("ping%d" % message), sprite.change_var(pings, num(1)))
+            if message % 4 == i % 4:
+                sprite.script(sprite.when_receive("ping%d" % message), sprite.broadcast("pong%d" % i))
+        sprite.script(sprite.when_receive("pong%d" % i), sprite.block("motion_turnright", {"DEGREES": num(1)}),
+                      sprite.change_var(pongs, num(1)))
+    return project
+
+
+def touching():
+    """100 clones checking `touching` against a target sprite every tick."""
+    project = Project()
+    hits = project.stage.variable("hits", 0)
+
+    target = project.sprite("Target", [svg_costume("target", 120, 120, "#ff0000")])
+    target.script(target.when_flag(), target.forever(target.block("motion_turnright", {"DEGREES": num(3)})))
+
+    sprite = project.sprite("Seeker", [svg_costume("seeker", 24, 24, "#00aa00")])
+    sprite.x = -150
+    sprite.script(sprite.when_flag(), sprite.repeat(100, sprite.create_clone(), sprite.block("motion_turnright", {"DEGREES": num(13)})))
+    sprite.script(sprite.when_clone(), sprite.forever(
+        sprite.block("motion_movesteps", {"STEPS": num(5)}),
+        sprite.block("motion_ifonedgebounce"),
+        sprite.if_then(sprite.touching("Target"), sprite.change_var(hits, num(1)))))
+    return project
+
+
+def costumes():
+    """60 clones cycling through a mix of svg and bitmap costumes every tick."""
+    project = Project()
+    switches = project.stage.variable("switches", 0)
+
+    palette = ["#ff0000", "#00ff00", "#0000ff", "#ffff00"]
+    costume_list = []
+    for i in range(8):
+        if i % 2 == 0:
+            costume_list.append(svg_costume("svg%d" % i, 30 + i * 6, 30 + i * 4, palette[i % 4]))
+        else:
+            costume_list.append(png_costume("png%d" % i, 40 + i * 8, 40 + i * 6, (40 * i % 256, 200, 90)))
+
+    sprite = project.sprite("Flipper", costume_list)
+    sprite.script(sprite.when_flag(), sprite.repeat(60, sprite.create_clone(), sprite.block("motion_movesteps", {"STEPS": num(6)})))
+    sprite.script(sprite.when_clone(), sprite.forever(
+        sprite.block("looks_nextcostume"),
+        sprite.change_var(switches, num(1))))
+    return project
+
+
+def waits():
+    """1000 clones that spend most of their time in `wait` blocks, waking up every few seconds."""
+    project = Project()
+    project.runtime_options(maxClones=1000000)
+    wakes = project.stage.variable("wakes", 0)
+
+    sprite = project.sprite("Sleeper")
+    definition, _ = sprite.define("spawn", [], warp=True)
+    sprite.script(definition, sprite.repeat(1000, sprite.create_clone()))
+    sprite.script(sprite.when_flag(), sprite.call("spawn", [], [], warp=True))
+    duration = reporter(sprite.op("operator_random", num(0.5), num(3), ("FROM", "TO")))
+    sprite.script(sprite.when_clone(), sprite.forever(
+        sprite.block("control_wait", {"DURATION": duration}),
+        sprite.block("motion_turnright", {"DEGREES": num(15)}),
+        sprite.change_var(wakes, num(1))))
+    return project
+
+
+def swarm():
+    """300 bullet clones checking `touching` against 300 enemy clones spread over the stage every tick."""
+    project = Project()
+    project.runtime_options(maxClones=1000000)
+    hits = project.stage.variable("hits", 0)
+
+    def scatter(sprite):
+        option = sprite.block("motion_goto_menu", fields={"TO": ["_random_", None]}, shadow=True)
+        return sprite.block("motion_goto", {"TO": menu(option)})
+
+    enemy = project.sprite("Enemy", [svg_costume("enemy", 16, 16, "#ff0000")])
+    definition, _ = enemy.define("spawn", [], warp=True)
+    enemy.script(definition, enemy.repeat(300, enemy.create_clone(), enemy.block("motion_turnright", {"DEGREES": num(37)})))
+    enemy.script(enemy.when_flag(), enemy.call("spawn", [], [], warp=True))
+    enemy.script(enemy.when_clone(), scatter(enemy), enemy.forever(
+        enemy.block("motion_movesteps", {"STEPS": num(1)}),
+        enemy.block("motion_ifonedgebounce")))
+
+    bullet = project.sprite("Bullet", [svg_costume("bullet", 8, 8, "#000000")])
+    definition, _ = bullet.define("spawn", [], warp=True)
+    bullet.script(definition, bullet.repeat(300, bullet.create_clone(), bullet.block("motion_turnright", {"DEGREES": num(23)})))
+    bullet.script(bullet.when_flag(), bullet.call("spawn", [], [], warp=True))
+    bullet.script(bullet.when_clone(), scatter(bullet), bullet.forever(
+        bullet.block("motion_movesteps", {"STEPS": num(4)}),
+        bullet.block("motion_ifonedgebounce"),
+        bullet.if_then(bullet.touching("Enemy"), bullet.change_var(hits, num(1)))))
+    return project
+
+
+def sprites():
+    """600 visible clones of two sprites turning every tick, some of them with ghost or brightness effects.
+
+    The headless build only measures the logic side of this one. To see draw calls and frame time,
+    run the generated project in an SDL build with "BenchmarkTicks" set in Settings.json.
+    """
+    project = Project()
+    project.runtime_options(maxClones=1000000)
+    turns = project.stage.variable("turns", 0)
+
+    for name, color, steps in (("Star", "#ffcc00", 3), ("Rock", "#8a6d4b", 2)):
+        sprite = project.sprite(name, [svg_costume(name.lower(), 24, 24, color)])
+        index = sprite.variable("index", 0)
+        definition, _ = sprite.define("spawn", [], warp=True)
+        sprite.script(definition, sprite.repeat(300,
+            sprite.change_var(index, num(1)),
+            sprite.create_clone(),
+            sprite.block("motion_movesteps", {"STEPS": num(7)}),
+            sprite.block("motion_turnright", {"DEGREES": num(41)})))
+        sprite.script(sprite.when_flag(), sprite.call("spawn", [], [], warp=True))
+
+        def every(n):
+            remainder = reporter(sprite.op("operator_mod", sprite.var(index), num(n)))
+            return sprite.op("operator_equals", remainder, num(0), ("OPERAND1", "OPERAND2"))
+
+        def effect(name, value):
+            return sprite.block("looks_seteffectto", {"VALUE": num(value)}, {"EFFECT": [name, None]})
+
+        sprite.script(sprite.when_clone(),
+            sprite.if_then(every(5), effect("GHOST", 50)),
+            sprite.if_then(every(7), effect("BRIGHTNESS", 40)),
+            sprite.forever(
+                sprite.block("motion_movesteps", {"STEPS": num(steps)}),
+                sprite.block("motion_ifonedgebounce"),
+                sprite.block("motion_turnright", {"DEGREES": num(3)}),
+                sprite.change_var(turns, num(1))))
+    return project
+
+
+def batching():
+    """800 visible clones of one sprite turning every tick, with no effects, so they can all be drawn together.
+
+    Like `sprites`, the draw calls and frame time only show up in an SDL build.
+    """
+    project = Project()
+    project.runtime_options(maxClones=1000000)
+    turns = project.stage.variable("turns", 0)
+
+    sprite = project.sprite("Dot", [svg_costume("dot", 12, 12, "#3080ff")])
+    definition, _ = sprite.define("spawn", [], warp=True)
+    sprite.script(definition, sprite.repeat(800,
+        sprite.create_clone(),
+        sprite.block("motion_movesteps", {"STEPS": num(5)}),
+        sprite.block("motion_turnright", {"DEGREES": num(29)})))
+    sprite.script(sprite.when_flag(), sprite.call("spawn", [], [], warp=True))
+    sprite.script(sprite.when_clone(), sprite.forever(
+        sprite.block("motion_movesteps", {"STEPS": num(2)}),
+        sprite.block("motion_ifonedgebounce"),
+        sprite.block("motion_turnright", {"DEGREES": num(3)}),
+        sprite.change_var(turns, num(1))))
+    return project
+
+
+def layers():
+    """2000 clones going to the front or a few layers back every tick, with 50 of them replaced every tick."""
+    project = Project()
+    project.runtime_options(maxClones=1000000)
+    moves = project.stage.variable("moves", 0)
+
+    sprite = project.sprite("Card", [svg_costume("card", 10, 14, "#f0f0f0")])
+    age = sprite.variable("age", 0)
+    definition, _ = sprite.define("spawn", [], warp=True)
+    sprite.script(definition, sprite.repeat(2000,
+        sprite.change_var(age, num(1)),
+        sprite.create_clone(),
+        sprite.block("motion_movesteps", {"STEPS": num(3)}),
+        sprite.block("motion_turnright", {"DEGREES": num(17)})))
+    sprite.script(sprite.when_flag(), sprite.call("spawn", [], [], warp=True))
+
+    def every(n):
+        remainder = reporter(sprite.op("operator_mod", sprite.var(age), num(n)))
+        return sprite.op("operator_equals", remainder, num(0), ("OPERAND1", "OPERAND2"))
+
+    # a clone's copy starts with the same age, but ages before it checks, so it doesn't replace itself right away
+    sprite.script(sprite.when_clone(), sprite.forever(
+        sprite.change_var(age, num(1)),
+        sprite.if_then(every(2), sprite.block("looks_gotofrontback", fields={"FRONT_BACK": ["front", None]})),
+        sprite.block("looks_goforwardbackwardlayers", {"NUM": num(7)}, {"FORWARD_BACKWARD": ["backward", None]}),
+        sprite.change_var(moves, num(1)),
+        sprite.if_then(every(40), sprite.create_clone(), sprite.block("control_delete_this_clone"))))
+    return project
+
+BENCHMARKS = {
+    "arithmetic": arithmetic,
+    "recursion": recursion,
+    "recursion_refresh": recursion_refresh,
+    "clones": clones,
+    "lists": lists,
+    "broadcasts": broadcasts,
+    "messages": messages,
+    "touching": touching,
+    "costumes": costumes,
+    "waits": waits,
+    "swarm": swarm,
+    "sprites": sprites,
+    "batching": batching,
+    "layers": layers,
+}
+
+
+def generate(output_folder):
+    os.makedirs(output_folder, exist_ok=True)
+    paths = {}
+    for name, build in BENCHMARKS.items():
+        path = os.path.join(output_folder, name + ".sb3")
+        build().write(path)
+        paths[name] = path
+    return paths
+
+
+def main():
+    output_folder = sys.argv[1] if len(sys.argv) > 1 else os.path.join("build", "benchmark")
+    for name, path in generate(output_folder).items():
+        print("%-12s %s" % (name, path))
+
+
+if __name__ == "__main__":
+    main()
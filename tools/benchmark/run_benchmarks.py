@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Runs the synthetic benchmark projects through the headless build and compares
+the results against a stored baseline.
+
+A benchmark regresses when its median ticks/sec drops by more than the
+threshold, or when its state hash changes (the project no longer ends up in
+the same state, so something about execution changed).
+
+    make PLATFORM=headless
+    python3 tools/benchmark/run_benchmarks.py [--update-baseline]
+
+Baselines are machine specific, regenerate them with --update-baseline before
+comparing on a different machine.
+"""
+
+import argparse
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+
+import generate_projects
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_BINARY = os.path.join("build", "headless", "release", "Scratch-headless")
+DEFAULT_BASELINE = os.path.join(HERE, "baseline.json")
+
+REPORT_FIELDS = {
+    "ticks_per_sec": re.compile(r"^ticks/sec: ([0-9.]+)$", re.M),
+    "blocks_per_sec": re.compile(r"^blocks/sec: ([0-9.]+)$", re.M),
+    "blocks": re.compile(r"^blocks: ([0-9]+)$", re.M),
+    "state_hash": re.compile(r"^state hash: ([0-9a-f]+)$", re.M),
+}
+
+
+def run_once(binary, project, ticks, timeout):
+    try:
+        result = subprocess.run([binary, project, "--ticks", str(ticks)],
+                                stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                universal_newlines=True, timeout=timeout)
+    except subprocess.TimeoutExpired:
+        return None, "timed out after %ds" % timeout
+    if result.returncode != 0:
+        return None, "exited with %d" % result.returncode
+
+    report = {}
+    for field, pattern in REPORT_FIELDS.items():
+        match = pattern.search(result.stdout)
+        if not match:
+            return None, "no '%s' in report" % field
+        report[field] = match.group(1)
+    report["ticks_per_sec"] = float(report["ticks_per_sec"])
+    report["blocks_per_sec"] = float(report["blocks_per_sec"])
+    report["blocks"] = int(report["blocks"])
+    return report, None
+
+
+def run_benchmark(binary, project, ticks, repeat, timeout):
+    runs = []
+    for _ in range(repeat):
+        report, error = run_once(binary, project, ticks, timeout)
+        if error:
+            return None, error
+        runs.append(report)
+
+    hashes = set(run["state_hash"] for run in runs)
+    if len(hashes) > 1:
+        return None, "state hash differs between runs: " + ", ".join(sorted(hashes))
+    return {
+        "ticks": ticks,
+        "ticks_per_sec": round(statistics.median(run["ticks_per_sec"] for run in runs), 1),
+        "blocks_per_sec": round(statistics.median(run["blocks_per_sec"] for run in runs), 1),
+        "blocks": runs[0]["blocks"],
+        "state_hash": runs[0]["state_hash"],
+    }, None
+
+
+def compare(name, result, baseline, threshold):
+    """Returns a list of problems with `result` compared to `baseline`."""
+    problems = []
+    if baseline["ticks"] != result["ticks"]:
+        return ["baseline was measured with %d ticks" % baseline["ticks"]]
+    if baseline["state_hash"] != result["state_hash"]:
+        problems.append("state hash %s, expected %s" % (result["state_hash"], baseline["state_hash"]))
+    change = result["ticks_per_sec"] / baseline["ticks_per_sec"] - 1.0
+    if change < -threshold:
+        problems.append("%.1f%% slower than baseline" % (-change * 100))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--binary", default=DEFAULT_BINARY, help="headless runner to benchmark")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE, help="baseline results (json)")
+    parser.add_argument("--projects", default=os.path.join("build", "benchmark"), help="where to generate the projects")
+    parser.add_argument("--ticks", type=int, default=1000, help="ticks to run each project for")
+    parser.add_argument("--repeat", type=int, default=5, help="runs per project, the median is used")
+    parser.add_argument("--threshold", type=float, default=0.10, help="allowed slowdown before failing (0.10 = 10%%)")
+    parser.add_argument("--timeout", type=int, default=120, help="seconds before a single run is given up on")
+    parser.add_argument("--update-baseline", action="store_true", help="store these results as the new baseline")
+    parser.add_argument("only", nargs="*", help="only run these benchmarks")
+    args = parser.parse_args()
+
+    if not os.path.isfile(args.binary):
+        sys.exit("Headless runner not found at %s, build it with 'make PLATFORM=headless'" % args.binary)
+    unknown = [name for name in args.only if name not in generate_projects.BENCHMARKS]
+    if unknown:
+        sys.exit("Unknown benchmark(s): %s" % ", ".join(unknown))
+
+    baseline = {}
+    if os.path.isfile(args.baseline):
+        with open(args.baseline) as file:
+            baseline = json.load(file)
+
+    projects = generate_projects.generate(args.projects)
+    results = {}
+    failed = False
+    print("%-12s %12s %14s  %-16s %s" % ("benchmark", "ticks/sec", "blocks/sec", "state hash", "vs baseline"))
+    for name, project in projects.items():
+        if args.only and name not in args.only:
+            continue
+        result, error = run_benchmark(args.binary, project, args.ticks, args.repeat, args.timeout)
+        if error:
+            print("%-12s FAILED: %s" % (name, error))
+            failed = True
+            continue
+        results[name] = result
+
+        status = "no baseline"
+        if name in baseline and not args.update_baseline:
+            change = result["ticks_per_sec"] / baseline[name]["ticks_per_sec"] - 1.0
+            problems = compare(name, result, baseline[name], args.threshold)
+            status = "%+.1f%%" % (change * 100)
+            if problems:
+                status += "  REGRESSION: " + "; ".join(problems)
+                failed = True
+        print("%-12s %12.1f %14.1f  %-16s %s" % (name, result["ticks_per_sec"], result["blocks_per_sec"],
+                                                result["state_hash"], status))
+
+    if args.update_baseline:
+        if failed:
+            sys.exit("Not updating the baseline, some benchmarks failed")
+        baseline.update(results)
+        with open(args.baseline, "w") as file:
+            json.dump(baseline, file, indent=4, sort_keys=True)
+            file.write("\n")
+        print("Baseline written to " + args.baseline)
+        return 0
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())